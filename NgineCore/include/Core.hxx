@@ -113,4 +113,6 @@
 #include <filesystem>
 #include <array>
 #include <vector>
-#include <map>
\ No newline at end of file
+#include <deque>
+#include <map>
+#include <optional>
\ No newline at end of file
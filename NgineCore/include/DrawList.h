@@ -0,0 +1,38 @@
+#pragma once
+#include "Core.hxx"
+#include "GameObject.h"
+
+namespace Ngine
+{
+#if defined(TARGET_PLATFORM_LINUX)
+
+    //Single mesh of a single object, ordered by its sort key before recording
+    struct DrawPacket
+    {
+        uint64_t mSortKey = 0;
+        GameObject3D* pObject = nullptr;
+        uint32_t mModelIndex = 0;
+        uint32_t mMeshIndex = 0;
+        uint32_t mLod = 0;
+    };
+
+    //Packets rebuilt every frame and sorted so state changes happen as rarely as possible.
+    //Key layout from most to least significant bits: pipeline (16) | descriptor set (8) | geometry (16) | depth (24)
+    class DrawList
+    {
+    public:
+        static uint64_t MakeSortKey(uint32_t pipeline, uint32_t descriptorSet, uint32_t geometry, float depth);
+
+        inline void Clear() noexcept { vecPackets.clear(); }
+        inline void Add(const DrawPacket& packet) { vecPackets.push_back(packet); }
+        void Sort();
+
+        inline const std::vector<DrawPacket>& GetPackets() const noexcept { return vecPackets; }
+        inline size_t GetSize() const noexcept { return vecPackets.size(); }
+
+    private:
+        std::vector<DrawPacket> vecPackets;
+        std::vector<DrawPacket> vecScratch;
+    };
+#endif
+}
\ No newline at end of file
@@ -0,0 +1,63 @@
+#pragma once
+#include "Core.hxx"
+#include "GameObject.h"
+#include "Frustum.h"
+
+namespace Ngine
+{
+#if defined(TARGET_PLATFORM_LINUX)
+
+    //Incrementally updated AABB tree over scene objects. Leaves hold boxes enlarged by margin so small moves
+    //don't touch the tree, bigger ones reinsert the leaf and rotations keep the tree balanced on the way up.
+    class DynamicBvh
+    {
+    private:
+        class Node
+        {
+        public:
+            inline bool IsLeaf() const noexcept { return mChild1 == -1; }
+
+            glm::vec3 mMin = glm::vec3(0.0f);
+            glm::vec3 mMax = glm::vec3(0.0f);
+            GameObject3D* pObject = nullptr;
+            int32_t mParent = -1; //Next free node while node is in free list
+            int32_t mChild1 = -1;
+            int32_t mChild2 = -1;
+            int32_t mHeight = -1; //Leaf is 0, free node is -1
+        };
+
+    public:
+        DynamicBvh(float margin = 0.1f);
+
+        int32_t Insert(GameObject3D* pObject, const glm::vec3& boundsMin, const glm::vec3& boundsMax);
+        void Remove(int32_t proxy);
+        bool Move(int32_t proxy, const glm::vec3& boundsMin, const glm::vec3& boundsMax);
+
+        void QueryFrustum(const Frustum& frustum, std::vector<GameObject3D*>& vecOut) const;
+        void QueryAabb(const glm::vec3& boundsMin, const glm::vec3& boundsMax, std::vector<GameObject3D*>& vecOut) const;
+        void QueryRay(const glm::vec3& origin, const glm::vec3& direction, float maxDistance, std::vector<GameObject3D*>& vecOut) const;
+
+        inline GameObject3D* GetObject(int32_t proxy) const { return vecNodes[proxy].pObject; }
+        inline uint32_t GetProxyCount() const noexcept { return mProxyCount; }
+        inline int32_t GetHeight() const noexcept { return mRoot == -1 ? 0 : vecNodes[mRoot].mHeight; }
+
+        static void TransformBounds(const glm::mat4& world, const glm::vec3& localMin, const glm::vec3& localMax, glm::vec3& outMin, glm::vec3& outMax);
+
+    private:
+        int32_t AllocateNode();
+        void FreeNode(int32_t index);
+        void InsertLeaf(int32_t leaf);
+        void RemoveLeaf(int32_t leaf);
+        int32_t Balance(int32_t index);
+        void FixUpwards(int32_t index);
+
+    private:
+        std::vector<Node> vecNodes;
+        mutable std::vector<int32_t> vecStack; //Reused by queries
+        int32_t mRoot = -1;
+        int32_t mFreeList = -1;
+        uint32_t mProxyCount = 0;
+        float mMargin = 0.1f;
+    };
+#endif
+}
\ No newline at end of file
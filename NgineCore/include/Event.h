@@ -9,6 +9,7 @@ namespace Ngine
         EventType_WindowResize = 0x0001,
         EventType_CursorMove = 0x0002,
         EventType_KeyAction = 0x0003,
+        EventType_ShaderReady = 0x0004,
     };
 
     struct Event
@@ -41,6 +42,16 @@ namespace Ngine
         bool mPressed = false;
     };
 
+    //All pipelines of a shader finished compiling, objects using it are drawn from now on
+    struct EventShaderReady : Event
+    {
+    public:
+        EventType mType = EventType::EventType_ShaderReady;
+        uint32_t mShaderId = 0;
+        double mCompileMs = 0.0; //Sum of compile times of pipelines this shader waited for
+        bool mSucceeded = true;
+    };
+
     class EventHandler
     {
     public:
@@ -0,0 +1,45 @@
+#pragma once
+#include "Core.hxx"
+#include "MemoryAllocator.h"
+
+namespace Ngine
+{
+#if defined(TARGET_PLATFORM_LINUX)
+
+    //Persistently mapped uniform buffer per frame in flight, handed out linearly and reset every frame.
+    //Data written into it is bound with dynamic offsets, so it never has to be searched or rewritten.
+    class FrameUniformAllocator
+    {
+    private:
+        class FrameBuffer
+        {
+        public:
+            VkBuffer mBuffer = VK_NULL_HANDLE;
+            Allocation mAlloc;
+        };
+
+    public:
+        void Initialize(VkDevice device, MemoryAllocator* pAllocator, VkDeviceSize sizePerFrame, VkDeviceSize alignment, VkBufferUsageFlags usage = VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT);
+        void Destroy();
+
+        void BeginFrame(uint32_t frameIndex);
+        void* Allocate(VkDeviceSize size, uint32_t& outOffset);
+
+        inline VkBuffer GetBuffer(uint32_t frameIndex) const { return vecFrames[frameIndex].mBuffer; }
+        inline VkDeviceSize GetSizePerFrame() const noexcept { return mSize; }
+        inline VkDeviceSize GetAlignedSize(VkDeviceSize size) const noexcept { return (size + mAlignment - 1) / mAlignment * mAlignment; }
+        inline VkDeviceSize GetPeakUsage() const noexcept { return mPeakUsage; }
+
+    private:
+        VkDevice mDevice = VK_NULL_HANDLE;
+        MemoryAllocator* pAllocator = nullptr;
+        std::vector<FrameBuffer> vecFrames;
+        VkDeviceSize mSize = 0;
+        VkDeviceSize mAlignment = 0;
+        VkDeviceSize mHead = 0;
+        VkDeviceSize mPeakUsage = 0;
+        uint32_t mFrameIndex = 0;
+        bool mOverflowReported = false;
+    };
+#endif
+}
\ No newline at end of file
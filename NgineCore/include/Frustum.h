@@ -0,0 +1,39 @@
+#pragma once
+#include "Core.hxx"
+
+namespace Ngine
+{
+#if defined(TARGET_PLATFORM_LINUX)
+
+    //World space bounding spheres stored as structure of arrays so culling kernel can load 8 of them at once
+    class SphereSet
+    {
+    public:
+        inline void Clear() noexcept { vecX.clear(); vecY.clear(); vecZ.clear(); vecRadius.clear(); }
+        void Add(const glm::vec3& center, float radius);
+        void Add(const glm::mat4& world, const glm::vec4& localSphere);
+        inline size_t GetSize() const noexcept { return vecRadius.size(); }
+
+    public:
+        std::vector<float> vecX;
+        std::vector<float> vecY;
+        std::vector<float> vecZ;
+        std::vector<float> vecRadius;
+    };
+
+    //Six planes in world space (left, right, bottom, top, near, far), xyz is normal pointing inside and w is distance
+    struct Frustum
+    {
+        glm::vec4 planes[6];
+
+        static Frustum FromMatrix(const glm::mat4& viewProj);
+        bool IntersectsSphere(const glm::vec3& center, float radius) const;
+        bool IntersectsBox(const glm::vec3& boundsMin, const glm::vec3& boundsMax) const;
+
+        //Writes 1 for every sphere that touches the frustum and 0 for the rest, returns number of visible spheres.
+        //Uses AVX2 when CPU supports it and SSE otherwise, both test 8 spheres per iteration.
+        uint32_t CullSpheres(const SphereSet& spheres, uint8_t* pVisible) const;
+        uint32_t CullSpheresScalar(const SphereSet& spheres, uint8_t* pVisible, size_t first = 0) const;
+    };
+#endif
+}
\ No newline at end of file
@@ -3,6 +3,8 @@
 
 namespace Ngine
 {
+    class DynamicBvh;
+
     class GameObject3D
     {
         friend class GraphicsCore;
@@ -20,6 +22,8 @@ namespace Ngine
 		void AdjustTranslation(glm::vec3& translation);
 
 		inline glm::mat4 GetWorldMatrix() const noexcept { return mWorld; }
+		inline void SetDrawPayload(const glm::uvec4& payload) noexcept { mPayload = payload; }
+		inline glm::uvec4 GetDrawPayload() const noexcept { return mPayload; }
 
     private:
 		void RecalculateWorld();
@@ -27,9 +31,18 @@ namespace Ngine
 	private:
 		uint32_t mAssocMdl; //Associated model with game object
 		uint32_t mAssocShader; //Associated shader with game object
+		uint32_t mModelIndex = 0; //Position of associated model in graphics core, resolved once when added to draw list
+		uint32_t mShaderIndex = 0; //Position of associated shader in graphics core
+		bool mDrawable = false; //Both model and shader were found
+		bool mOccluded = false; //Hidden behind occluders in last occlusion pass
 		glm::vec3 mRotation = glm::vec3(0,0,0); //Rotation of game object
 		glm::vec3 mTranslation = glm::vec3(0,0,0); //Translation of game object
 		glm::vec3 mScale = glm::vec3(1,1,1); //Scale of game object
 		glm::mat4 mWorld = glm::mat4(1.0f); //World data for MVP
+		glm::uvec4 mPayload = glm::uvec4(0); //User data passed to shaders that use push constants (material id etc.)
+		DynamicBvh* pSpatialTree = nullptr; //Tree the object is registered in, kept up to date on every transform change
+		int32_t mSpatialProxy = -1; //Leaf of the object in spatial tree
+		glm::vec3 mLocalBoundsMin = glm::vec3(0.0f); //Bounds of associated model in object space
+		glm::vec3 mLocalBoundsMax = glm::vec3(0.0f);
     };
 }
\ No newline at end of file
@@ -0,0 +1,60 @@
+#pragma once
+#include "Core.hxx"
+#include "MemoryAllocator.h"
+
+namespace Ngine
+{
+#if defined(TARGET_PLATFORM_LINUX)
+
+    //Vertex and index ranges of a single mesh inside one arena page
+    struct GeometryAllocation
+    {
+        uint32_t mPage = 0;
+        VkDeviceSize mVertexOffset = 0; //In bytes
+        VkDeviceSize mVertexSize = 0;
+        VkDeviceSize mIndexOffset = 0; //In bytes
+        VkDeviceSize mIndexSize = 0;
+        bool mValid = false;
+    };
+
+    //Packs geometry of all meshes into few big vertex/index buffers so draws only need offsets
+    class GeometryArena
+    {
+    private:
+        class Page
+        {
+        public:
+            VkBuffer mVertexBuffer = VK_NULL_HANDLE;
+            VkBuffer mIndexBuffer = VK_NULL_HANDLE;
+            Allocation mVertexAlloc;
+            Allocation mIndexAlloc;
+            RangeAllocator mVertexRanges;
+            RangeAllocator mIndexRanges;
+        };
+
+    public:
+        void Initialize(VkDevice device, MemoryAllocator* pAllocator, VkDeviceSize vertexPageSize, VkDeviceSize indexPageSize);
+        void Destroy();
+
+        GeometryAllocation Allocate(VkDeviceSize vertexSize, VkDeviceSize vertexStride, VkDeviceSize indexSize, VkDeviceSize indexStride);
+        void Free(GeometryAllocation& alloc);
+
+        inline VkBuffer GetVertexBuffer(uint32_t page) const { return vecPages[page].mVertexBuffer; }
+        inline VkBuffer GetIndexBuffer(uint32_t page) const { return vecPages[page].mIndexBuffer; }
+        inline uint32_t GetPageCount() const noexcept { return vecPages.size(); }
+        void LogStats() const;
+
+    private:
+        uint32_t CreatePage(VkDeviceSize vertexSize, VkDeviceSize indexSize);
+        bool AllocateFromPage(uint32_t pageIndex, VkDeviceSize vertexSize, VkDeviceSize vertexStride, VkDeviceSize indexSize, VkDeviceSize indexStride, GeometryAllocation& outAlloc);
+        void CreatePageBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkBuffer& buffer, Allocation& alloc);
+
+    private:
+        VkDevice mDevice = VK_NULL_HANDLE;
+        MemoryAllocator* pAllocator = nullptr;
+        VkDeviceSize mVertexPageSize = 0;
+        VkDeviceSize mIndexPageSize = 0;
+        std::vector<Page> vecPages;
+    };
+#endif
+}
\ No newline at end of file
@@ -0,0 +1,63 @@
+#pragma once
+#include "Core.hxx"
+#include "MemoryAllocator.h"
+#include "FrameUniformAllocator.h"
+#include "Frustum.h"
+
+namespace Ngine
+{
+#if defined(TARGET_PLATFORM_LINUX)
+
+    //Single instance tested by culling shader, layout matches std430 struct of the shader
+    struct CullInstance
+    {
+        glm::mat4 world;
+        glm::vec4 sphere; //Bounding sphere in model space, w is radius
+        uint32_t outputIndex; //First element of instance group in instance buffer, survivors are packed from it
+        uint32_t counterIndex; //uint element of indirect buffer counting survivors of instance group
+        uint32_t padding[2];
+    };
+
+    struct CullPushConstants
+    {
+        glm::vec4 planes[6];
+        uint32_t instanceCount;
+    };
+
+    //Compute pass that tests instances against camera frustum and compacts survivors into instance buffer.
+    //Shader source is Resource/Shader/cull.comp, built with glslc when the project is configured for Linux.
+    //Shader bindings: 0 - CullInstance[] (read), 1 - mat4[] instance buffer (write), 2 - uint[] indirect buffer (atomic counters).
+    //Counters are copied into instanceCount of indirect commands after dispatch, so draws only see survivors.
+    //Barriers between dispatch, copies and draws are placed by the render graph.
+    class GpuCuller
+    {
+    public:
+        bool Initialize(VkDevice device, MemoryAllocator* pAllocator, VkPipelineCache pipelineCache, const char* shaderPath, VkDeviceSize inputSizePerFrame, FrameUniformAllocator* pInstances, FrameUniformAllocator* pIndirect);
+        void Destroy();
+
+        void BeginFrame(uint32_t frameIndex);
+        CullInstance* Allocate(uint32_t count);
+        void RecordDispatch(VkCommandBuffer cmdBuffer, const Frustum& frustum);
+        void RecordCounterCopies(VkCommandBuffer cmdBuffer, const std::vector<VkBufferCopy>& vecCounterCopies);
+
+        inline uint32_t GetInstanceCount() const noexcept { return mInstanceCount; }
+
+    private:
+        void CreateDescriptors(FrameUniformAllocator* pInstances);
+        void CreatePipeline(const std::vector<char>& code, VkPipelineCache pipelineCache);
+
+    private:
+        VkDevice mDevice = VK_NULL_HANDLE;
+        FrameUniformAllocator mInput;
+        FrameUniformAllocator* pIndirect = nullptr;
+        VkShaderModule mShader = VK_NULL_HANDLE;
+        VkDescriptorSetLayout mDescLayout = VK_NULL_HANDLE;
+        VkDescriptorPool mDescPool = VK_NULL_HANDLE;
+        std::vector<VkDescriptorSet> vecDescSets; //One per frame in flight
+        VkPipelineLayout mPipelineLayout = VK_NULL_HANDLE;
+        VkPipeline mPipeline = VK_NULL_HANDLE;
+        uint32_t mFrameIndex = 0;
+        uint32_t mInstanceCount = 0;
+    };
+#endif
+}
\ No newline at end of file
@@ -3,6 +3,22 @@
 #include "Window.h"
 #include "Exception.h"
 #include "GameObject.h"
+#include "MemoryAllocator.h"
+#include "StagingRing.h"
+#include "UploadManager.h"
+#include "GeometryArena.h"
+#include "FrameUniformAllocator.h"
+#include "DrawList.h"
+#include "Frustum.h"
+#include "GpuCuller.h"
+#include "DynamicBvh.h"
+#include "ThreadPool.h"
+#include "OcclusionBuffer.h"
+#include "MeshSimplifier.h"
+#include "MeshOptimizer.h"
+#include "PipelineCache.h"
+#include "PipelineCompiler.h"
+#include "RenderGraph.h"
 
 namespace Ngine
 {
@@ -16,6 +32,7 @@ namespace Ngine
 
         const glm::mat4 GetViewMatrix() const;
         const glm::mat4 GetProjectionMatrix() const;
+        Frustum GetFrustum() const;
 
         const glm::vec3 GetPositionVec3() const;
         const glm::vec3 GetRotationVec3() const;
@@ -51,14 +68,41 @@ namespace Ngine
         glm::mat4 view;
     };
 
+    //Format of binding 0, every shader gets a pipeline for each of them
+    enum class VertexLayout : uint32_t
+    {
+        Full = 0, //Vertex as it is, 32 bytes
+        Packed, //PackedVertex, 16 bytes
+        Count
+    };
+
     struct Vertex
     {
         glm::vec3 pos;
 		glm::vec3 color;
 		glm::vec2 uv;
 
-        static VkVertexInputBindingDescription GetBindingDescription();
-		static std::array<VkVertexInputAttributeDescription, 3> GetAttributeDescriptions();
+        static VkVertexInputBindingDescription GetBindingDescription(VertexLayout layout = VertexLayout::Full);
+		static std::array<VkVertexInputAttributeDescription, 3> GetAttributeDescriptions(VertexLayout layout = VertexLayout::Full);
+		static uint32_t GetStride(VertexLayout layout);
+
+		//Binding 1 of instanced shaders - one InstanceData per instance, world matrix in locations 3-6
+		static VkVertexInputBindingDescription GetInstanceBindingDescription();
+		static std::array<VkVertexInputAttributeDescription, 4> GetInstanceAttributeDescriptions();
+    };
+
+    //Same attributes as Vertex read by the same shaders, vertex fetch converts them back to floats.
+    //Position is snorm16 inside quantization box of its model, w is always 1
+    struct PackedVertex
+    {
+        int16_t pos[4];
+        uint32_t color; //unorm8 RGBA
+        uint32_t uv; //Two half floats
+    };
+
+    struct InstanceData
+    {
+        glm::mat4 world;
     };
 
     struct MVP
@@ -68,6 +112,74 @@ namespace Ngine
 		glm::mat4 projection;
     };
 
+    //Set 0 binding 0 (dynamic uniform buffer) of shaders that declare a push constant block
+    struct CameraConstants
+    {
+        glm::mat4 view;
+        glm::mat4 projection;
+    };
+
+    //Push constant block: layout(push_constant) uniform { mat4 model; uvec4 payload; }
+    struct ObjectPushConstants
+    {
+        glm::mat4 model;
+        glm::uvec4 payload;
+    };
+
+    //Element of bindless frame buffer, set 0 binding 0 of shaders that declare a storage buffer:
+    //readonly buffer { mat4 view; mat4 projection; BindlessObject objects[]; } frames[MAX_FRAMES_IN_FLIGHT]
+    //Binding 1 is sampler2D textures[], texture indices travel in payload
+    struct BindlessObject
+    {
+        glm::mat4 model;
+        glm::uvec4 payload;
+    };
+
+    //Push constant block of bindless shaders: layout(push_constant) uniform { uint frame; uint object; }
+    struct BindlessPushConstants
+    {
+        uint32_t mFrame = 0;
+        uint32_t mObject = 0;
+    };
+
+    //Pipeline variant of a shader, decides render pass and depth state it is built for
+    enum class ShaderPass : uint32_t
+    {
+        Main = 0, //Depth test and write against cleared depth
+        DepthPrepass, //Vertex stage only, lays down depth before anything is shaded
+        AfterPrepass, //EQUAL test without depth writes, every pixel is shaded once
+        Count
+    };
+
+    //Everything that decides how a graphics pipeline is built. Compared and hashed as raw bytes,
+    //so it is always zero filled before its fields are set
+    struct PipelineState
+    {
+        VkShaderModule mVertex;
+        VkShaderModule mFragment;
+        VkPipelineLayout mLayout;
+        VkRenderPass mRenderPass;
+        uint32_t mSubpass;
+        VertexLayout mVertexLayout;
+        uint32_t mInstanced; //Second binding with per instance world matrix
+        VkPrimitiveTopology mTopology;
+        VkPolygonMode mPolygonMode;
+        VkCullModeFlags mCullMode;
+        VkFrontFace mFrontFace;
+        VkSampleCountFlagBits mSamples;
+        uint32_t mBlendEnable;
+        VkBlendFactor mSrcColorBlend;
+        VkBlendFactor mDstColorBlend;
+        VkBlendOp mColorBlendOp;
+        VkBlendFactor mSrcAlphaBlend;
+        VkBlendFactor mDstAlphaBlend;
+        VkBlendOp mAlphaBlendOp;
+        VkColorComponentFlags mColorWriteMask;
+        uint32_t mDepthTest;
+        uint32_t mDepthWrite;
+        VkCompareOp mDepthCompare;
+    };
+
     class Shader
     {
         friend class GraphicsCore;
@@ -76,13 +188,28 @@ namespace Ngine
 
     private:
         uint32_t mId = 0;
-		VkShaderModule mVertex;
+		VkShaderModule mVertex; //Modules, layouts and pipelines are owned by caches of GraphicsCore and may be shared
 		VkShaderModule mFragment;
-		VkPipelineShaderStageCreateInfo mShaderStages[2];
 		VkPipelineLayout mPipelineLayout;
-		VkPipeline mPipeline;
+		VkPipeline mPipelines[(uint32_t)ShaderPass::Count][(uint32_t)VertexLayout::Count] = {}; //Pre-pass variants only with [General] DepthPrepass, Packed layout only with [Mesh] Quantize
+		bool mPrepassVariants = false; //Vertex shader has invariant gl_Position, otherwise shaded with Main pipelines and skipped by pre-pass
 		VkDescriptorSetLayout mDescLayout;
 		VkDescriptorPool mDescPool;
+		std::vector<VkDescriptorSet> vecDescSets; //One per frame in flight, points at frame uniform buffer
+		bool mUsesPushConstants = false; //Model matrix comes from push constants, uniform buffer holds only camera data
+		bool mUsesInstancing = false; //Vertex shader reads world matrix from per instance attributes
+		bool mBindless = false; //Reads object data from global bindless set, has no descriptor sets of its own
+		uint32_t mPendingPipelines = 0; //Still compiling in background, objects with such pipeline are not drawn
+		double mCompileMs = 0.0;
+		bool mCompileFailed = false;
+    };
+
+    //Simplified level of a mesh, index range over the same vertices as the full mesh
+    struct MeshLod
+    {
+        uint32_t mFirstIndex = 0;
+        uint32_t mIndexCount = 0;
+        float mError = 0.0f; //Model space distance from original surface
     };
 
     class Mesh
@@ -91,11 +218,19 @@ namespace Ngine
 	private:
 		uint32_t mVertexCount = 0;
 		uint32_t mIndexCount = 0;
-		VkBuffer mVertexBuffer;
-		VkBuffer mIndexBuffer;
-		VkDeviceMemory mVertexMemory;
-		VkDeviceMemory mIndexMemory;
-		std::vector<VkDescriptorSet> vecDescSets;
+		VkIndexType mIndexType = VK_INDEX_TYPE_UINT16; //16 bit whenever all vertices can be addressed with it
+		uint32_t mFirstIndex = 0; //First index inside arena page index buffer
+		int32_t mVertexOffset = 0; //First vertex inside arena page vertex buffer
+		GeometryAllocation mGeometry;
+		uint64_t mUploadTicket = 0;
+		glm::vec3 mBoundsMin = glm::vec3(0.0f); //Model space bounding box
+		glm::vec3 mBoundsMax = glm::vec3(0.0f);
+		glm::vec4 mBoundingSphere = glm::vec4(0.0f); //Model space, w is radius
+		VertexLayout mLayout = VertexLayout::Full;
+		std::vector<MeshLod> vecLods; //Levels 1 and above, every one coarser than previous
+
+		inline uint32_t GetLodFirstIndex(uint32_t lod) const { return lod == 0 ? mFirstIndex : vecLods[lod - 1].mFirstIndex; }
+		inline uint32_t GetLodIndexCount(uint32_t lod) const { return lod == 0 ? mIndexCount : vecLods[lod - 1].mIndexCount; }
     };
 
     class Model
@@ -105,19 +240,160 @@ namespace Ngine
 	private:
         uint32_t mId = 0;
 		std::vector<Mesh> vecMeshes;
-		std::vector<VkBuffer> vecUniformBuffers;
-		std::vector<VkDeviceMemory> vecUniformMemory;
-		std::vector<void*> vecUniformBuffersMapped;
+		uint64_t mUploadTicket = 0; //Upload batch that has to finish before model can be drawn
+		bool mReady = false;
+		glm::vec3 mBoundsMin = glm::vec3(0.0f); //Model space box enclosing all meshes
+		glm::vec3 mBoundsMax = glm::vec3(0.0f);
+		glm::vec4 mBoundingSphere = glm::vec4(0.0f); //Model space sphere enclosing all meshes, w is radius
+		glm::vec4 mQuantization = glm::vec4(0.0f); //Box of quantized positions, xyz center and w half size, zero when positions are stored as they are
+		bool mOccluder = false; //Flagged at import, rasterized into occlusion buffer
+		std::vector<glm::vec3> vecOccluderPositions; //CPU copy of geometry, only kept for occluders
+		std::vector<uint32_t> vecOccluderIndices;
+    };
+
+    struct FrameStats
+    {
+        uint32_t mFrameCount = 0;
+        double mAverageMs = 0.0;
+        double mMinMs = 0.0;
+        double mMaxMs = 0.0;
+        double mJitterMs = 0.0; //Standard deviation of frame time
+        double mPercentile99Ms = 0.0;
+        double mRecordAverageMs = 0.0; //CPU time spent recording draw commands
+        uint64_t mFragmentInvocations = 0; //Average per frame in shading pass, needs [General] PipelineStatistics
+        double mFragmentsPerPixel = 0.0; //Same average divided by swapchain pixels, 1.0 means no overdraw
+    };
+
+    //Command counts of the last recorded frame, elided binds were skipped because state was already bound
+    struct DrawStats
+    {
+        uint32_t mPackets = 0;
+        uint32_t mCulledObjects = 0; //Rejected by CPU frustum culling
+        uint32_t mOccludedObjects = 0; //Passed frustum culling but rejected by occlusion buffer
+        uint32_t mTriangles = 0; //Submitted by draws whose instance count is known on CPU
+        uint32_t mDrawCalls = 0;
+        uint32_t mIndirectCommands = 0; //Draws executed from indirect buffer, each indirect call counts as single draw call
+        uint32_t mPipelineBinds = 0;
+        uint32_t mPipelineBindsElided = 0;
+        uint32_t mDescriptorBinds = 0;
+        uint32_t mDescriptorBindsElided = 0;
+        uint32_t mVertexBufferBinds = 0;
+        uint32_t mVertexBufferBindsElided = 0;
+        uint32_t mIndexBufferBinds = 0;
+        uint32_t mIndexBufferBindsElided = 0;
+        uint32_t mNotReadySkipped = 0; //Draws skipped because their pipeline is still compiling
+        uint32_t mPrepassDrawCalls = 0; //Depth pre-pass draws, not included in mDrawCalls
+
+        void Add(const DrawStats& other);
+    };
+
+    //Lookups of LoadShader caches since startup
+    struct ShaderCacheStats
+    {
+        uint32_t mShaderHits = 0; //LoadShader calls that returned already loaded shader
+        uint32_t mModuleHits = 0;
+        uint32_t mModuleMisses = 0;
+        uint32_t mPipelineHits = 0; //Pre-pass pipelines shared by shaders with the same vertex module
+        uint32_t mPipelineMisses = 0; //Only depth only pipelines are looked up, the rest are unique per shader
+    };
+
+    //CPU occlusion pass of the last frame
+    struct OcclusionStats
+    {
+        uint32_t mOccluders = 0;
+        uint32_t mOccluderTriangles = 0; //Triangles that reached the depth buffer
+        uint32_t mTestedObjects = 0;
+        uint32_t mOccludedObjects = 0;
+        double mRasterMs = 0.0;
+        double mTestMs = 0.0;
     };
 
     class GraphicsCore
     {
     private:
+        //Objects sharing model and instanced shader, drawn with single instanced draw per mesh
+        class InstanceGroup
+        {
+        public:
+            uint32_t mModelIndex = 0;
+            uint32_t mShaderIndex = 0;
+            std::vector<GameObject3D*> vecObjects;
+            uint32_t mFirstInstance = 0; //Set every frame when instances are written
+            uint32_t mInstanceCount = 0; //Instances written this frame, upper bound when group is culled on GPU
+            bool mPrepared = false; //Instances of this frame were written and group can be drawn
+            bool mCulled = false; //Instances are written by GPU culling pass, only survivors are drawn
+            float mLodPixelsPerUnit = 0.0f; //Of the closest instance, whole group is drawn with its LOD
+        };
+
+        //Indirect draw of one mesh of an instance group, commands with equal key share buffers and pipeline
+        class IndirectCommand
+        {
+        public:
+            uint64_t mKey = 0; //(shader index << 32 | geometry page << 2 | packed vertices << 1 | 32 bit indices)
+            VkDrawIndexedIndirectCommand mCommand = {};
+            std::optional<uint32_t> mCounterOffset; //Visible instance counter of culled group, copied into instanceCount
+        };
+
+        //Commands with equal key written next to each other, submitted with single indirect call
+        class IndirectBatch
+        {
+        public:
+            uint32_t mShaderIndex = 0;
+            uint32_t mPage = 0;
+            VertexLayout mLayout = VertexLayout::Full;
+            VkIndexType mIndexType = VK_INDEX_TYPE_UINT16;
+            uint32_t mCommandOffset = 0;
+            uint32_t mDrawCount = 0;
+            std::optional<uint32_t> mCountOffset; //Draw count buffer offset when drawIndirectCount is used
+        };
+
+        //Contiguous range of the draw list recorded by a single thread
+        class DrawChunk
+        {
+        public:
+            size_t mFirst = 0;
+            size_t mCount = 0;
+            uint32_t mObjectCount = 0; //Objects that need their own constants in frame uniform buffer
+            uint32_t mObjectOffset = 0; //Constants of the first object, the rest follow it
+            uint8_t* pObjectConstants = nullptr;
+            uint32_t mBindlessCount = 0; //Objects of bindless shaders, written into bindless frame buffer
+            uint32_t mBindlessFirst = 0; //Index of the first of them in objects[] of that buffer
+            BindlessObject* pBindlessObjects = nullptr;
+            DrawStats mStats; //Added to frame stats once recording threads are done
+            DrawStats mPrepassStats;
+        };
+
+        //Command pool used by one chunk of one frame in flight, so threads never share a pool
+        class RecordContext
+        {
+        public:
+            VkCommandPool mPool = VK_NULL_HANDLE;
+            VkCommandBuffer mCmdBuffer = VK_NULL_HANDLE; //Secondary, begun and executed inside main render pass
+            VkCommandBuffer mPrepassCmdBuffer = VK_NULL_HANDLE; //Same chunk recorded for depth pre-pass
+        };
+
+        //Compiled SPIR-V, code is kept to tell apart files whose hashes collide
+        class ShaderModuleEntry
+        {
+        public:
+            VkShaderModule mModule = VK_NULL_HANDLE;
+            std::vector<char> vecCode;
+        };
+
+        class PipelineStateEntry
+        {
+        public:
+            PipelineState mState;
+            VkPipeline mPipeline = VK_NULL_HANDLE;
+            bool mPending = false; //Submitted to background compiler, result not collected yet
+        };
+
         class QueueFamilyData
         {
         public:
             std::optional<uint32_t> mGraphicsQueueIndex;
             std::optional<uint32_t> mPresentationQueueIndex;
+            std::optional<uint32_t> mTransferQueueIndex; //Transfer-only family, empty if device does not expose one
         };
     public:
         GraphicsCore(NgineWindow* pWindow);
@@ -126,10 +402,34 @@ namespace Ngine
         void DrawFrame(NgineWindow* pWin);
         uint32_t LoadShader(const char* vertexPath, const char* fragmentPath);
         uint32_t CreateModelFromVertexList(std::vector<Vertex>& v, std::vector<uint16_t>& i);
+        uint32_t CreateModelFromVertexList(std::vector<Vertex>& v, std::vector<uint32_t>& i);
         void Temp_SetCamera(glm::vec3 pos);
         void AddGameObjectToDrawList(GameObject3D* pGo);
-        uint32_t LoadIntermediateModel(const char* modelPath);
+        uint32_t LoadIntermediateModel(const char* modelPath, bool occluder = false);
         void SetCamera(Camera& c);
+        AllocatorStats GetMemoryStats() const;
+        UploadStats GetUploadStats() const;
+        FrameStats GetFrameStats() const;
+        void ResetFrameStats();
+        inline DrawStats GetDrawStats() const noexcept { return mDrawStats; }
+        inline OcclusionStats GetOcclusionStats() const noexcept { return mOcclusionStats; }
+        inline ShaderCacheStats GetShaderCacheStats() const noexcept { return mShaderCacheStats; }
+        bool IsShaderReady(uint32_t shaderId) const;
+        std::optional<uint32_t> RegisterBindlessTexture(VkImageView view, VkSampler sampler);
+        inline bool UsesBindless() const noexcept { return mBindless; }
+        void UpdateOcclusion();
+        void RemoveGameObjectFromDrawList(GameObject3D* pGo);
+        inline const DynamicBvh& GetSpatialTree() const noexcept { return mSpatialTree; }
+        bool IsModelReady(uint32_t modelId);
+        void WaitForModel(uint32_t modelId);
+        void SetRecordThreads(uint32_t count);
+        inline uint32_t GetRecordThreads() const noexcept { return mRecordThreads; }
+        inline uint32_t GetMaxRecordThreads() const noexcept { return mWorkers.GetThreadCount(); }
+        inline bool UsesParallelRecording() const noexcept { return mParallelRecording; }
+        void SetDepthPrepass(bool enable);
+        inline bool UsesDepthPrepass() const noexcept { return mDepthPrepass; }
+        inline bool HasDepthPrepass() const noexcept { return mDepthPrepassPipelines; }
+        inline bool HasPipelineStatistics() const noexcept { return mStatisticsPool != VK_NULL_HANDLE; }
 
     private:
         void CreateInstance();
@@ -149,41 +449,153 @@ namespace Ngine
 		VkPresentModeKHR ChoosePresentMode(const std::vector<VkPresentModeKHR>& avaliableModes);
 		VkExtent2D ChooseSwapExtent(NgineWindow* pWindow);
         void CreateImageViews();
-        void CreatePipeline(Shader& shader);
+        PipelineState GetPipelineState(const Shader& shader, VertexLayout layout, ShaderPass pass) const;
+        VkPipeline RequestPipeline(Shader& shader, VertexLayout layout, ShaderPass pass);
+        void RequestShaderPipelines(Shader& shader); //Every pipeline the shader still misses
+        VkPipeline GetPipeline(const Shader& shader, VertexLayout layout, ShaderPass pass) const;
+        VkResult CompilePipeline(const PipelineState& state, VkPipeline& outPipeline) const;
+        void CollectPipelines();
+        void PublishShaderReady(const Shader& shader);
+        VkShaderModule GetShaderModule(const std::vector<char>& code);
+        void ChooseDepthFormat();
         void CreateRenderPass();
-		void CreateFrameBuffers();
+		void UpdateFrameBuffers(VkImageView depthView);
+		void DestroyFrameBuffers();
+		void CreateStatisticsQueries();
+		void ReadStatisticsQueries();
 		void CreateCommandPool();
 		void CreateCommandBuffer();
 		void RecordCommandBuffer(VkCommandBuffer cmdBuffer, uint32_t imgIndex);
 		void CreateSyncObjects();
+		void CreateUploadManager();
+		void CreateGeometryArena();
+		void CreateFrameUniformAllocator();
+		void CreateOcclusionBuffer();
+		void CreateRecordContexts();
         void RecreateSwapChain(NgineWindow* p);
-		void CreateVertexBuffer(Mesh& m, std::vector<Vertex> verts);
-		uint32_t FindMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags props);
-		void CreateBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags props, VkBuffer& buffer, VkDeviceMemory& memory);
-		void CopyBuffer(VkBuffer src, VkBuffer dst, VkDeviceSize size);
-		void CreateIndexBuffer(Mesh& m, std::vector<uint16_t> indices);
-		void CreateDescriptorSetLayout(Shader& shader);
-		void CreateMvpBuffer(Model& m);
-		void UpdateMvpBuffer(uint32_t frameIndex, GameObject3D* go);
+		void CreateMeshGeometry(Mesh& m, const std::vector<Vertex>& verts, const std::vector<uint16_t>& indices, const glm::vec4& quantization = glm::vec4(0.0f));
+		void CreateMeshGeometry(Mesh& m, const std::vector<Vertex>& verts, const std::vector<uint32_t>& indices, const glm::vec4& quantization = glm::vec4(0.0f));
+		void CreateMeshGeometry(Mesh& m, const std::vector<Vertex>& verts, const void* pIndices, uint32_t indexCount, VkIndexType indexType, const glm::vec4& quantization);
+		VertexLayout ChooseVertexLayout(const Mesh& m, const std::vector<Vertex>& verts, const glm::vec4& quantization) const;
+		static void WriteVertices(const std::vector<Vertex>& verts, VertexLayout layout, const glm::vec4& quantization, uint8_t* pOut);
+		static glm::vec4 CalculateQuantization(const aiScene* pScene);
+		static glm::mat4 GetShaderWorld(const glm::mat4& world, const Model& m);
+		void CreateBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags props, VkBuffer& buffer, Allocation& alloc);
+		void DestroyBuffer(VkBuffer& buffer, Allocation& alloc);
+		void CreateShaderLayouts();
+		void CreateBindlessSet();
+		void WriteObjectConstants(GameObject3D* pGo, MVP* pMvp);
+		bool WriteCameraConstants(uint32_t& outOffset);
+		static bool ShaderUsesPushConstants(const std::vector<char>& code);
+		static bool ShaderUsesStorageBuffer(const std::vector<char>& code);
+		static bool ShaderReadsInputLocation(const std::vector<char>& code, uint32_t location);
+		static bool ShaderDisablesEarlyDepth(const std::vector<char>& code);
+		static bool ShaderHasInvariantPosition(const std::vector<char>& code);
+		void PrepareInstanceGroups(VkCommandBuffer cmdBuffer);
+		void WriteIndirectCommands();
+		uint32_t WriteVisibleInstances(InstanceGroup& group, const Model& model, InstanceData* pInstances);
+		void DrawInstanceGroups(VkCommandBuffer cmdBuffer, std::optional<uint32_t>& cameraOffset, ShaderPass pass);
+		static void CalculateBounds(Mesh& m, const std::vector<Vertex>& verts);
+		static void CalculateBounds(Model& m);
+		void BuildDrawList();
+		float GetPixelsPerUnit(const glm::mat4& world, const glm::vec4& localSphere) const;
+		uint32_t SelectLod(const Mesh& mesh, float pixelsPerUnit) const;
+		void OptimizeMesh(std::vector<Vertex>& verts, std::vector<uint32_t>& indices);
+		void GenerateLods(const std::vector<Vertex>& verts, const std::vector<uint32_t>& indices, std::vector<uint32_t>& outIndices, std::vector<MeshLod>& outLods);
+		bool PrepareDrawChunk(DrawChunk& chunk);
+		void PrepareDrawChunks();
+		void RecordDrawList(VkCommandBuffer cmdBuffer, DrawChunk& chunk, std::optional<uint32_t> cameraOffset, ShaderPass pass);
+		void RecordScenePass(VkCommandBuffer cmdBuffer, const VkRenderPassBeginInfo& rpInfo, std::optional<uint32_t>& cameraOffset, ShaderPass pass);
+		void RecordSecondaryBuffers(VkCommandBuffer cmdBuffer, const VkRenderPassBeginInfo& rpInfo, std::optional<uint32_t>& cameraOffset, ShaderPass pass);
+		void SetViewportAndScissor(VkCommandBuffer cmdBuffer);
 		void CreateDescriptorPool(Shader& shader);
-		void CreateDescriptorSets(Model& m, Shader& shader);
-		void CreateDescriptorSets(GameObject3D* pGo);
+		void CreateDescriptorSets(Shader& shader);
+		bool IsModelReady(Model& m);
         uint32_t GenerateExclusiveShaderId();
         uint32_t GenerateExclusiveModelId();
         uint32_t GenerateExclusiveTextureId();
+        void RecordFrameTime();
         void ProcessNode(aiNode* pNode, const aiScene* pScene, Model& outMdl);
-        Mesh ProcessMesh(aiMesh* pMesh, const aiScene* pScene);
+        void ProcessMesh(aiMesh* pMesh, const aiScene* pScene, Model& outMdl);
+        void SplitIntoMeshlets(const std::vector<Vertex>& verts, const std::vector<uint32_t>& indices, Model& outMdl);
+        uint32_t CreateModel(Mesh& mesh);
 
     private:
 		std::vector<Shader> vecShaders;
+		std::multimap<uint64_t, ShaderModuleEntry> mShaderModules; //Content hash -> module
+		std::multimap<uint64_t, PipelineStateEntry> mPipelineStates; //PipelineState hash -> pipeline
+		ShaderCacheStats mShaderCacheStats;
+		VkDescriptorSetLayout mObjectSetLayout; //Single dynamic uniform buffer, same for every shader
+		VkPipelineLayout mPipelineLayouts[2]; //Indexed by push constant use
+		std::map<uint64_t, PipelineStateEntry*> mPendingPipelines; //Compiler ticket -> entry waiting for it
+		bool mAsyncPipelines = false; //LoadShader returns before its pipelines are compiled
+		VkDescriptorSetLayout mBindlessSetLayout = VK_NULL_HANDLE;
+		VkPipelineLayout mBindlessPipelineLayout = VK_NULL_HANDLE;
+		VkDescriptorPool mBindlessPool = VK_NULL_HANDLE;
+		VkDescriptorSet mBindlessSet = VK_NULL_HANDLE; //Shared by every bindless shader and frame, frame is picked by push constant
+		uint32_t mBindlessTextureCapacity = 0;
+		uint32_t mBindlessTextureCount = 0;
+		bool mBindless = false; //Device supports descriptor indexing and config enabled it
 		std::vector<Model> vecModels;
         std::vector<GameObject3D*> vecObjects;
+        std::vector<InstanceGroup> vecInstanceGroups;
+        std::map<uint64_t, uint32_t> mInstanceGroupLookup; //(shader index << 32 | model index) -> group
+        DrawList mDrawList; //Rebuilt from vecObjects every frame
+        Frustum mFrustum; //Camera frustum of current frame
+        SphereSet mCullSpheres;
+        std::vector<uint8_t> vecVisible;
+        std::vector<GameObject3D*> vecCullCandidates;
+        bool mCpuCulling = true; //Objects outside of the frustum never reach draw list
+        DynamicBvh mSpatialTree; //World bounds of every drawable object, refitted when object moves
+        std::vector<GameObject3D*> vecSpatialResults;
+        bool mSpatialCulling = false; //Draw list candidates come from frustum query of spatial tree
+        ThreadPool mWorkers;
+        OcclusionBuffer mOcclusion;
+        OcclusionStats mOcclusionStats;
+        bool mOcclusionCulling = false;
+        bool mOcclusionReady = false; //UpdateOcclusion ran for the frame being recorded
+        DrawStats mDrawStats;
+        DrawStats mPrepassStats; //Folded into mDrawStats.mPrepassDrawCalls once the frame is recorded
+        std::vector<RecordContext> vecRecordContexts; //mRecordContextCount per frame in flight
+        std::vector<DrawChunk> vecDrawChunks;
+        std::vector<VkCommandBuffer> vecSecondaryBuffers;
+        uint32_t mRecordContextCount = 0; //Chunks of draw list plus one for instance groups
+        uint32_t mRecordThreads = 1; //Draw list is split into at most this many chunks
+        bool mParallelRecording = false; //Render pass content comes from secondary buffers recorded by worker threads
+        std::vector<IndirectCommand> vecIndirectCommands;
+        std::vector<IndirectBatch> vecIndirectBatches;
+        std::vector<VkBufferCopy> vecCounterCopies; //Culled group counters -> instanceCount of their commands
+        bool mGpuCulling = false; //Instance groups are frustum culled by compute pass, requires indirect draw
+        bool mIndirectDraw = false; //Instance groups are submitted with multi draw indirect
+        bool mDrawIndirectCount = false; //Draw count is read from buffer as well
+        uint32_t mMaxDrawIndirectCount = 1;
 		uint32_t mCurrentFrame = 0;
 		bool mFramebufferResized = false;
 		bool mPauseOnMimimize = false;
 		std::optional<uint32_t> mUsedShader;
 		glm::mat4 view;
 		glm::mat4 proj;
+		int mLodLevels = 0; //Simplified levels generated for imported meshes
+		float mLodTargetError = 0.0f; //Largest error of single level relative to mesh radius
+		float mLodErrorPixels = 0.0f; //Coarsest level whose error stays under this many pixels is drawn
+		bool mOptimizeMeshes = false; //Imported meshes are deduplicated and reordered for vertex cache, overdraw and fetch
+		bool mQuantizeVertices = false; //Imported meshes are packed into PackedVertex when precision allows it
+		float mQuantizePositionError = 0.0f; //Largest position error relative to mesh radius
+		float mQuantizeUvError = 0.0f; //Largest absolute error of half float UVs
+		VertexCacheStats mImportCacheBefore; //Summed over meshes of the model being imported
+		VertexCacheStats mImportCacheAfter;
+		std::vector<float> vecFrameTimes; //Circular history of frame times in ms
+		uint32_t mFrameTimeIndex = 0;
+		double mRecordTimeSum = 0.0;
+		uint32_t mRecordTimeCount = 0;
+		std::chrono::high_resolution_clock::time_point mLastFrameStart;
+		bool mPipelineStatistics = false; //Device features for fragment invocation queries are enabled
+		VkQueryPool mStatisticsPool = VK_NULL_HANDLE; //Fragment shader invocations of shading pass, one query per frame in flight
+		std::vector<uint32_t> vecStatisticsEpochs; //Stats epoch of the frame that wrote each query, 0 if nothing to read
+		uint32_t mStatisticsEpoch = 1; //Bumped by ResetFrameStats so queries of earlier frames are dropped
+		uint64_t mFragmentInvocationSum = 0;
+		double mFragmentsPerPixelSum = 0.0;
+		uint32_t mFragmentFrames = 0;
 
     private:
         VkInstance mInstance;
@@ -192,15 +604,38 @@ namespace Ngine
         VkDebugUtilsMessengerEXT mDebugMessenger;
         VkSurfaceKHR mSurface;
         QueueFamilyData mQueueData;
+        MemoryAllocator mAllocator;
+        PipelineCache mPipelineCache;
+        PipelineCompiler mCompiler;
+        StagingRing mStagingRing;
+        UploadManager mUploader;
+        GeometryArena mGeometry;
+        FrameUniformAllocator mFrameUniforms;
+        FrameUniformAllocator mFrameInstances; //Per instance vertex data, rewritten every frame
+        FrameUniformAllocator mFrameIndirect; //Indirect draw commands and draw counts, used only with indirect draw
+        FrameUniformAllocator mBindlessObjects; //Camera followed by BindlessObject array, used only with bindless set
+        GpuCuller mCuller;
+        RenderGraph mRenderGraph; //Rebuilt every frame, owns barriers between passes and layout of swapchain images
+        std::string mRenderGraphDumpPath; //Cleared after first frame is dumped
         VkQueue mGraphicsQueue;
         VkQueue mPresentationQueue;
+        VkQueue mTransferQueue;
         VkSwapchainKHR mSwapchain;
 		std::vector<VkImageView> vecSwapImageViews;
 		std::vector<VkImage> vecSwapImages;
 		VkFormat mSwapFormat;
 		VkExtent2D mSwapExtent;
-		VkRenderPass mRenderPass;
-		std::vector<VkFramebuffer> vecFrameBuffers;
+		VkRenderPass mRenderPass; //Color and depth, both cleared
+		VkRenderPass mPrepassRenderPass = VK_NULL_HANDLE; //Depth only, cleared and kept for shading
+		VkRenderPass mAfterPrepassRenderPass = VK_NULL_HANDLE; //Compatible with mRenderPass, loads depth of pre-pass
+		std::vector<VkFramebuffer> vecFrameBuffers; //Created by the first frame that uses the current depth view
+		VkFramebuffer mPrepassFrameBuffer = VK_NULL_HANDLE;
+		VkImageView mFrameBufferDepthView = VK_NULL_HANDLE; //Transient depth view of render graph the framebuffers point at
+		std::vector<std::pair<uint32_t, VkFramebuffer>> vecRetiredFrameBuffers; //Frame in flight that replaced them -> framebuffer
+		VkFormat mDepthFormat = VK_FORMAT_UNDEFINED; //Depth image itself is a transient of render graph, declared every frame
+		VkImageAspectFlags mDepthAspect = 0;
+		bool mDepthPrepassPipelines = false; //[General] DepthPrepass, shaders get pre-pass variants of their pipelines
+		bool mDepthPrepass = false; //Frames are drawn with pre-pass, only possible when the variants exist
 		VkCommandPool mCmdPool;
 		std::vector<VkSemaphore> vecImgAvSemaphores;
 		std::vector<VkSemaphore> vecRenderFinsihSemaphores;
@@ -0,0 +1,95 @@
+#pragma once
+#include "Core.hxx"
+
+namespace Ngine
+{
+    //Generic offset/size free list used to carve ranges out of a bigger resource
+    class RangeAllocator
+    {
+    public:
+        RangeAllocator() = default;
+        RangeAllocator(uint64_t size);
+
+        bool Allocate(uint64_t size, uint64_t alignment, uint64_t& outOffset);
+        void Free(uint64_t offset, uint64_t size);
+
+        inline uint64_t GetSize() const noexcept { return mSize; }
+        inline uint64_t GetUsed() const noexcept { return mUsed; }
+        inline bool IsEmpty() const noexcept { return mUsed == 0; }
+
+    private:
+        struct FreeRange
+        {
+            uint64_t mOffset = 0;
+            uint64_t mSize = 0;
+        };
+
+        std::vector<FreeRange> vecFreeRanges; //Sorted by offset, adjacent ranges are always merged
+        uint64_t mSize = 0;
+        uint64_t mUsed = 0;
+    };
+
+#if defined(TARGET_PLATFORM_LINUX)
+
+    //Range of device memory handed out by MemoryAllocator
+    struct Allocation
+    {
+        VkDeviceMemory mMemory = VK_NULL_HANDLE;
+        VkDeviceSize mOffset = 0;
+        VkDeviceSize mSize = 0;
+        uint32_t mPoolIndex = 0;
+        uint32_t mBlockIndex = 0;
+        void* pMapped = nullptr; //Pointer to first byte of allocation (only for host visible memory)
+    };
+
+    struct AllocatorStats
+    {
+        uint32_t mDeviceAllocations = 0; //Number of currently alive vkAllocateMemory allocations
+        uint32_t mTotalDeviceAllocations = 0; //Number of vkAllocateMemory calls since startup
+        uint32_t mSubAllocations = 0; //Number of currently alive suballocations
+        VkDeviceSize mBytesReserved = 0; //Memory obtained from the driver
+        VkDeviceSize mBytesUsed = 0; //Memory handed out to resources
+    };
+
+    class MemoryAllocator
+    {
+    private:
+        class MemoryBlock
+        {
+        public:
+            VkDeviceMemory mMemory = VK_NULL_HANDLE;
+            void* pMapped = nullptr;
+            RangeAllocator mRanges;
+            uint32_t mAllocationCount = 0;
+            bool mDedicated = false;
+        };
+
+    public:
+        void Initialize(VkPhysicalDevice physDevice, VkDevice device);
+        void Destroy();
+
+        Allocation Allocate(const VkMemoryRequirements& req, VkMemoryPropertyFlags props, bool optimalTiling = false);
+        void Free(Allocation& alloc);
+
+        AllocatorStats GetStats() const;
+        void LogStats() const;
+
+    private:
+        uint32_t FindMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags props);
+        VkDeviceSize GetPreferredBlockSize(uint32_t typeIndex);
+        uint32_t CreateBlock(uint32_t poolIndex, VkDeviceSize size, bool dedicated);
+        void ReleaseBlock(MemoryBlock& block);
+
+    private:
+        VkDevice mDevice = VK_NULL_HANDLE;
+        VkPhysicalDeviceMemoryProperties mMemProps = {};
+        uint32_t mMaxAllocationCount = 0;
+        VkDeviceSize mDeviceBlockSize = 0;
+        VkDeviceSize mHostBlockSize = 0;
+        AllocatorStats mStats;
+
+        //Linear (buffer) and optimal (image) resources are kept in separate pools so bufferImageGranularity never matters
+        std::vector<MemoryBlock> vecPools[VK_MAX_MEMORY_TYPES * 2];
+    };
+#endif
+}
\ No newline at end of file
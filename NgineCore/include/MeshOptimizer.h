@@ -0,0 +1,42 @@
+#pragma once
+#include "Core.hxx"
+
+namespace Ngine
+{
+#if defined(TARGET_PLATFORM_LINUX)
+
+    //Result of replaying an index list through a FIFO post-transform cache
+    struct VertexCacheStats
+    {
+        uint64_t mTriangles = 0;
+        uint64_t mVertices = 0; //Distinct vertices referenced by indices
+        uint64_t mMisses = 0; //Vertex shader invocations
+
+        inline void Add(const VertexCacheStats& other) noexcept { mTriangles += other.mTriangles; mVertices += other.mVertices; mMisses += other.mMisses; }
+        inline float GetAcmr() const noexcept { return mTriangles > 0 ? (float)mMisses / mTriangles : 0.0f; } //Misses per triangle, 0.5 is ideal
+        inline float GetAtvr() const noexcept { return mVertices > 0 ? (float)mMisses / mVertices : 0.0f; } //Misses per vertex, 1.0 is ideal
+    };
+
+    //Import time reordering of triangle lists, every step keeps the mesh looking exactly the same
+    class MeshOptimizer
+    {
+    public:
+        static constexpr uint32_t CACHE_SIZE = 16;
+
+        //Points indices of byte-identical vertices to the first of them, duplicates are dropped by OptimizeVertexFetch
+        static void WeldIndices(const void* pVertices, size_t vertexCount, size_t stride, const std::vector<uint32_t>& vecIndices, std::vector<uint32_t>& vecOut);
+
+        //Tipsify - fans around recently used vertices so they are still in post-transform cache when reused
+        static void OptimizeVertexCache(std::vector<uint32_t>& vecIndices, size_t vertexCount);
+
+        //Keeps cache friendly clusters but draws outward facing ones first so they occlude the rest of the mesh.
+        //Expects indices already ordered by OptimizeVertexCache.
+        static void OptimizeOverdraw(std::vector<uint32_t>& vecIndices, const std::vector<glm::vec3>& vecPositions);
+
+        //Stores vertices in order of first use and drops unreferenced ones, returns new vertex count
+        static size_t OptimizeVertexFetch(void* pVertices, size_t vertexCount, size_t stride, std::vector<uint32_t>& vecIndices);
+
+        static VertexCacheStats AnalyzeVertexCache(const std::vector<uint32_t>& vecIndices, size_t vertexCount);
+    };
+#endif
+}
\ No newline at end of file
@@ -0,0 +1,19 @@
+#pragma once
+#include "Core.hxx"
+
+namespace Ngine
+{
+#if defined(TARGET_PLATFORM_LINUX)
+
+    //Quadric error edge collapse over an index list. Vertices are never moved or created, a collapsed vertex is
+    //replaced by its neighbour, so every simplified list can be drawn from the original vertex buffer.
+    class MeshSimplifier
+    {
+    public:
+        //Collapses edges until index count drops to target or next collapse would exceed maxError (model space distance).
+        //Border vertices and vertices sharing position with another one (attribute seams) are kept in place.
+        //Returns largest error of all performed collapses.
+        static float Simplify(const std::vector<glm::vec3>& vecPositions, const std::vector<uint32_t>& vecIndices, size_t targetIndexCount, float maxError, std::vector<uint32_t>& vecOut);
+    };
+#endif
+}
\ No newline at end of file
@@ -0,0 +1,57 @@
+#pragma once
+#include "Core.hxx"
+#include "ThreadPool.h"
+
+namespace Ngine
+{
+#if defined(TARGET_PLATFORM_LINUX)
+
+    //Low resolution depth buffer filled on the CPU from occluder meshes, used to reject objects hidden behind them.
+    //Stores 1/w so depth interpolates linearly in screen space, bigger value is closer to the camera.
+    //Screen is split into tiles rasterized in parallel, every tile also keeps its farthest depth for quick rejects.
+    class OcclusionBuffer
+    {
+    private:
+        struct ScreenTriangle
+        {
+            float edgeA[3], edgeB[3], edgeC[3]; //Edge functions, pixel is inside when all three are non negative
+            float depthA, depthB, depthC; //1/w plane
+            int32_t minX, minY, maxX, maxY; //Pixel bounds, inclusive
+        };
+
+    public:
+        static constexpr uint32_t TILE_WIDTH = 32;
+        static constexpr uint32_t TILE_HEIGHT = 16;
+
+        void Initialize(uint32_t width, uint32_t height, ThreadPool* pPool);
+
+        void BeginFrame(const glm::mat4& viewProj);
+        void AddOccluder(const glm::mat4& world, const std::vector<glm::vec3>& vecPositions, const std::vector<uint32_t>& vecIndices);
+        void Rasterize();
+
+        //Conservative - anything that crosses near plane or is not fully hidden is reported visible
+        bool IsVisible(const glm::vec3& boundsMin, const glm::vec3& boundsMax) const;
+
+        inline uint32_t GetWidth() const noexcept { return mWidth; }
+        inline uint32_t GetHeight() const noexcept { return mHeight; }
+        inline uint32_t GetTriangleCount() const noexcept { return vecTriangles.size(); }
+        inline const float* GetDepth() const noexcept { return vecDepth.data(); }
+
+    private:
+        void RasterizeTile(uint32_t tile);
+        void SetupTriangle(const glm::vec4& c0, const glm::vec4& c1, const glm::vec4& c2);
+
+    private:
+        ThreadPool* pWorkers = nullptr;
+        uint32_t mWidth = 0; //Multiple of tile width
+        uint32_t mHeight = 0; //Multiple of tile height
+        uint32_t mTilesX = 0;
+        uint32_t mTilesY = 0;
+        glm::mat4 mViewProj = glm::mat4(1.0f);
+        std::vector<float> vecDepth;
+        std::vector<float> vecTileFarthest; //Smallest 1/w inside every tile
+        std::vector<ScreenTriangle> vecTriangles;
+        std::vector<std::vector<uint32_t>> vecTileBins; //Triangles overlapping every tile
+    };
+#endif
+}
\ No newline at end of file
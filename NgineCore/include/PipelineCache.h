@@ -0,0 +1,57 @@
+#pragma once
+#include "Core.hxx"
+
+namespace Ngine
+{
+#if defined(TARGET_PLATFORM_LINUX)
+
+    //Written in front of driver data, lets truncated or damaged files be thrown away before the driver sees them
+    struct PipelineCacheFileHeader
+    {
+        uint32_t mMagic = 0;
+        uint32_t mVersion = 0;
+        uint64_t mDataSize = 0;
+        uint64_t mDataHash = 0; //FNV-1a of driver data
+        float mColdMsPerPipeline = 0.0f; //Creation time measured while cache was empty, used to estimate savings
+        uint32_t mPadding = 0;
+    };
+
+    //Driver pipeline cache seeded from disk at startup and written back at shutdown.
+    //File is replaced with rename so a crash during save never leaves half written cache behind.
+    class PipelineCache
+    {
+    public:
+        static const uint32_t FILE_MAGIC = 0x4350474E; //"NGPC"
+        static const uint32_t FILE_VERSION = 1;
+
+        void Initialize(VkDevice device, VkPhysicalDevice physDevice, const std::string& path);
+        void Destroy();
+        void Save();
+
+        //Time spent in vkCreate*Pipelines, returns estimate of time saved by warm cache in ms
+        double RecordCreation(double ms, uint32_t pipelineCount);
+
+        inline VkPipelineCache GetHandle() const noexcept { return mCache; }
+        inline bool IsWarm() const noexcept { return mWarm; }
+
+        //FNV-1a, also used to key shader modules and pipeline states
+        static uint64_t Hash(const void* pData, size_t size);
+
+    private:
+        bool LoadFile(std::vector<char>& outData);
+        bool IsCompatible(const std::vector<char>& data) const;
+
+    private:
+        VkDevice mDevice = VK_NULL_HANDLE;
+        VkPipelineCache mCache = VK_NULL_HANDLE;
+        VkPhysicalDeviceProperties mDeviceProps = {};
+        std::string mPath;
+        uint64_t mLoadedHash = 0;
+        float mColdMsPerPipeline = 0.0f;
+        double mCreateMs = 0.0;
+        uint32_t mCreateCount = 0;
+        double mSavedMs = 0.0;
+        bool mWarm = false; //Driver accepted data loaded from disk
+    };
+#endif
+}
\ No newline at end of file
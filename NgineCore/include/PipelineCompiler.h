@@ -0,0 +1,57 @@
+#pragma once
+#include "Core.hxx"
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <deque>
+
+namespace Ngine
+{
+#if defined(TARGET_PLATFORM_LINUX)
+
+    //Finished job, handed back to the thread that submitted it
+    struct PipelineCompileResult
+    {
+        uint64_t mTicket = 0;
+        VkPipeline mPipeline = VK_NULL_HANDLE;
+        VkResult mResult = VK_SUCCESS;
+        double mCompileMs = 0.0;
+    };
+
+    //Background threads that run pipeline creation so loading shaders never blocks the frame loop.
+    //Jobs only touch thread safe Vulkan objects, results are collected and published by the owner thread.
+    class PipelineCompiler
+    {
+    private:
+        class Job
+        {
+        public:
+            uint64_t mTicket = 0;
+            std::function<VkResult(VkPipeline&)> mCompile;
+        };
+
+    public:
+        void Initialize(uint32_t threadCount);
+        void Destroy(); //Waits for jobs that already started, queued ones are dropped
+
+        //Returns ticket that identifies the result of this job
+        uint64_t Submit(const std::function<VkResult(VkPipeline&)>& compile);
+        void Collect(std::vector<PipelineCompileResult>& outResults);
+
+        inline uint32_t GetThreadCount() const noexcept { return vecThreads.size(); }
+
+    private:
+        void WorkerLoop();
+
+    private:
+        std::vector<std::thread> vecThreads;
+        std::mutex mMutex;
+        std::condition_variable mWake;
+        std::deque<Job> mQueue;
+        std::vector<PipelineCompileResult> vecResults;
+        uint64_t mNextTicket = 1;
+        bool mStop = false;
+    };
+#endif
+}
\ No newline at end of file
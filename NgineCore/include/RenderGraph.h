@@ -0,0 +1,188 @@
+#pragma once
+#include "Core.hxx"
+#include "MemoryAllocator.h"
+#include <functional>
+
+namespace Ngine
+{
+#if defined(TARGET_PLATFORM_LINUX)
+
+    //How a pass touches a resource, decides stage, access and image layout of barriers around it
+    enum class RenderGraphUsage : uint32_t
+    {
+        ColorAttachment = 0,
+        DepthAttachment,
+        DepthRead, //Depth test without writes
+        Sampled,
+        ComputeRead,
+        ComputeWrite,
+        TransferSrc,
+        TransferDst,
+        IndirectRead,
+        VertexRead,
+        Count
+    };
+
+    typedef uint32_t RenderGraphHandle;
+
+    //Image owned by the graph, its memory is shared with transient images that are never alive at the same time
+    struct RenderGraphImageDesc
+    {
+        VkFormat mFormat = VK_FORMAT_UNDEFINED;
+        VkExtent2D mExtent = {};
+        VkImageUsageFlags mUsage = 0;
+        VkImageAspectFlags mAspect = VK_IMAGE_ASPECT_COLOR_BIT;
+    };
+
+    struct RenderGraphStats
+    {
+        uint32_t mPasses = 0;
+        uint32_t mCulledPasses = 0; //Nothing they write reaches an output
+        uint32_t mImageBarriers = 0;
+        uint32_t mBufferBarriers = 0;
+        uint32_t mBarrierBatches = 0; //vkCmdPipelineBarrier calls
+        VkDeviceSize mTransientBytes = 0; //Memory backing transient images
+        VkDeviceSize mTransientBytesUnaliased = 0; //What they would take without aliasing
+    };
+
+    //Frame is declared every frame as passes with reads and writes of imported and transient resources.
+    //Compile drops passes whose results are never used, places the fewest barriers that keep every hazard
+    //ordered and packs transient images into shared memory by lifetime. Execute records passes in declaration order.
+    class RenderGraph
+    {
+    private:
+        //Synchronization scope of the last accesses to a resource or to a block of aliased memory
+        class ResourceState
+        {
+        public:
+            VkPipelineStageFlags mWriteStages = 0;
+            VkAccessFlags mWriteAccess = 0;
+            VkPipelineStageFlags mReadStages = 0; //Readers since the last write, later writes have to wait for them
+            VkPipelineStageFlags mVisibleStages = 0; //Stages that already waited for the last write
+            VkAccessFlags mVisibleAccess = 0;
+            VkImageLayout mLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        };
+
+        class Resource
+        {
+        public:
+            std::string mName;
+            bool mIsImage = false;
+            bool mTransient = false;
+            bool mOutput = false;
+            VkImage mImage = VK_NULL_HANDLE;
+            VkImageView mView = VK_NULL_HANDLE;
+            VkBuffer mBuffer = VK_NULL_HANDLE;
+            VkImageAspectFlags mAspect = 0;
+            VkImageLayout mFinalLayout = VK_IMAGE_LAYOUT_UNDEFINED; //Outputs are left in it after the last pass
+            VkPipelineStageFlags mReadyStage = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT; //Imported images wait for it before first use
+            uint32_t mTransientIndex = 0;
+            ResourceState mState;
+            uint32_t mFirstPass = UINT32_MAX;
+            uint32_t mLastPass = 0;
+        };
+
+        class Access
+        {
+        public:
+            RenderGraphHandle mResource = 0;
+            RenderGraphUsage mUsage = RenderGraphUsage::ColorAttachment;
+            bool mWrite = false; //Declared with Write, attachment loaded and stored is declared with both
+        };
+
+        class Pass
+        {
+        public:
+            std::string mName;
+            std::vector<Access> vecAccesses;
+            std::function<void(VkCommandBuffer)> mExecute;
+            bool mCulled = false;
+            VkPipelineStageFlags mSrcStages = 0;
+            VkPipelineStageFlags mDstStages = 0;
+            std::vector<VkImageMemoryBarrier> vecImageBarriers;
+            std::vector<VkBufferMemoryBarrier> vecBufferBarriers;
+        };
+
+        //Transient image kept between frames, recreated only when its description changes
+        class TransientImage
+        {
+        public:
+            std::string mName;
+            RenderGraphImageDesc mDesc;
+            VkImage mImage = VK_NULL_HANDLE;
+            VkImageView mView = VK_NULL_HANDLE;
+            VkMemoryRequirements mMemReq = {};
+            VkDeviceSize mOffset = 0; //Within shared transient allocation
+            uint32_t mFirstPass = 0;
+            uint32_t mLastPass = 0;
+            ResourceState mState; //Last use, images placed over the same memory wait for it
+            bool mUsed = false; //Declared in the current frame
+        };
+
+        //Images and memory replaced by repacking, frames still in flight may use them
+        class RetiredTransients
+        {
+        public:
+            uint32_t mFrameIndex = 0; //Destroyed once this frame in flight comes around again
+            std::vector<VkImage> vecImages;
+            std::vector<VkImageView> vecViews;
+            Allocation mAlloc;
+        };
+
+    public:
+        void Initialize(VkDevice device, MemoryAllocator* pAllocator);
+        void Destroy();
+
+        //Called once fence of the frame in flight was waited for, destroys transients retired by its previous use
+        void BeginFrame(uint32_t frameIndex);
+
+        //Clears passes and imported resources of the previous frame, transient images are kept for reuse
+        void Reset();
+
+        RenderGraphHandle ImportImage(const char* name, VkImage image, VkImageView view, VkImageAspectFlags aspect, VkPipelineStageFlags readyStage);
+        RenderGraphHandle ImportBuffer(const char* name, VkBuffer buffer);
+        RenderGraphHandle CreateImage(const char* name, const RenderGraphImageDesc& desc);
+        void MarkOutput(RenderGraphHandle resource, VkImageLayout finalLayout = VK_IMAGE_LAYOUT_UNDEFINED);
+
+        uint32_t AddPass(const char* name, const std::function<void(VkCommandBuffer)>& execute);
+        void Read(uint32_t pass, RenderGraphHandle resource, RenderGraphUsage usage);
+        void Write(uint32_t pass, RenderGraphHandle resource, RenderGraphUsage usage);
+
+        void Compile();
+        void Execute(VkCommandBuffer cmdBuffer);
+
+        //Graphviz description of the last compiled frame
+        bool Dump(const std::string& path) const;
+
+        VkImageView GetImageView(RenderGraphHandle resource) const;
+        inline RenderGraphStats GetStats() const noexcept { return mStats; }
+
+    private:
+        void CullPasses();
+        bool TransientsNeedPacking() const;
+        void AllocateTransients();
+        void RetireTransients();
+        void DestroyRetired(RetiredTransients& retired);
+        static bool LifetimesOverlap(const TransientImage& a, const TransientImage& b);
+        static bool MemoryOverlaps(const TransientImage& a, const TransientImage& b);
+        void PlaceBarriers();
+        void AddBarrier(Pass& pass, Resource& resource, ResourceState& state, VkPipelineStageFlags stages, VkAccessFlags access, VkImageLayout layout, bool write);
+        static bool IsWrite(RenderGraphUsage usage);
+        static bool CanRead(RenderGraphUsage usage);
+        static const char* GetUsageName(RenderGraphUsage usage);
+
+    private:
+        VkDevice mDevice = VK_NULL_HANDLE;
+        MemoryAllocator* pAllocator = nullptr;
+        std::vector<Resource> vecResources;
+        std::vector<Pass> vecPasses;
+        std::vector<TransientImage> vecTransients;
+        std::vector<RetiredTransients> vecRetired;
+        uint32_t mFrameIndex = 0;
+        Pass mFinalBarriers; //Moves outputs into their final layout after the last pass
+        Allocation mTransientAlloc;
+        bool mTransientsDirty = false; //Description or lifetimes changed, memory has to be packed again
+        RenderGraphStats mStats;
+    };
+#endif
+}
\ No newline at end of file
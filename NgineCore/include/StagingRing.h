@@ -0,0 +1,66 @@
+#pragma once
+#include "Core.hxx"
+#include "MemoryAllocator.h"
+
+namespace Ngine
+{
+#if defined(TARGET_PLATFORM_LINUX)
+
+    //Piece of staging memory that upload data can be written into
+    struct StagingRegion
+    {
+        VkBuffer mBuffer = VK_NULL_HANDLE;
+        VkDeviceSize mOffset = 0;
+        void* pData = nullptr;
+    };
+
+    //Persistently mapped ring buffer used as source of all buffer uploads
+    class StagingRing
+    {
+    private:
+        class FallbackBuffer
+        {
+        public:
+            VkBuffer mBuffer = VK_NULL_HANDLE;
+            Allocation mAlloc;
+        };
+
+        //Bytes consumed by one submission, released once its fence is signaled
+        class Submission
+        {
+        public:
+            VkFence mFence = VK_NULL_HANDLE;
+            VkDeviceSize mBytes = 0;
+            std::vector<FallbackBuffer> vecFallbacks;
+        };
+
+    public:
+        void Initialize(VkDevice device, MemoryAllocator* pAllocator, VkDeviceSize size);
+        void Destroy();
+
+        StagingRegion Allocate(VkDeviceSize size, VkDeviceSize alignment = 16);
+        void Retire(VkFence fence);
+        void Reclaim();
+
+        inline VkDeviceSize GetSize() const noexcept { return mSize; }
+        inline uint32_t GetFallbackCount() const noexcept { return mFallbackCount; }
+
+    private:
+        bool WaitForOldestSubmission();
+        StagingRegion AllocateFallback(VkDeviceSize size);
+
+    private:
+        VkDevice mDevice = VK_NULL_HANDLE;
+        MemoryAllocator* pAllocator = nullptr;
+        VkBuffer mBuffer = VK_NULL_HANDLE;
+        Allocation mAlloc;
+        VkDeviceSize mSize = 0;
+        VkDeviceSize mHead = 0; //Next byte that will be written
+        VkDeviceSize mUsed = 0; //Bytes between tail and head (retired and not yet retired)
+        VkDeviceSize mPendingBytes = 0; //Bytes allocated since last Retire()
+        uint32_t mFallbackCount = 0;
+        std::vector<FallbackBuffer> vecPendingFallbacks;
+        std::deque<Submission> dqSubmissions;
+    };
+#endif
+}
\ No newline at end of file
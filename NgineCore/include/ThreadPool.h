@@ -0,0 +1,43 @@
+#pragma once
+#include "Core.hxx"
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <functional>
+
+namespace Ngine
+{
+#if defined(TARGET_PLATFORM_LINUX)
+
+    //Fixed set of worker threads that split index ranges between them. Calling thread takes part in the work
+    //and ParallelFor only returns once every index was processed, so jobs can reference locals of the caller.
+    class ThreadPool
+    {
+    public:
+        void Initialize(uint32_t workerCount);
+        void Destroy();
+
+        //Runs job(index) for every index in [0, count), must only be called from one thread at a time
+        void ParallelFor(uint32_t count, const std::function<void(uint32_t)>& job);
+
+        inline uint32_t GetThreadCount() const noexcept { return vecThreads.size() + 1; }
+
+    private:
+        void WorkerLoop();
+        void RunJobs();
+
+    private:
+        std::vector<std::thread> vecThreads;
+        std::mutex mMutex;
+        std::condition_variable mWake;
+        std::condition_variable mDone;
+        const std::function<void(uint32_t)>* pJob = nullptr;
+        std::atomic<uint32_t> mNextIndex = 0;
+        uint32_t mCount = 0;
+        uint32_t mBusyWorkers = 0;
+        uint64_t mGeneration = 0; //Bumped for every ParallelFor so sleeping workers know there is new work
+        bool mStop = false;
+    };
+#endif
+}
\ No newline at end of file
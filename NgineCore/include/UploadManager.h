@@ -0,0 +1,73 @@
+#pragma once
+#include "Core.hxx"
+#include "StagingRing.h"
+
+namespace Ngine
+{
+#if defined(TARGET_PLATFORM_LINUX)
+
+    struct UploadStats
+    {
+        uint32_t mBatches = 0; //Number of submitted upload batches
+        uint32_t mCopies = 0; //Number of recorded buffer copies
+        VkDeviceSize mBytes = 0; //Bytes copied through staging memory
+    };
+
+    //Records buffer uploads into batches that are submitted together and tracked with tickets.
+    //Ticket is a number of the batch holding the copy, 0 means "nothing to wait for".
+    //When uploads run on a queue family other than graphics one, every batch releases its buffers
+    //and the graphics queue acquires them with RecordAcquireBarriers() before they count as complete.
+    class UploadManager
+    {
+    private:
+        class Batch
+        {
+        public:
+            VkCommandBuffer mCmdBuffer = VK_NULL_HANDLE;
+            VkFence mFence = VK_NULL_HANDLE;
+            uint64_t mTicket = 0;
+            uint32_t mCopyCount = 0;
+            bool mInFlight = false;
+            std::vector<VkBufferMemoryBarrier> vecOwnershipBarriers;
+        };
+
+    public:
+        void Initialize(VkDevice device, VkQueue queue, uint32_t queueFamily, uint32_t dstQueueFamily, StagingRing* pRing, uint32_t batchCount);
+        void Destroy();
+
+        uint64_t Upload(VkBuffer dst, VkDeviceSize dstOffset, const void* pData, VkDeviceSize size);
+        uint64_t Flush();
+        void Update();
+        void RecordAcquireBarriers(VkCommandBuffer cmdBuffer);
+
+        bool IsComplete(uint64_t ticket);
+        void Wait(uint64_t ticket);
+
+        inline UploadStats GetStats() const noexcept { return mStats; }
+        inline bool UsesOwnershipTransfer() const noexcept { return mSrcQueueFamily != mDstQueueFamily; }
+
+    private:
+        Batch& BeginBatch();
+        void Poll();
+        void AddOwnershipBarrier(Batch& batch, VkBuffer dst, VkDeviceSize offset, VkDeviceSize size);
+
+    private:
+        VkDevice mDevice = VK_NULL_HANDLE;
+        VkQueue mQueue = VK_NULL_HANDLE;
+        VkCommandPool mCmdPool = VK_NULL_HANDLE;
+        uint32_t mSrcQueueFamily = 0;
+        uint32_t mDstQueueFamily = 0;
+        StagingRing* pRing = nullptr;
+        std::vector<Batch> vecBatches;
+        std::optional<uint32_t> mOpenBatch; //Batch that is currently being recorded
+        uint32_t mNextBatch = 0;
+        VkDeviceSize mBatchBytes = 0;
+        uint64_t mNextTicket = 1;
+        uint64_t mSubmittedTicket = 0;
+        uint64_t mFinishedTicket = 0; //Last batch with signaled fence
+        uint64_t mCompletedTicket = 0; //Last batch that can be used by graphics queue
+        std::vector<VkBufferMemoryBarrier> vecPendingAcquires;
+        UploadStats mStats;
+    };
+#endif
+}
\ No newline at end of file
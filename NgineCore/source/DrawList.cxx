@@ -0,0 +1,58 @@
+#include "DrawList.h"
+#include <cstring>
+
+namespace Ngine
+{
+#if defined(TARGET_PLATFORM_LINUX)
+
+    uint64_t DrawList::MakeSortKey(uint32_t pipeline, uint32_t descriptorSet, uint32_t geometry, float depth)
+    {
+        //Bit pattern of non negative float grows with its value, so its top bits work as unsigned depth
+        if(!(depth > 0.0f))
+            depth = 0.0f;
+
+        uint32_t depthBits;
+        memcpy(&depthBits, &depth, sizeof(depthBits));
+
+        return ((uint64_t)(pipeline & 0xFFFF) << 48) |
+            ((uint64_t)(descriptorSet & 0xFF) << 40) |
+            ((uint64_t)(geometry & 0xFFFF) << 24) |
+            (uint64_t)(depthBits >> 7);
+    }
+
+    void DrawList::Sort()
+    {
+        size_t count = vecPackets.size();
+        if(count < 2)
+            return;
+
+        vecScratch.resize(count);
+
+        //LSD radix sort, one byte per pass - stable so packets with equal keys keep order of insertion
+        for(uint32_t shift = 0; shift < 64; shift += 8)
+        {
+            size_t histogram[256] = {};
+            for(auto& packet : vecPackets)
+                histogram[(packet.mSortKey >> shift) & 0xFF]++;
+
+            //Every key has the same byte here, pass would not move anything
+            if(histogram[(vecPackets[0].mSortKey >> shift) & 0xFF] == count)
+                continue;
+
+            size_t offset = 0;
+            for(auto& bucket : histogram)
+            {
+                size_t bucketSize = bucket;
+                bucket = offset;
+                offset += bucketSize;
+            }
+
+            for(auto& packet : vecPackets)
+                vecScratch[histogram[(packet.mSortKey >> shift) & 0xFF]++] = packet;
+
+            vecPackets.swap(vecScratch);
+        }
+    }
+
+#endif
+}
\ No newline at end of file
@@ -0,0 +1,430 @@
+#include "DynamicBvh.h"
+#include <algorithm>
+
+namespace Ngine
+{
+#if defined(TARGET_PLATFORM_LINUX)
+
+    static inline float SurfaceArea(const glm::vec3& boundsMin, const glm::vec3& boundsMax)
+    {
+        glm::vec3 size = boundsMax - boundsMin;
+        return 2.0f * (size.x * size.y + size.y * size.z + size.z * size.x);
+    }
+
+    static inline bool Contains(const glm::vec3& outerMin, const glm::vec3& outerMax, const glm::vec3& innerMin, const glm::vec3& innerMax)
+    {
+        return outerMin.x <= innerMin.x && outerMin.y <= innerMin.y && outerMin.z <= innerMin.z &&
+            outerMax.x >= innerMax.x && outerMax.y >= innerMax.y && outerMax.z >= innerMax.z;
+    }
+
+    static inline bool Overlaps(const glm::vec3& aMin, const glm::vec3& aMax, const glm::vec3& bMin, const glm::vec3& bMax)
+    {
+        return aMin.x <= bMax.x && aMin.y <= bMax.y && aMin.z <= bMax.z &&
+            aMax.x >= bMin.x && aMax.y >= bMin.y && aMax.z >= bMin.z;
+    }
+
+    DynamicBvh::DynamicBvh(float margin)
+    {
+        mMargin = margin;
+    }
+
+    int32_t DynamicBvh::Insert(GameObject3D* pObject, const glm::vec3& boundsMin, const glm::vec3& boundsMax)
+    {
+        int32_t proxy = AllocateNode();
+
+        vecNodes[proxy].mMin = boundsMin - glm::vec3(mMargin);
+        vecNodes[proxy].mMax = boundsMax + glm::vec3(mMargin);
+        vecNodes[proxy].pObject = pObject;
+        vecNodes[proxy].mHeight = 0;
+
+        InsertLeaf(proxy);
+        mProxyCount++;
+
+        return proxy;
+    }
+
+    void DynamicBvh::Remove(int32_t proxy)
+    {
+        RemoveLeaf(proxy);
+        FreeNode(proxy);
+        mProxyCount--;
+    }
+
+    bool DynamicBvh::Move(int32_t proxy, const glm::vec3& boundsMin, const glm::vec3& boundsMax)
+    {
+        //Still inside of enlarged box, nothing above this leaf has to change
+        if(Contains(vecNodes[proxy].mMin, vecNodes[proxy].mMax, boundsMin, boundsMax))
+            return false;
+
+        RemoveLeaf(proxy);
+
+        vecNodes[proxy].mMin = boundsMin - glm::vec3(mMargin);
+        vecNodes[proxy].mMax = boundsMax + glm::vec3(mMargin);
+
+        InsertLeaf(proxy);
+        return true;
+    }
+
+    void DynamicBvh::QueryFrustum(const Frustum& frustum, std::vector<GameObject3D*>& vecOut) const
+    {
+        if(mRoot == -1)
+            return;
+
+        vecStack.clear();
+        vecStack.push_back(mRoot);
+
+        while(!vecStack.empty())
+        {
+            const Node& node = vecNodes[vecStack.back()];
+            vecStack.pop_back();
+
+            if(!frustum.IntersectsBox(node.mMin, node.mMax))
+                continue;
+
+            if(node.IsLeaf())
+                vecOut.push_back(node.pObject);
+            else
+            {
+                vecStack.push_back(node.mChild1);
+                vecStack.push_back(node.mChild2);
+            }
+        }
+    }
+
+    void DynamicBvh::QueryAabb(const glm::vec3& boundsMin, const glm::vec3& boundsMax, std::vector<GameObject3D*>& vecOut) const
+    {
+        if(mRoot == -1)
+            return;
+
+        vecStack.clear();
+        vecStack.push_back(mRoot);
+
+        while(!vecStack.empty())
+        {
+            const Node& node = vecNodes[vecStack.back()];
+            vecStack.pop_back();
+
+            if(!Overlaps(node.mMin, node.mMax, boundsMin, boundsMax))
+                continue;
+
+            if(node.IsLeaf())
+                vecOut.push_back(node.pObject);
+            else
+            {
+                vecStack.push_back(node.mChild1);
+                vecStack.push_back(node.mChild2);
+            }
+        }
+    }
+
+    void DynamicBvh::QueryRay(const glm::vec3& origin, const glm::vec3& direction, float maxDistance, std::vector<GameObject3D*>& vecOut) const
+    {
+        if(mRoot == -1)
+            return;
+
+        //Division by zero gives infinity which slab test handles on its own
+        glm::vec3 invDirection = glm::vec3(1.0f) / direction;
+
+        vecStack.clear();
+        vecStack.push_back(mRoot);
+
+        while(!vecStack.empty())
+        {
+            const Node& node = vecNodes[vecStack.back()];
+            vecStack.pop_back();
+
+            glm::vec3 t1 = (node.mMin - origin) * invDirection;
+            glm::vec3 t2 = (node.mMax - origin) * invDirection;
+            glm::vec3 tNear = glm::min(t1, t2);
+            glm::vec3 tFar = glm::max(t1, t2);
+
+            float enter = std::max(std::max(tNear.x, tNear.y), std::max(tNear.z, 0.0f));
+            float exit = std::min(std::min(tFar.x, tFar.y), std::min(tFar.z, maxDistance));
+
+            if(enter > exit)
+                continue;
+
+            if(node.IsLeaf())
+                vecOut.push_back(node.pObject);
+            else
+            {
+                vecStack.push_back(node.mChild1);
+                vecStack.push_back(node.mChild2);
+            }
+        }
+    }
+
+    void DynamicBvh::TransformBounds(const glm::mat4& world, const glm::vec3& localMin, const glm::vec3& localMax, glm::vec3& outMin, glm::vec3& outMax)
+    {
+        //Center is transformed as a point, extent by absolute value of rotation and scale part
+        glm::vec3 center = glm::vec3(world * glm::vec4((localMin + localMax) * 0.5f, 1.0f));
+        glm::vec3 extent = (localMax - localMin) * 0.5f;
+        glm::vec3 worldExtent = glm::abs(glm::vec3(world[0])) * extent.x + glm::abs(glm::vec3(world[1])) * extent.y + glm::abs(glm::vec3(world[2])) * extent.z;
+
+        outMin = center - worldExtent;
+        outMax = center + worldExtent;
+    }
+
+    int32_t DynamicBvh::AllocateNode()
+    {
+        if(mFreeList == -1)
+        {
+            vecNodes.push_back(Node());
+            return vecNodes.size() - 1;
+        }
+
+        int32_t index = mFreeList;
+        mFreeList = vecNodes[index].mParent;
+        vecNodes[index] = Node();
+
+        return index;
+    }
+
+    void DynamicBvh::FreeNode(int32_t index)
+    {
+        vecNodes[index] = Node();
+        vecNodes[index].mParent = mFreeList;
+        mFreeList = index;
+    }
+
+    void DynamicBvh::InsertLeaf(int32_t leaf)
+    {
+        if(mRoot == -1)
+        {
+            mRoot = leaf;
+            vecNodes[leaf].mParent = -1;
+            return;
+        }
+
+        glm::vec3 leafMin = vecNodes[leaf].mMin;
+        glm::vec3 leafMax = vecNodes[leaf].mMax;
+
+        //Walk down choosing the child that grows the least, stop when pairing with current node is cheaper
+        int32_t index = mRoot;
+        while(!vecNodes[index].IsLeaf())
+        {
+            const Node& node = vecNodes[index];
+            float area = SurfaceArea(node.mMin, node.mMax);
+            float combinedArea = SurfaceArea(glm::min(node.mMin, leafMin), glm::max(node.mMax, leafMax));
+
+            //Cost of new parent here and cost pushed down to every level below
+            float cost = 2.0f * combinedArea;
+            float inheritanceCost = 2.0f * (combinedArea - area);
+
+            float childCost[2];
+            int32_t children[2] = { node.mChild1, node.mChild2 };
+
+            for(int c = 0; c < 2; c++)
+            {
+                const Node& child = vecNodes[children[c]];
+                float grownArea = SurfaceArea(glm::min(child.mMin, leafMin), glm::max(child.mMax, leafMax));
+
+                if(child.IsLeaf())
+                    childCost[c] = grownArea + inheritanceCost;
+                else
+                    childCost[c] = grownArea - SurfaceArea(child.mMin, child.mMax) + inheritanceCost;
+            }
+
+            if(cost < childCost[0] && cost < childCost[1])
+                break;
+
+            index = childCost[0] < childCost[1] ? children[0] : children[1];
+        }
+
+        int32_t sibling = index;
+        int32_t oldParent = vecNodes[sibling].mParent;
+        int32_t newParent = AllocateNode();
+
+        vecNodes[newParent].mParent = oldParent;
+        vecNodes[newParent].mMin = glm::min(vecNodes[sibling].mMin, leafMin);
+        vecNodes[newParent].mMax = glm::max(vecNodes[sibling].mMax, leafMax);
+        vecNodes[newParent].mHeight = vecNodes[sibling].mHeight + 1;
+        vecNodes[newParent].mChild1 = sibling;
+        vecNodes[newParent].mChild2 = leaf;
+
+        if(oldParent != -1)
+        {
+            if(vecNodes[oldParent].mChild1 == sibling)
+                vecNodes[oldParent].mChild1 = newParent;
+            else
+                vecNodes[oldParent].mChild2 = newParent;
+        }
+        else
+            mRoot = newParent;
+
+        vecNodes[sibling].mParent = newParent;
+        vecNodes[leaf].mParent = newParent;
+
+        FixUpwards(newParent);
+    }
+
+    void DynamicBvh::RemoveLeaf(int32_t leaf)
+    {
+        if(leaf == mRoot)
+        {
+            mRoot = -1;
+            return;
+        }
+
+        int32_t parent = vecNodes[leaf].mParent;
+        int32_t grandParent = vecNodes[parent].mParent;
+        int32_t sibling = vecNodes[parent].mChild1 == leaf ? vecNodes[parent].mChild2 : vecNodes[parent].mChild1;
+
+        //Sibling takes place of the parent
+        if(grandParent != -1)
+        {
+            if(vecNodes[grandParent].mChild1 == parent)
+                vecNodes[grandParent].mChild1 = sibling;
+            else
+                vecNodes[grandParent].mChild2 = sibling;
+
+            vecNodes[sibling].mParent = grandParent;
+            FreeNode(parent);
+            FixUpwards(grandParent);
+        }
+        else
+        {
+            mRoot = sibling;
+            vecNodes[sibling].mParent = -1;
+            FreeNode(parent);
+        }
+
+        vecNodes[leaf].mParent = -1;
+    }
+
+    void DynamicBvh::FixUpwards(int32_t index)
+    {
+        while(index != -1)
+        {
+            index = Balance(index);
+
+            Node& node = vecNodes[index];
+            const Node& child1 = vecNodes[node.mChild1];
+            const Node& child2 = vecNodes[node.mChild2];
+
+            node.mHeight = 1 + std::max(child1.mHeight, child2.mHeight);
+            node.mMin = glm::min(child1.mMin, child2.mMin);
+            node.mMax = glm::max(child1.mMax, child2.mMax);
+
+            index = node.mParent;
+        }
+    }
+
+    int32_t DynamicBvh::Balance(int32_t iA)
+    {
+        Node& A = vecNodes[iA];
+        if(A.IsLeaf() || A.mHeight < 2)
+            return iA;
+
+        int32_t iB = A.mChild1;
+        int32_t iC = A.mChild2;
+        Node& B = vecNodes[iB];
+        Node& C = vecNodes[iC];
+
+        int32_t balance = C.mHeight - B.mHeight;
+
+        //Right side is too deep - C becomes parent of A and its deeper child stays under it
+        if(balance > 1)
+        {
+            int32_t iF = C.mChild1;
+            int32_t iG = C.mChild2;
+            Node& F = vecNodes[iF];
+            Node& G = vecNodes[iG];
+
+            C.mChild1 = iA;
+            C.mParent = A.mParent;
+            A.mParent = iC;
+
+            if(C.mParent != -1)
+            {
+                if(vecNodes[C.mParent].mChild1 == iA)
+                    vecNodes[C.mParent].mChild1 = iC;
+                else
+                    vecNodes[C.mParent].mChild2 = iC;
+            }
+            else
+                mRoot = iC;
+
+            if(F.mHeight > G.mHeight)
+            {
+                C.mChild2 = iF;
+                A.mChild2 = iG;
+                G.mParent = iA;
+                A.mMin = glm::min(B.mMin, G.mMin);
+                A.mMax = glm::max(B.mMax, G.mMax);
+                C.mMin = glm::min(A.mMin, F.mMin);
+                C.mMax = glm::max(A.mMax, F.mMax);
+                A.mHeight = 1 + std::max(B.mHeight, G.mHeight);
+                C.mHeight = 1 + std::max(A.mHeight, F.mHeight);
+            }
+            else
+            {
+                C.mChild2 = iG;
+                A.mChild2 = iF;
+                F.mParent = iA;
+                A.mMin = glm::min(B.mMin, F.mMin);
+                A.mMax = glm::max(B.mMax, F.mMax);
+                C.mMin = glm::min(A.mMin, G.mMin);
+                C.mMax = glm::max(A.mMax, G.mMax);
+                A.mHeight = 1 + std::max(B.mHeight, F.mHeight);
+                C.mHeight = 1 + std::max(A.mHeight, G.mHeight);
+            }
+
+            return iC;
+        }
+
+        //Left side is too deep - mirrored rotation with B
+        if(balance < -1)
+        {
+            int32_t iD = B.mChild1;
+            int32_t iE = B.mChild2;
+            Node& D = vecNodes[iD];
+            Node& E = vecNodes[iE];
+
+            B.mChild1 = iA;
+            B.mParent = A.mParent;
+            A.mParent = iB;
+
+            if(B.mParent != -1)
+            {
+                if(vecNodes[B.mParent].mChild1 == iA)
+                    vecNodes[B.mParent].mChild1 = iB;
+                else
+                    vecNodes[B.mParent].mChild2 = iB;
+            }
+            else
+                mRoot = iB;
+
+            if(D.mHeight > E.mHeight)
+            {
+                B.mChild2 = iD;
+                A.mChild1 = iE;
+                E.mParent = iA;
+                A.mMin = glm::min(C.mMin, E.mMin);
+                A.mMax = glm::max(C.mMax, E.mMax);
+                B.mMin = glm::min(A.mMin, D.mMin);
+                B.mMax = glm::max(A.mMax, D.mMax);
+                A.mHeight = 1 + std::max(C.mHeight, E.mHeight);
+                B.mHeight = 1 + std::max(A.mHeight, D.mHeight);
+            }
+            else
+            {
+                B.mChild2 = iE;
+                A.mChild1 = iD;
+                D.mParent = iA;
+                A.mMin = glm::min(C.mMin, D.mMin);
+                A.mMax = glm::max(C.mMax, D.mMax);
+                B.mMin = glm::min(A.mMin, E.mMin);
+                B.mMax = glm::max(A.mMax, E.mMax);
+                A.mHeight = 1 + std::max(C.mHeight, D.mHeight);
+                B.mHeight = 1 + std::max(A.mHeight, E.mHeight);
+            }
+
+            return iB;
+        }
+
+        return iA;
+    }
+
+#endif
+}
\ No newline at end of file
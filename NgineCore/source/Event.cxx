@@ -62,6 +62,14 @@ namespace Ngine
                 break;
             }
 
+            case EventType::EventType_ShaderReady:
+            {
+                EventShaderReady* pCastedEvent = reinterpret_cast<EventShaderReady*>(pEvent);
+                mDefaultHandler.vecEvents.push_back(pCastedEvent);
+                mDefaultHandler.vecEvents[mDefaultHandler.vecEvents.size() - 1]->mType = type;
+                break;
+            }
+
             default:
             {
                 LOG_F(ERROR, "Unrecoginzed event type was passed!");
@@ -0,0 +1,78 @@
+#include "FrameUniformAllocator.h"
+#include "Exception.h"
+
+namespace Ngine
+{
+#if defined(TARGET_PLATFORM_LINUX)
+
+    void FrameUniformAllocator::Initialize(VkDevice device, MemoryAllocator* pAlloc, VkDeviceSize sizePerFrame, VkDeviceSize alignment, VkBufferUsageFlags usage)
+    {
+        mDevice = device;
+        pAllocator = pAlloc;
+        mSize = sizePerFrame;
+        mAlignment = alignment > 0 ? alignment : 1;
+
+        vecFrames.resize(MAX_FRAMES_IN_FLIGHT);
+
+        for(auto& frame : vecFrames)
+        {
+            VkBufferCreateInfo bufferInfo = {};
+            bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+            bufferInfo.size = sizePerFrame;
+            bufferInfo.usage = usage;
+            bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+            VkResult res = vkCreateBuffer(mDevice, &bufferInfo, nullptr, &frame.mBuffer);
+            VK_THROW_IF_FAILED(res);
+
+            VkMemoryRequirements memReq;
+            vkGetBufferMemoryRequirements(mDevice, frame.mBuffer, &memReq);
+
+            frame.mAlloc = pAllocator->Allocate(memReq, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+
+            res = vkBindBufferMemory(mDevice, frame.mBuffer, frame.mAlloc.mMemory, frame.mAlloc.mOffset);
+            VK_THROW_IF_FAILED(res);
+        }
+
+        LOG_F(INFO, "Frame uniform allocator created (%llu KB per frame, alignment = %llu)", (unsigned long long)(sizePerFrame >> 10), (unsigned long long)mAlignment);
+    }
+
+    void FrameUniformAllocator::Destroy()
+    {
+        for(auto& frame : vecFrames)
+        {
+            vkDestroyBuffer(mDevice, frame.mBuffer, nullptr);
+            pAllocator->Free(frame.mAlloc);
+        }
+
+        vecFrames.clear();
+    }
+
+    void FrameUniformAllocator::BeginFrame(uint32_t frameIndex)
+    {
+        //Caller has already waited for the fence of this frame so its whole buffer can be overwritten
+        mFrameIndex = frameIndex;
+        mHead = 0;
+    }
+
+    void* FrameUniformAllocator::Allocate(VkDeviceSize size, uint32_t& outOffset)
+    {
+        VkDeviceSize aligned = (mHead + mAlignment - 1) / mAlignment * mAlignment;
+
+        if(aligned + size > mSize)
+        {
+            LOG_IF_F(ERROR, !mOverflowReported, "Per frame buffer is full (%llu KB), increase its size in [Memory] section of config", (unsigned long long)(mSize >> 10));
+            mOverflowReported = true;
+            return nullptr;
+        }
+
+        mHead = aligned + size;
+        if(mHead > mPeakUsage)
+            mPeakUsage = mHead;
+
+        outOffset = (uint32_t)aligned;
+        return static_cast<char*>(vecFrames[mFrameIndex].mAlloc.pMapped) + aligned;
+    }
+
+#endif
+}
\ No newline at end of file
@@ -0,0 +1,193 @@
+#include "Frustum.h"
+#include <bit>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define NGINE_CULL_X86
+#endif
+
+namespace Ngine
+{
+#if defined(TARGET_PLATFORM_LINUX)
+
+#if defined(NGINE_CULL_X86)
+    //Compiled for AVX2 regardless of build flags, called only after CPU support was checked
+    __attribute__((target("avx2"))) static uint32_t CullSpheresAVX2(const Frustum& frustum, const SphereSet& spheres, uint8_t* pVisible, size_t count)
+    {
+        __m256 planeX[6], planeY[6], planeZ[6], planeW[6];
+        for(int p = 0; p < 6; p++)
+        {
+            planeX[p] = _mm256_set1_ps(frustum.planes[p].x);
+            planeY[p] = _mm256_set1_ps(frustum.planes[p].y);
+            planeZ[p] = _mm256_set1_ps(frustum.planes[p].z);
+            planeW[p] = _mm256_set1_ps(frustum.planes[p].w);
+        }
+
+        uint32_t visibleCount = 0;
+        const __m256 zero = _mm256_setzero_ps();
+
+        for(size_t i = 0; i < count; i += 8)
+        {
+            __m256 x = _mm256_loadu_ps(&spheres.vecX[i]);
+            __m256 y = _mm256_loadu_ps(&spheres.vecY[i]);
+            __m256 z = _mm256_loadu_ps(&spheres.vecZ[i]);
+            __m256 negRadius = _mm256_sub_ps(zero, _mm256_loadu_ps(&spheres.vecRadius[i]));
+            __m256 inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+
+            for(int p = 0; p < 6; p++)
+            {
+                __m256 dist = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(planeX[p], x), _mm256_mul_ps(planeY[p], y)),
+                    _mm256_add_ps(_mm256_mul_ps(planeZ[p], z), planeW[p]));
+                inside = _mm256_and_ps(inside, _mm256_cmp_ps(dist, negRadius, _CMP_GE_OQ));
+            }
+
+            uint32_t mask = _mm256_movemask_ps(inside);
+            for(int j = 0; j < 8; j++)
+                pVisible[i + j] = (mask >> j) & 1;
+
+            visibleCount += std::popcount(mask);
+        }
+
+        return visibleCount;
+    }
+
+    static uint32_t CullSpheresSSE(const Frustum& frustum, const SphereSet& spheres, uint8_t* pVisible, size_t count)
+    {
+        uint32_t visibleCount = 0;
+
+        //Two 4 wide halves per iteration so planes are broadcast once for 8 spheres
+        for(size_t i = 0; i < count; i += 8)
+        {
+            __m128 x[2] = { _mm_loadu_ps(&spheres.vecX[i]), _mm_loadu_ps(&spheres.vecX[i + 4]) };
+            __m128 y[2] = { _mm_loadu_ps(&spheres.vecY[i]), _mm_loadu_ps(&spheres.vecY[i + 4]) };
+            __m128 z[2] = { _mm_loadu_ps(&spheres.vecZ[i]), _mm_loadu_ps(&spheres.vecZ[i + 4]) };
+            __m128 negRadius[2] = { _mm_sub_ps(_mm_setzero_ps(), _mm_loadu_ps(&spheres.vecRadius[i])), _mm_sub_ps(_mm_setzero_ps(), _mm_loadu_ps(&spheres.vecRadius[i + 4])) };
+            __m128 inside[2] = { _mm_castsi128_ps(_mm_set1_epi32(-1)), _mm_castsi128_ps(_mm_set1_epi32(-1)) };
+
+            for(int p = 0; p < 6; p++)
+            {
+                __m128 planeX = _mm_set1_ps(frustum.planes[p].x);
+                __m128 planeY = _mm_set1_ps(frustum.planes[p].y);
+                __m128 planeZ = _mm_set1_ps(frustum.planes[p].z);
+                __m128 planeW = _mm_set1_ps(frustum.planes[p].w);
+
+                for(int h = 0; h < 2; h++)
+                {
+                    __m128 dist = _mm_add_ps(_mm_add_ps(_mm_mul_ps(planeX, x[h]), _mm_mul_ps(planeY, y[h])),
+                        _mm_add_ps(_mm_mul_ps(planeZ, z[h]), planeW));
+                    inside[h] = _mm_and_ps(inside[h], _mm_cmpge_ps(dist, negRadius[h]));
+                }
+            }
+
+            uint32_t mask = _mm_movemask_ps(inside[0]) | (_mm_movemask_ps(inside[1]) << 4);
+            for(int j = 0; j < 8; j++)
+                pVisible[i + j] = (mask >> j) & 1;
+
+            visibleCount += std::popcount(mask);
+        }
+
+        return visibleCount;
+    }
+#endif
+
+    void SphereSet::Add(const glm::vec3& center, float radius)
+    {
+        vecX.push_back(center.x);
+        vecY.push_back(center.y);
+        vecZ.push_back(center.z);
+        vecRadius.push_back(radius);
+    }
+
+    void SphereSet::Add(const glm::mat4& world, const glm::vec4& localSphere)
+    {
+        glm::vec3 center = glm::vec3(world * glm::vec4(glm::vec3(localSphere), 1.0f));
+
+        //Non uniform scale stretches sphere into ellipsoid, largest axis keeps it enclosed
+        float scale = std::max(glm::length(glm::vec3(world[0])), std::max(glm::length(glm::vec3(world[1])), glm::length(glm::vec3(world[2]))));
+        Add(center, localSphere.w * scale);
+    }
+
+    Frustum Frustum::FromMatrix(const glm::mat4& viewProj)
+    {
+        Frustum frustum;
+
+        //Rows of view projection matrix, glm stores columns
+        glm::vec4 row[4];
+        for(int i = 0; i < 4; i++)
+            row[i] = glm::vec4(viewProj[0][i], viewProj[1][i], viewProj[2][i], viewProj[3][i]);
+
+        //Vulkan clip space has depth in 0..w so near plane is the third row alone
+        frustum.planes[0] = row[3] + row[0];
+        frustum.planes[1] = row[3] - row[0];
+        frustum.planes[2] = row[3] + row[1];
+        frustum.planes[3] = row[3] - row[1];
+        frustum.planes[4] = row[2];
+        frustum.planes[5] = row[3] - row[2];
+
+        for(auto& plane : frustum.planes)
+            plane /= glm::length(glm::vec3(plane));
+
+        return frustum;
+    }
+
+    bool Frustum::IntersectsSphere(const glm::vec3& center, float radius) const
+    {
+        for(auto& plane : planes)
+        {
+            if(glm::dot(glm::vec3(plane), center) + plane.w < -radius)
+                return false;
+        }
+
+        return true;
+    }
+
+    bool Frustum::IntersectsBox(const glm::vec3& boundsMin, const glm::vec3& boundsMax) const
+    {
+        for(auto& plane : planes)
+        {
+            //Only the corner furthest along the plane normal has to be tested
+            glm::vec3 corner = glm::vec3(plane.x >= 0.0f ? boundsMax.x : boundsMin.x, plane.y >= 0.0f ? boundsMax.y : boundsMin.y, plane.z >= 0.0f ? boundsMax.z : boundsMin.z);
+
+            if(glm::dot(glm::vec3(plane), corner) + plane.w < 0.0f)
+                return false;
+        }
+
+        return true;
+    }
+
+    uint32_t Frustum::CullSpheres(const SphereSet& spheres, uint8_t* pVisible) const
+    {
+        size_t count = spheres.GetSize();
+        size_t vectorCount = count & ~(size_t)7;
+        uint32_t visibleCount = 0;
+
+#if defined(NGINE_CULL_X86)
+        static const bool hasAVX2 = __builtin_cpu_supports("avx2");
+
+        if(hasAVX2)
+            visibleCount = CullSpheresAVX2(*this, spheres, pVisible, vectorCount);
+        else
+            visibleCount = CullSpheresSSE(*this, spheres, pVisible, vectorCount);
+#else
+        vectorCount = 0;
+#endif
+
+        //Remaining spheres that do not fill whole vector
+        return visibleCount + CullSpheresScalar(spheres, pVisible, vectorCount);
+    }
+
+    uint32_t Frustum::CullSpheresScalar(const SphereSet& spheres, uint8_t* pVisible, size_t first) const
+    {
+        uint32_t visibleCount = 0;
+
+        for(size_t i = first; i < spheres.GetSize(); i++)
+        {
+            pVisible[i] = IntersectsSphere(glm::vec3(spheres.vecX[i], spheres.vecY[i], spheres.vecZ[i]), spheres.vecRadius[i]) ? 1 : 0;
+            visibleCount += pVisible[i];
+        }
+
+        return visibleCount;
+    }
+
+#endif
+}
\ No newline at end of file
@@ -1,4 +1,5 @@
 #include "GameObject.h"
+#include "DynamicBvh.h"
 
 namespace Ngine {
     GameObject3D::GameObject3D(uint32_t model, uint32_t shader)
@@ -69,5 +70,15 @@ namespace Ngine {
         mWorld = glm::translate(mWorld, mTranslation);
         //Scale model
         mWorld = glm::scale(mWorld, mScale);
+
+#if defined(TARGET_PLATFORM_LINUX)
+        //Refit leaf of the object, tree only changes when it leaves its enlarged box
+        if(pSpatialTree != nullptr && mSpatialProxy != -1)
+        {
+            glm::vec3 boundsMin, boundsMax;
+            DynamicBvh::TransformBounds(mWorld, mLocalBoundsMin, mLocalBoundsMax, boundsMin, boundsMax);
+            pSpatialTree->Move(mSpatialProxy, boundsMin, boundsMax);
+        }
+#endif
     }
 }
\ No newline at end of file
@@ -0,0 +1,149 @@
+#include "GeometryArena.h"
+#include "Exception.h"
+#include <algorithm>
+
+namespace Ngine
+{
+#if defined(TARGET_PLATFORM_LINUX)
+
+    void GeometryArena::Initialize(VkDevice device, MemoryAllocator* pAlloc, VkDeviceSize vertexPageSize, VkDeviceSize indexPageSize)
+    {
+        mDevice = device;
+        pAllocator = pAlloc;
+        mVertexPageSize = vertexPageSize;
+        mIndexPageSize = indexPageSize;
+
+        //First page is created up front so most scenes never need another one
+        CreatePage(mVertexPageSize, mIndexPageSize);
+
+        LOG_F(INFO, "Geometry arena created (vertex page = %llu MB, index page = %llu MB)",
+            (unsigned long long)(vertexPageSize >> 20), (unsigned long long)(indexPageSize >> 20));
+    }
+
+    void GeometryArena::Destroy()
+    {
+        for(auto& page : vecPages)
+        {
+            vkDestroyBuffer(mDevice, page.mVertexBuffer, nullptr);
+            vkDestroyBuffer(mDevice, page.mIndexBuffer, nullptr);
+            pAllocator->Free(page.mVertexAlloc);
+            pAllocator->Free(page.mIndexAlloc);
+        }
+
+        vecPages.clear();
+    }
+
+    GeometryAllocation GeometryArena::Allocate(VkDeviceSize vertexSize, VkDeviceSize vertexStride, VkDeviceSize indexSize, VkDeviceSize indexStride)
+    {
+        GeometryAllocation result;
+
+        //Vertices and indices of one mesh always share a page so it can be drawn with single bind
+        for(uint32_t i = 0; i < vecPages.size(); i++)
+        {
+            if(AllocateFromPage(i, vertexSize, vertexStride, indexSize, indexStride, result))
+                return result;
+        }
+
+        //Meshes bigger than default page get a page of their own size
+        uint32_t pageIndex = CreatePage(std::max(mVertexPageSize, vertexSize), std::max(mIndexPageSize, indexSize));
+
+        if(!AllocateFromPage(pageIndex, vertexSize, vertexStride, indexSize, indexStride, result))
+        {
+            LOG_F(ERROR, "Cannot fit mesh into a fresh geometry page!");
+            throw Exception();
+        }
+
+        return result;
+    }
+
+    void GeometryArena::Free(GeometryAllocation& alloc)
+    {
+        if(!alloc.mValid)
+            return;
+
+        Page& page = vecPages[alloc.mPage];
+        page.mVertexRanges.Free(alloc.mVertexOffset, alloc.mVertexSize);
+
+        if(alloc.mIndexSize > 0)
+            page.mIndexRanges.Free(alloc.mIndexOffset, alloc.mIndexSize);
+
+        alloc = GeometryAllocation();
+    }
+
+    void GeometryArena::LogStats() const
+    {
+        VkDeviceSize vertexUsed = 0, vertexTotal = 0, indexUsed = 0, indexTotal = 0;
+
+        for(auto& page : vecPages)
+        {
+            vertexUsed += page.mVertexRanges.GetUsed();
+            vertexTotal += page.mVertexRanges.GetSize();
+            indexUsed += page.mIndexRanges.GetUsed();
+            indexTotal += page.mIndexRanges.GetSize();
+        }
+
+        LOG_F(INFO, "Geometry arena: %zu pages, vertices %llu/%llu KB, indices %llu/%llu KB", vecPages.size(),
+            (unsigned long long)(vertexUsed >> 10), (unsigned long long)(vertexTotal >> 10),
+            (unsigned long long)(indexUsed >> 10), (unsigned long long)(indexTotal >> 10));
+    }
+
+    uint32_t GeometryArena::CreatePage(VkDeviceSize vertexSize, VkDeviceSize indexSize)
+    {
+        Page page;
+        CreatePageBuffer(vertexSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, page.mVertexBuffer, page.mVertexAlloc);
+        CreatePageBuffer(indexSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT, page.mIndexBuffer, page.mIndexAlloc);
+
+        page.mVertexRanges = RangeAllocator(vertexSize);
+        page.mIndexRanges = RangeAllocator(indexSize);
+
+        vecPages.push_back(page);
+
+        if(vecPages.size() > 1)
+            LOG_F(INFO, "Geometry arena grew to %zu pages", vecPages.size());
+
+        return vecPages.size() - 1;
+    }
+
+    bool GeometryArena::AllocateFromPage(uint32_t pageIndex, VkDeviceSize vertexSize, VkDeviceSize vertexStride, VkDeviceSize indexSize, VkDeviceSize indexStride, GeometryAllocation& outAlloc)
+    {
+        Page& page = vecPages[pageIndex];
+
+        //Offsets have to be multiple of element size so they can be turned into vertexOffset/firstIndex
+        if(!page.mVertexRanges.Allocate(vertexSize, vertexStride, outAlloc.mVertexOffset))
+            return false;
+
+        if(indexSize > 0 && !page.mIndexRanges.Allocate(indexSize, indexStride, outAlloc.mIndexOffset))
+        {
+            page.mVertexRanges.Free(outAlloc.mVertexOffset, vertexSize);
+            return false;
+        }
+
+        outAlloc.mPage = pageIndex;
+        outAlloc.mVertexSize = vertexSize;
+        outAlloc.mIndexSize = indexSize;
+        outAlloc.mValid = true;
+        return true;
+    }
+
+    void GeometryArena::CreatePageBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkBuffer& buffer, Allocation& alloc)
+    {
+        VkBufferCreateInfo bufferInfo = {};
+        bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+        bufferInfo.size = size;
+        bufferInfo.usage = usage;
+        bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+        VkResult res = vkCreateBuffer(mDevice, &bufferInfo, nullptr, &buffer);
+        VK_THROW_IF_FAILED(res);
+
+        VkMemoryRequirements memReq;
+        vkGetBufferMemoryRequirements(mDevice, buffer, &memReq);
+
+        alloc = pAllocator->Allocate(memReq, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+        res = vkBindBufferMemory(mDevice, buffer, alloc.mMemory, alloc.mOffset);
+        VK_THROW_IF_FAILED(res);
+    }
+
+#endif
+}
\ No newline at end of file
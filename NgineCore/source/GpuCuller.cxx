@@ -0,0 +1,206 @@
+#include "GpuCuller.h"
+#include "Exception.h"
+#include <fstream>
+
+namespace Ngine
+{
+#if defined(TARGET_PLATFORM_LINUX)
+
+    bool GpuCuller::Initialize(VkDevice device, MemoryAllocator* pAllocator, VkPipelineCache pipelineCache, const char* shaderPath, VkDeviceSize inputSizePerFrame, FrameUniformAllocator* pInstances, FrameUniformAllocator* pIndirectAlloc)
+    {
+        mDevice = device;
+        pIndirect = pIndirectAlloc;
+
+        std::ifstream shaderFile(shaderPath, std::ios::ate | std::ios::binary);
+        if (!shaderFile.is_open())
+        {
+            LOG_F(WARNING, "Cannot open %s, GPU culling is disabled", shaderPath);
+            return false;
+        }
+
+        size_t shaderSize = (size_t)shaderFile.tellg();
+
+        std::vector<char> shaderBuffer(shaderSize);
+        shaderFile.seekg(0);
+        shaderFile.read(shaderBuffer.data(), shaderSize);
+        shaderFile.close();
+
+        mInput.Initialize(mDevice, pAllocator, inputSizePerFrame, sizeof(CullInstance), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
+
+        CreateDescriptors(pInstances);
+        CreatePipeline(shaderBuffer, pipelineCache);
+
+        LOG_F(INFO, "GPU culling enabled (%llu instances per frame)", (unsigned long long)(inputSizePerFrame / sizeof(CullInstance)));
+        return true;
+    }
+
+    void GpuCuller::Destroy()
+    {
+        if(mPipeline == VK_NULL_HANDLE)
+            return;
+
+        vkDestroyPipeline(mDevice, mPipeline, nullptr);
+        vkDestroyPipelineLayout(mDevice, mPipelineLayout, nullptr);
+        vkDestroyDescriptorPool(mDevice, mDescPool, nullptr);
+        vkDestroyDescriptorSetLayout(mDevice, mDescLayout, nullptr);
+        vkDestroyShaderModule(mDevice, mShader, nullptr);
+        mInput.Destroy();
+
+        mPipeline = VK_NULL_HANDLE;
+        vecDescSets.clear();
+    }
+
+    void GpuCuller::BeginFrame(uint32_t frameIndex)
+    {
+        mFrameIndex = frameIndex;
+        mInstanceCount = 0;
+        mInput.BeginFrame(frameIndex);
+    }
+
+    CullInstance* GpuCuller::Allocate(uint32_t count)
+    {
+        //Instances are packed one after another so single dispatch covers all of them
+        uint32_t offset = 0;
+        CullInstance* pInstances = static_cast<CullInstance*>(mInput.Allocate(sizeof(CullInstance) * count, offset));
+
+        if(pInstances != nullptr)
+            mInstanceCount += count;
+
+        return pInstances;
+    }
+
+    void GpuCuller::RecordDispatch(VkCommandBuffer cmdBuffer, const Frustum& frustum)
+    {
+        if(mInstanceCount == 0)
+            return;
+
+        CullPushConstants constants = {};
+        for(int i = 0; i < 6; i++)
+            constants.planes[i] = frustum.planes[i];
+        constants.instanceCount = mInstanceCount;
+
+        vkCmdBindPipeline(cmdBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, mPipeline);
+        vkCmdBindDescriptorSets(cmdBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, mPipelineLayout, 0, 1, &vecDescSets[mFrameIndex], 0, nullptr);
+        vkCmdPushConstants(cmdBuffer, mPipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(constants), &constants);
+
+        //Shader works in groups of 64 invocations
+        vkCmdDispatch(cmdBuffer, (mInstanceCount + 63) / 64, 1, 1);
+    }
+
+    void GpuCuller::RecordCounterCopies(VkCommandBuffer cmdBuffer, const std::vector<VkBufferCopy>& vecCounterCopies)
+    {
+        if(mInstanceCount == 0 || vecCounterCopies.empty())
+            return;
+
+        VkBuffer indirectBuffer = pIndirect->GetBuffer(mFrameIndex);
+        vkCmdCopyBuffer(cmdBuffer, indirectBuffer, indirectBuffer, vecCounterCopies.size(), vecCounterCopies.data());
+    }
+
+    void GpuCuller::CreateDescriptors(FrameUniformAllocator* pInstances)
+    {
+        std::array<VkDescriptorSetLayoutBinding, 3> bindings = {};
+        for(uint32_t i = 0; i < bindings.size(); i++)
+        {
+            bindings[i].binding = i;
+            bindings[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+            bindings[i].descriptorCount = 1;
+            bindings[i].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+        }
+
+        VkDescriptorSetLayoutCreateInfo layoutInfo = {};
+        layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+        layoutInfo.bindingCount = bindings.size();
+        layoutInfo.pBindings = bindings.data();
+
+        VkResult res = vkCreateDescriptorSetLayout(mDevice, &layoutInfo, nullptr, &mDescLayout);
+        VK_THROW_IF_FAILED(res);
+
+        VkDescriptorPoolSize poolSize = {};
+        poolSize.type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        poolSize.descriptorCount = bindings.size() * MAX_FRAMES_IN_FLIGHT;
+
+        VkDescriptorPoolCreateInfo poolInfo = {};
+        poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+        poolInfo.poolSizeCount = 1;
+        poolInfo.pPoolSizes = &poolSize;
+        poolInfo.maxSets = MAX_FRAMES_IN_FLIGHT;
+
+        res = vkCreateDescriptorPool(mDevice, &poolInfo, nullptr, &mDescPool);
+        VK_THROW_IF_FAILED(res);
+
+        std::vector<VkDescriptorSetLayout> vecLayouts(MAX_FRAMES_IN_FLIGHT, mDescLayout);
+        vecDescSets.resize(MAX_FRAMES_IN_FLIGHT);
+
+        VkDescriptorSetAllocateInfo allocInfo = {};
+        allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+        allocInfo.descriptorPool = mDescPool;
+        allocInfo.descriptorSetCount = MAX_FRAMES_IN_FLIGHT;
+        allocInfo.pSetLayouts = vecLayouts.data();
+
+        res = vkAllocateDescriptorSets(mDevice, &allocInfo, vecDescSets.data());
+        VK_THROW_IF_FAILED(res);
+
+        //Sets point at whole per frame buffers, shader addresses them with absolute indexes so they never change
+        for(uint32_t frame = 0; frame < MAX_FRAMES_IN_FLIGHT; frame++)
+        {
+            VkBuffer buffers[] = { mInput.GetBuffer(frame), pInstances->GetBuffer(frame), pIndirect->GetBuffer(frame) };
+            std::array<VkDescriptorBufferInfo, 3> bufferInfos = {};
+            std::array<VkWriteDescriptorSet, 3> writes = {};
+
+            for(uint32_t i = 0; i < writes.size(); i++)
+            {
+                bufferInfos[i].buffer = buffers[i];
+                bufferInfos[i].offset = 0;
+                bufferInfos[i].range = VK_WHOLE_SIZE;
+
+                writes[i].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+                writes[i].dstSet = vecDescSets[frame];
+                writes[i].dstBinding = i;
+                writes[i].descriptorCount = 1;
+                writes[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+                writes[i].pBufferInfo = &bufferInfos[i];
+            }
+
+            vkUpdateDescriptorSets(mDevice, writes.size(), writes.data(), 0, nullptr);
+        }
+    }
+
+    void GpuCuller::CreatePipeline(const std::vector<char>& code, VkPipelineCache pipelineCache)
+    {
+        VkShaderModuleCreateInfo moduleInfo = {};
+        moduleInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+        moduleInfo.codeSize = code.size();
+        moduleInfo.pCode = reinterpret_cast<const uint32_t*>(code.data());
+
+        VkResult res = vkCreateShaderModule(mDevice, &moduleInfo, nullptr, &mShader);
+        VK_THROW_IF_FAILED(res);
+
+        VkPushConstantRange pushRange = {};
+        pushRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+        pushRange.offset = 0;
+        pushRange.size = sizeof(CullPushConstants);
+
+        VkPipelineLayoutCreateInfo layoutInfo = {};
+        layoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+        layoutInfo.setLayoutCount = 1;
+        layoutInfo.pSetLayouts = &mDescLayout;
+        layoutInfo.pushConstantRangeCount = 1;
+        layoutInfo.pPushConstantRanges = &pushRange;
+
+        res = vkCreatePipelineLayout(mDevice, &layoutInfo, nullptr, &mPipelineLayout);
+        VK_THROW_IF_FAILED(res);
+
+        VkComputePipelineCreateInfo pipelineInfo = {};
+        pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+        pipelineInfo.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+        pipelineInfo.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+        pipelineInfo.stage.module = mShader;
+        pipelineInfo.stage.pName = "main";
+        pipelineInfo.layout = mPipelineLayout;
+
+        res = vkCreateComputePipelines(mDevice, pipelineCache, 1, &pipelineInfo, nullptr, &mPipeline);
+        VK_THROW_IF_FAILED(res);
+    }
+
+#endif
+}
\ No newline at end of file
@@ -1,6 +1,7 @@
 #include "GraphicsCore.h"
 #include "Core.hxx"
 #include "Exception.h"
+#include "Event.h"
 #include "FileUtils.h"
 #include "GameObject.h"
 #include "assimp/Importer.hpp"
@@ -8,7 +9,11 @@
 #include "assimp/mesh.h"
 #include "assimp/postprocess.h"
 #include "assimp/scene.h"
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
 #include <cstdint>
+#include <set>
 #include <glm/ext/matrix_transform.hpp>
 #include <glm/geometric.hpp>
 #include <glm/trigonometric.hpp>
@@ -63,47 +68,107 @@ namespace Ngine
 
         ObtainQueueIndexes();
         CreateLogicDevice();
+        mAllocator.Initialize(mPhysDevice, mDevice);
+        mRenderGraph.Initialize(mDevice, &mAllocator);
+
+        //Graph of the first frame is written out once for inspection with Graphviz
+        mRenderGraphDumpPath = FileUtils::GetStringFromConfig("Resource/ngine.ini", "RenderGraph", "DumpPath");
+
+        //Pre-pass variants add two pipelines per shader and vertex layout, so they are built only when asked for
+        mDepthPrepassPipelines = FileUtils::GetBoolFromConfig("Resource/ngine.ini", "General", "DepthPrepass");
+        mDepthPrepass = mDepthPrepassPipelines;
+
+        std::string pipelineCachePath = FileUtils::GetStringFromConfig("Resource/ngine.ini", "General", "PipelineCache");
+        mPipelineCache.Initialize(mDevice, mPhysDevice, pipelineCachePath.empty() ? "Resource/pipeline.cache" : pipelineCachePath);
         CreateSwapchain(pWindow);
         CreateImageViews();
+        ChooseDepthFormat();
         CreateRenderPass();
-        CreateFrameBuffers();
         CreateCommandPool();
         CreateCommandBuffer();
         CreateSyncObjects();
+        CreateUploadManager();
+        CreateGeometryArena();
+        CreateFrameUniformAllocator();
+        CreateOcclusionBuffer();
+        CreateRecordContexts();
+        CreateStatisticsQueries();
+        CreateShaderLayouts();
+        CreateBindlessSet();
+
+        //Pipelines are compiled on background threads unless config asks LoadShader to block
+        int compileThreads = FileUtils::GetIntegerFromConfig("Resource/ngine.ini", "General", "PipelineCompileThreads");
+        mAsyncPipelines = !FileUtils::GetBoolFromConfig("Resource/ngine.ini", "General", "SyncPipelineCompile");
+        if(mAsyncPipelines)
+            mCompiler.Initialize(compileThreads > 0 ? compileThreads : 2);
+
+        int lodLevels = FileUtils::GetIntegerFromConfig("Resource/ngine.ini", "Lod", "Levels");
+        float lodError = FileUtils::GetFloatFromConfig("Resource/ngine.ini", "Lod", "TargetError");
+        float lodPixels = FileUtils::GetFloatFromConfig("Resource/ngine.ini", "Lod", "ErrorPixels");
+        mLodLevels = FileUtils::GetBoolFromConfig("Resource/ngine.ini", "Lod", "Disable") ? 0 : (lodLevels > 0 ? lodLevels : 4);
+        mLodTargetError = lodError > 0.0f ? lodError : 0.02f;
+        mLodErrorPixels = lodPixels > 0.0f ? lodPixels : 1.0f;
+
+        mOptimizeMeshes = FileUtils::GetBoolFromConfig("Resource/ngine.ini", "Mesh", "Optimize");
+
+        float positionError = FileUtils::GetFloatFromConfig("Resource/ngine.ini", "Mesh", "QuantizePositionError");
+        float uvError = FileUtils::GetFloatFromConfig("Resource/ngine.ini", "Mesh", "QuantizeUvError");
+        mQuantizeVertices = FileUtils::GetBoolFromConfig("Resource/ngine.ini", "Mesh", "Quantize");
+        mQuantizePositionError = positionError > 0.0f ? positionError : 0.0005f;
+        mQuantizeUvError = uvError > 0.0f ? uvError : 0.0005f;
     }
 
     GraphicsCore::~GraphicsCore()
     {
         vkDeviceWaitIdle(mDevice);
+        mWorkers.Destroy();
+
+        //Pipelines finished after the last frame still have to reach the cache to be destroyed
+        mCompiler.Destroy();
+        CollectPipelines();
+
+        LOG_F(INFO, "Frame uniform allocator peak usage: %llu KB", (unsigned long long)(mFrameUniforms.GetPeakUsage() >> 10));
+        mFrameUniforms.Destroy();
+        mCuller.Destroy();
+        mFrameInstances.Destroy();
+        mFrameIndirect.Destroy();
+        mBindlessObjects.Destroy();
+
+        RenderGraphStats graphStats = mRenderGraph.GetStats();
+        LOG_F(INFO, "Render graph (last frame): %u passes (%u culled), %u image and %u buffer barriers in %u batches, transients %llu KB (%llu KB without aliasing)",
+            graphStats.mPasses, graphStats.mCulledPasses, graphStats.mImageBarriers, graphStats.mBufferBarriers, graphStats.mBarrierBatches,
+            (unsigned long long)(graphStats.mTransientBytes >> 10), (unsigned long long)(graphStats.mTransientBytesUnaliased >> 10));
+        mRenderGraph.Destroy();
+        mGeometry.LogStats();
+        mGeometry.Destroy();
+        mUploader.Destroy();
+        mStagingRing.Destroy();
+        mAllocator.LogStats();
 
-        for (size_t i = 0; i < vecModels.size(); i++)
-        {
-            for (size_t j = 0; j < vecModels[i].vecMeshes.size(); j++)
-            {
-                vkFreeMemory(mDevice, vecModels[i].vecMeshes[j].mVertexMemory, nullptr);
-                vkDestroyBuffer(mDevice, vecModels[i].vecMeshes[j].mVertexBuffer, nullptr);
-                vkFreeMemory(mDevice, vecModels[i].vecMeshes[j].mIndexMemory, nullptr);
-                vkDestroyBuffer(mDevice, vecModels[i].vecMeshes[j].mIndexBuffer, nullptr);
-            }
+        for (auto& shader : vecShaders)
+            vkDestroyDescriptorPool(mDevice, shader.mDescPool, nullptr);
 
-            for (size_t j = 0; j < vecModels[i].vecUniformBuffers.size(); j++)
-            {
-                vkDestroyBuffer(mDevice, vecModels[i].vecUniformBuffers[j], nullptr);
-                vkFreeMemory(mDevice, vecModels[i].vecUniformMemory[j], nullptr);
+        //Shaders only borrow these, each one is destroyed once no matter how many shaders shared it
+        LOG_F(INFO, "Shader caches: %u shader hits, modules %u hits/%u misses, depth only pipelines %u hits/%u misses",
+            mShaderCacheStats.mShaderHits, mShaderCacheStats.mModuleHits, mShaderCacheStats.mModuleMisses,
+            mShaderCacheStats.mPipelineHits, mShaderCacheStats.mPipelineMisses);
 
-            }
-        }
+        for(auto& entry : mPipelineStates)
+            vkDestroyPipeline(mDevice, entry.second.mPipeline, nullptr);
 
-        for (auto& shader : vecShaders)
-        {
-            vkDestroyPipeline(mDevice, shader.mPipeline, nullptr);
-            vkDestroyPipelineLayout(mDevice, shader.mPipelineLayout, nullptr);
-            vkDestroyShaderModule(mDevice, shader.mVertex, nullptr);
-            vkDestroyShaderModule(mDevice, shader.mFragment, nullptr);
-            vkDestroyDescriptorSetLayout(mDevice, shader.mDescLayout, nullptr);
-            vkDestroyDescriptorPool(mDevice, shader.mDescPool, nullptr);
-        }
+        for(auto& entry : mShaderModules)
+            vkDestroyShaderModule(mDevice, entry.second.mModule, nullptr);
+
+        for(auto pipelineLayout : mPipelineLayouts)
+            vkDestroyPipelineLayout(mDevice, pipelineLayout, nullptr);
 
+        vkDestroyDescriptorSetLayout(mDevice, mObjectSetLayout, nullptr);
+        vkDestroyDescriptorPool(mDevice, mBindlessPool, nullptr);
+        vkDestroyPipelineLayout(mDevice, mBindlessPipelineLayout, nullptr);
+        vkDestroyDescriptorSetLayout(mDevice, mBindlessSetLayout, nullptr);
+
+        //Written back only when pipelines were added during this run
+        mPipelineCache.Destroy();
 
         for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
         {
@@ -112,13 +177,20 @@ namespace Ngine
             vkDestroyFence(mDevice, vecFlightFences[i], nullptr);
         }
 
+        for(auto& context : vecRecordContexts)
+            vkDestroyCommandPool(mDevice, context.mPool, nullptr);
+
         vkDestroyCommandPool(mDevice, mCmdPool, nullptr);
-        for (auto framebuffer : vecFrameBuffers)
-            vkDestroyFramebuffer(mDevice, framebuffer, nullptr);
+        if(mStatisticsPool != VK_NULL_HANDLE)
+            vkDestroyQueryPool(mDevice, mStatisticsPool, nullptr);
+        DestroyFrameBuffers();
 	    vkDestroyRenderPass(mDevice, mRenderPass, nullptr);
+        vkDestroyRenderPass(mDevice, mAfterPrepassRenderPass, nullptr);
+        vkDestroyRenderPass(mDevice, mPrepassRenderPass, nullptr);
         for (auto imageView : vecSwapImageViews)
 		    vkDestroyImageView(mDevice, imageView, nullptr);
         vkDestroySwapchainKHR(mDevice, mSwapchain, nullptr);
+        mAllocator.Destroy();
         vkDestroyDevice(mDevice, nullptr);
         vkDestroySurfaceKHR(mInstance, mSurface, nullptr);
         vkDestroyInstance(mInstance, nullptr);
@@ -204,6 +276,8 @@ namespace Ngine
         vkEnumeratePhysicalDevices(mInstance, &devCount, &vecDevices[0]);
 
         //Enumerate through all the devices and select the most suitable one
+        std::optional<VkPhysicalDevice> fallbackDevice;
+
         for(auto& device : vecDevices)
         {
             VkPhysicalDeviceProperties devProp;
@@ -213,16 +287,29 @@ namespace Ngine
             if(!(devProp.apiVersion & VK_API_VERSION_1_2))
                 continue;
 
-            //Ignore any device that is iGPU or CPU
+            //Remember first iGPU or CPU device in case there is no dedicated GPU
             if(devProp.deviceType == VK_PHYSICAL_DEVICE_TYPE_INTEGRATED_GPU || devProp.deviceType == VK_PHYSICAL_DEVICE_TYPE_CPU)
+            {
+                if(!fallbackDevice.has_value())
+                    fallbackDevice = device;
                 continue;
+            }
 
             LOG_F(INFO, "Device selected: %s", devProp.deviceName);
             mPhysDevice = device;
             return;
         }
 
-        
+        if(fallbackDevice.has_value())
+        {
+            VkPhysicalDeviceProperties devProp;
+            vkGetPhysicalDeviceProperties(fallbackDevice.value(), &devProp);
+
+            LOG_F(WARNING, "No dedicated GPU found, falling back to: %s", devProp.deviceName);
+            mPhysDevice = fallbackDevice.value();
+            return;
+        }
+
 
         LOG_F(ERROR, "No compatible device was found!");
         throw Exception();
@@ -380,6 +467,12 @@ namespace Ngine
             if(queueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT)
                 mQueueData.mGraphicsQueueIndex = i;
 
+            //Transfer family without graphics - one that can only copy is preferred so uploads don't share hardware
+            //with async compute, a compute family is the fallback when the device has no copy-only family
+            bool dedicatedTransfer = (queueFamily.queueFlags & VK_QUEUE_TRANSFER_BIT) && !(queueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT);
+            if(dedicatedTransfer && (!mQueueData.mTransferQueueIndex.has_value() || !(queueFamily.queueFlags & VK_QUEUE_COMPUTE_BIT)))
+                mQueueData.mTransferQueueIndex = i;
+
             vkGetPhysicalDeviceSurfaceSupportKHR(mPhysDevice, i, mSurface, &presentSupport);
 
             if(presentSupport)
@@ -387,6 +480,14 @@ namespace Ngine
 
             i++;
         }
+
+        if(FileUtils::GetBoolFromConfig("Resource/ngine.ini", "General", "DisableTransferQueue"))
+            mQueueData.mTransferQueueIndex.reset();
+
+        if(mQueueData.mTransferQueueIndex.has_value())
+            LOG_F(INFO, "Dedicated transfer queue family found (index = %u)", mQueueData.mTransferQueueIndex.value());
+        else
+            LOG_F(INFO, "No dedicated transfer queue family, uploads will use graphics queue");
     }
 
     void GraphicsCore::CreateLogicDevice()
@@ -399,28 +500,90 @@ namespace Ngine
             throw Exception();
         }
 
+        //Every family can be requested only once, graphics and presentation are often the same one
+        std::set<uint32_t> uniqueFamilies = { mQueueData.mGraphicsQueueIndex.value(), mQueueData.mPresentationQueueIndex.value() };
+        if(mQueueData.mTransferQueueIndex.has_value())
+            uniqueFamilies.insert(mQueueData.mTransferQueueIndex.value());
+
         float priority = 1.0f;
-        VkDeviceQueueCreateInfo graphicsQueueInfo = {};
-        graphicsQueueInfo.sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
-        graphicsQueueInfo.pQueuePriorities = &priority;
-        graphicsQueueInfo.queueCount = 1;
-        graphicsQueueInfo.queueFamilyIndex = mQueueData.mGraphicsQueueIndex.value();
+        std::vector<VkDeviceQueueCreateInfo> vecQueueInfos;
+
+        for(uint32_t family : uniqueFamilies)
+        {
+            VkDeviceQueueCreateInfo queueInfo = {};
+            queueInfo.sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
+            queueInfo.pQueuePriorities = &priority;
+            queueInfo.queueCount = 1;
+            queueInfo.queueFamilyIndex = family;
+            vecQueueInfos.push_back(queueInfo);
+        }
+
+        VkPhysicalDeviceVulkan12Features supported12 = {};
+        supported12.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+
+        VkPhysicalDeviceFeatures2 supported = {};
+        supported.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+        supported.pNext = &supported12;
+        vkGetPhysicalDeviceFeatures2(mPhysDevice, &supported);
+
+        //Indirect draw needs multi draw to submit whole bucket with single call and first instance to address
+        //instance groups, count buffer is optional
+        VkPhysicalDeviceVulkan12Features features12 = {};
+        features12.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+        features12.drawIndirectCount = supported12.drawIndirectCount;
+
+        VkPhysicalDeviceFeatures2 devFeatures = {};
+        devFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+        devFeatures.pNext = &features12;
+        devFeatures.features.multiDrawIndirect = supported.features.multiDrawIndirect;
+        devFeatures.features.drawIndirectFirstInstance = supported.features.drawIndirectFirstInstance;
+
+        bool indirectRequested = FileUtils::GetBoolFromConfig("Resource/ngine.ini", "General", "IndirectDraw");
+        mIndirectDraw = indirectRequested && supported.features.multiDrawIndirect && supported.features.drawIndirectFirstInstance;
+        mDrawIndirectCount = mIndirectDraw && supported12.drawIndirectCount;
+        LOG_IF_F(WARNING, indirectRequested && !mIndirectDraw, "Indirect draw requested but device does not support multiDrawIndirect/drawIndirectFirstInstance, using direct draws");
+        LOG_IF_F(INFO, mIndirectDraw, "Indirect draw enabled%s", mDrawIndirectCount ? " with draw count buffer" : "");
+
+        //Culling pass writes instance counts into indirect commands, without them there is nothing to write into
+        bool cullingRequested = FileUtils::GetBoolFromConfig("Resource/ngine.ini", "General", "GpuCulling");
+        mGpuCulling = cullingRequested && mIndirectDraw;
+        LOG_IF_F(WARNING, cullingRequested && !mIndirectDraw, "GPU culling requires indirect draw, it is disabled");
+
+        //Bindless set indexes per frame buffers with push constant and holds partially bound texture array that grows while frames are in flight
+        bool bindlessRequested = FileUtils::GetBoolFromConfig("Resource/ngine.ini", "General", "Bindless");
+        mBindless = bindlessRequested && supported12.runtimeDescriptorArray && supported12.descriptorBindingPartiallyBound &&
+            supported12.descriptorBindingSampledImageUpdateAfterBind && supported12.shaderSampledImageArrayNonUniformIndexing &&
+            supported.features.shaderStorageBufferArrayDynamicIndexing;
+
+        if(mBindless)
+        {
+            features12.descriptorIndexing = supported12.descriptorIndexing;
+            features12.runtimeDescriptorArray = VK_TRUE;
+            features12.descriptorBindingPartiallyBound = VK_TRUE;
+            features12.descriptorBindingSampledImageUpdateAfterBind = VK_TRUE;
+            features12.shaderSampledImageArrayNonUniformIndexing = VK_TRUE;
+            devFeatures.features.shaderStorageBufferArrayDynamicIndexing = VK_TRUE;
+        }
 
-        VkDeviceQueueCreateInfo presentationQueueInfo = {};
-        presentationQueueInfo.sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
-        presentationQueueInfo.pQueuePriorities = &priority;
-        presentationQueueInfo.queueCount = 1;
-        presentationQueueInfo.queueFamilyIndex = mQueueData.mPresentationQueueIndex.value();
+        LOG_IF_F(WARNING, bindlessRequested && !mBindless, "Bindless descriptors requested but device lacks required descriptor indexing features, they are disabled");
+        LOG_IF_F(INFO, mBindless, "Bindless descriptors enabled");
 
-        VkDeviceQueueCreateInfo queueArray[] = { graphicsQueueInfo, presentationQueueInfo };
+        //Fragment invocations are counted around shading pass, secondary buffers recorded inside it have to inherit the query
+        bool statisticsRequested = FileUtils::GetBoolFromConfig("Resource/ngine.ini", "General", "PipelineStatistics");
+        mPipelineStatistics = statisticsRequested && supported.features.pipelineStatisticsQuery && supported.features.inheritedQueries;
+        devFeatures.features.pipelineStatisticsQuery = mPipelineStatistics;
+        devFeatures.features.inheritedQueries = mPipelineStatistics;
+        LOG_IF_F(WARNING, statisticsRequested && !mPipelineStatistics, "Pipeline statistics requested but device lacks pipelineStatisticsQuery/inheritedQueries, fragment counts are not available");
 
-        VkPhysicalDeviceFeatures devFeatures = {};
+        mCpuCulling = !FileUtils::GetBoolFromConfig("Resource/ngine.ini", "General", "DisableCpuCulling");
+        mSpatialCulling = FileUtils::GetBoolFromConfig("Resource/ngine.ini", "General", "SpatialTreeCulling");
 
         VkDeviceCreateInfo devInfo = {};
         devInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
-        devInfo.pQueueCreateInfos = queueArray;
-        devInfo.queueCreateInfoCount = sizeof(queueArray) / sizeof(VkDeviceQueueCreateInfo);
-        devInfo.pEnabledFeatures = &devFeatures;
+        devInfo.pNext = &devFeatures;
+        devInfo.pQueueCreateInfos = vecQueueInfos.data();
+        devInfo.queueCreateInfoCount = vecQueueInfos.size();
+        devInfo.pEnabledFeatures = nullptr;
         devInfo.enabledExtensionCount = deviceExtensions.size();
         devInfo.ppEnabledExtensionNames = deviceExtensions.data();
         
@@ -435,6 +598,12 @@ namespace Ngine
         
         vkGetDeviceQueue(mDevice, mQueueData.mGraphicsQueueIndex.value(), 0, &mGraphicsQueue);
         vkGetDeviceQueue(mDevice, mQueueData.mPresentationQueueIndex.value(), 0, &mPresentationQueue);
+
+        //Single family devices upload through graphics queue
+        if(mQueueData.mTransferQueueIndex.has_value())
+            vkGetDeviceQueue(mDevice, mQueueData.mTransferQueueIndex.value(), 0, &mTransferQueue);
+        else
+            mTransferQueue = mGraphicsQueue;
     }
 
     void GraphicsCore::CreateSwapchain(NgineWindow* pWindow)
@@ -595,8 +764,155 @@ namespace Ngine
         }
     }
 
-    void GraphicsCore::CreatePipeline(Shader& shader)
+    PipelineState GraphicsCore::GetPipelineState(const Shader& shader, VertexLayout layout, ShaderPass pass) const
+    {
+        //Whole fixed function state is filled here, anything that changes the pipeline has to be part of the key
+        PipelineState state;
+        memset(&state, 0, sizeof(state));
+        state.mVertex = shader.mVertex;
+        state.mFragment = shader.mFragment;
+        state.mLayout = shader.mPipelineLayout;
+        state.mRenderPass = pass == ShaderPass::DepthPrepass ? mPrepassRenderPass : mRenderPass;
+        state.mSubpass = 0;
+        state.mVertexLayout = layout;
+        state.mInstanced = shader.mUsesInstancing ? 1 : 0;
+        state.mTopology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+        state.mPolygonMode = VK_POLYGON_MODE_FILL;
+        state.mCullMode = VK_CULL_MODE_NONE;
+        state.mFrontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE;
+        state.mSamples = VK_SAMPLE_COUNT_1_BIT;
+        state.mBlendEnable = VK_TRUE;
+        state.mSrcColorBlend = VK_BLEND_FACTOR_SRC_ALPHA;
+        state.mDstColorBlend = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
+        state.mColorBlendOp = VK_BLEND_OP_ADD;
+        state.mSrcAlphaBlend = VK_BLEND_FACTOR_ONE;
+        state.mDstAlphaBlend = VK_BLEND_FACTOR_ZERO;
+        state.mAlphaBlendOp = VK_BLEND_OP_ADD;
+        state.mColorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
+
+        //After pre-pass depth is final, only the fragment that wrote it passes and fragment shader runs once per pixel
+        state.mDepthTest = VK_TRUE;
+        state.mDepthWrite = pass == ShaderPass::AfterPrepass ? VK_FALSE : VK_TRUE;
+        state.mDepthCompare = pass == ShaderPass::AfterPrepass ? VK_COMPARE_OP_EQUAL : VK_COMPARE_OP_LESS;
+
+        //Pre-pass runs the shader's own vertex module, its position is declared invariant so both passes get the same depth
+        if(pass == ShaderPass::DepthPrepass)
+        {
+            state.mFragment = VK_NULL_HANDLE;
+            state.mBlendEnable = VK_FALSE;
+            state.mSrcColorBlend = VK_BLEND_FACTOR_ZERO;
+            state.mDstColorBlend = VK_BLEND_FACTOR_ZERO;
+            state.mSrcAlphaBlend = VK_BLEND_FACTOR_ZERO;
+            state.mDstAlphaBlend = VK_BLEND_FACTOR_ZERO;
+            state.mColorWriteMask = 0;
+        }
+
+        return state;
+    }
+
+    VkPipeline GraphicsCore::RequestPipeline(Shader& shader, VertexLayout layout, ShaderPass pass)
+    {
+        PipelineState state = GetPipelineState(shader, layout, pass);
+        uint64_t key = PipelineCache::Hash(&state, sizeof(state));
+
+        //States with a fragment module belong to one module pair, which LoadShader never loads twice.
+        //Depth only states leave it out, so shaders with the same vertex module share their pre-pass pipelines
+        if(state.mFragment == VK_NULL_HANDLE)
+        {
+            auto range = mPipelineStates.equal_range(key);
+            for(auto it = range.first; it != range.second; it++)
+            {
+                if(memcmp(&it->second.mState, &state, sizeof(state)) == 0)
+                {
+                    mShaderCacheStats.mPipelineHits++;
+
+                    //Still compiling for another shader, this one waits for the same result
+                    if(it->second.mPending)
+                        shader.mPendingPipelines++;
+
+                    return it->second.mPipeline;
+                }
+            }
+
+            mShaderCacheStats.mPipelineMisses++;
+        }
+
+        auto inserted = mPipelineStates.insert({ key, PipelineStateEntry() });
+        PipelineStateEntry& entry = inserted->second;
+        entry.mState = state;
+
+        if(mAsyncPipelines)
+        {
+            //State is copied into the job, entry stays in place until CollectPipelines fills it
+            entry.mPending = true;
+            shader.mPendingPipelines++;
+
+            uint64_t ticket = mCompiler.Submit([this, state](VkPipeline& outPipeline) { return CompilePipeline(state, outPipeline); });
+            mPendingPipelines[ticket] = &entry;
+            return VK_NULL_HANDLE;
+        }
+
+        auto start = std::chrono::high_resolution_clock::now();
+        VkResult res = CompilePipeline(state, entry.mPipeline);
+        if(res != VK_SUCCESS)
+            mPipelineStates.erase(inserted);
+        VK_THROW_IF_FAILED(res);
+
+        double compileMs = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+        double savedMs = mPipelineCache.RecordCreation(compileMs, 1);
+        shader.mCompileMs += compileMs;
+
+        LOG_F(INFO, "Pipeline of shader %u for vertex layout %u and pass %u compiled in %.2f ms", shader.mId, (uint32_t)layout, (uint32_t)pass, compileMs);
+        LOG_IF_F(INFO, savedMs > 0.0, "Pipeline cache saved about %.2f ms compared to compiling from scratch", savedMs);
+
+        return entry.mPipeline;
+    }
+
+    void GraphicsCore::RequestShaderPipelines(Shader& shader)
+    {
+        //Pre-pass variants are built up front so the pre-pass can be switched on and off at runtime.
+        //Packed meshes exist only with [Mesh] Quantize, without it their pipelines would never be bound
+        uint32_t passCount = shader.mPrepassVariants ? (uint32_t)ShaderPass::Count : 1;
+        uint32_t layoutCount = mQuantizeVertices ? (uint32_t)VertexLayout::Count : (uint32_t)VertexLayout::Full + 1;
+        for(uint32_t pass = 0; pass < passCount; pass++)
+        {
+            for(uint32_t layout = 0; layout < layoutCount; layout++)
+            {
+                if(shader.mPipelines[pass][layout] == VK_NULL_HANDLE)
+                    shader.mPipelines[pass][layout] = RequestPipeline(shader, (VertexLayout)layout, (ShaderPass)pass);
+            }
+        }
+    }
+
+    VkPipeline GraphicsCore::GetPipeline(const Shader& shader, VertexLayout layout, ShaderPass pass) const
     {
+        //Without invariant position depth could differ between passes, such shader is left out of pre-pass and tests against its depth normally
+        if(pass != ShaderPass::Main && !shader.mPrepassVariants)
+            return pass == ShaderPass::DepthPrepass ? VK_NULL_HANDLE : shader.mPipelines[(uint32_t)ShaderPass::Main][(uint32_t)layout];
+
+        //Pre-pass and shading after it have to draw the same objects, otherwise EQUAL test hides whatever is behind
+        if(pass != ShaderPass::Main && (shader.mPipelines[(uint32_t)ShaderPass::DepthPrepass][(uint32_t)layout] == VK_NULL_HANDLE ||
+                                        shader.mPipelines[(uint32_t)ShaderPass::AfterPrepass][(uint32_t)layout] == VK_NULL_HANDLE))
+            return VK_NULL_HANDLE;
+
+        return shader.mPipelines[(uint32_t)pass][(uint32_t)layout];
+    }
+
+    VkResult GraphicsCore::CompilePipeline(const PipelineState& state, VkPipeline& outPipeline) const
+    {
+        //Runs on compiler threads as well, so it may only read the state and objects that never change after startup
+        VkPipelineShaderStageCreateInfo shaderStages[2] = {};
+        shaderStages[0].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+        shaderStages[0].stage = VK_SHADER_STAGE_VERTEX_BIT;
+        shaderStages[0].module = state.mVertex;
+        shaderStages[0].pName = "main";
+        shaderStages[1].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+        shaderStages[1].stage = VK_SHADER_STAGE_FRAGMENT_BIT;
+        shaderStages[1].module = state.mFragment;
+        shaderStages[1].pName = "main";
+
+        //Depth only pipelines have no fragment stage and render into pass without color attachments
+        bool depthOnly = state.mFragment == VK_NULL_HANDLE;
 
         std::vector<VkDynamicState> dynamicStates = {
         VK_DYNAMIC_STATE_VIEWPORT,
@@ -608,48 +924,48 @@ namespace Ngine
         dynamicState.dynamicStateCount = static_cast<uint32_t>(dynamicStates.size());
         dynamicState.pDynamicStates = dynamicStates.data();
 
-        auto bindingDesc = Vertex::GetBindingDescription();
-        auto attrDesc = Vertex::GetAttributeDescriptions();
+        std::vector<VkVertexInputBindingDescription> bindingDesc = { Vertex::GetBindingDescription(state.mVertexLayout) };
+        std::vector<VkVertexInputAttributeDescription> attrDesc;
+
+        auto vertexAttrDesc = Vertex::GetAttributeDescriptions(state.mVertexLayout);
+        attrDesc.insert(attrDesc.end(), vertexAttrDesc.begin(), vertexAttrDesc.end());
+
+        //Instanced shaders get world matrix from second, per instance binding
+        if(state.mInstanced)
+        {
+            auto instanceAttrDesc = Vertex::GetInstanceAttributeDescriptions();
+            bindingDesc.push_back(Vertex::GetInstanceBindingDescription());
+            attrDesc.insert(attrDesc.end(), instanceAttrDesc.begin(), instanceAttrDesc.end());
+        }
 
         VkPipelineVertexInputStateCreateInfo vertexInputInfo{};
         vertexInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
-        vertexInputInfo.vertexBindingDescriptionCount = 1;
-        vertexInputInfo.pVertexBindingDescriptions = &bindingDesc;
+        vertexInputInfo.vertexBindingDescriptionCount = bindingDesc.size();
+        vertexInputInfo.pVertexBindingDescriptions = bindingDesc.data();
         vertexInputInfo.vertexAttributeDescriptionCount = attrDesc.size();
         vertexInputInfo.pVertexAttributeDescriptions = attrDesc.data();
 
         VkPipelineInputAssemblyStateCreateInfo inputAssembly{};
         inputAssembly.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
-        inputAssembly.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+        inputAssembly.topology = state.mTopology;
         inputAssembly.primitiveRestartEnable = VK_FALSE;
 
-        VkViewport viewport{};
-        viewport.x = 0.0f;
-        viewport.y = 0.0f;
-        viewport.width = (float)mSwapExtent.width;
-        viewport.height = (float)mSwapExtent.height;
-        viewport.minDepth = 0.0f;
-        viewport.maxDepth = 1.0f;
-
-        VkRect2D scissor{};
-        scissor.offset = { 0, 0 };
-        scissor.extent = mSwapExtent;
-
+        //Viewport and scissor are dynamic, swapchain extent is not read here since it changes on resize
         VkPipelineViewportStateCreateInfo viewportState{};
         viewportState.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
         viewportState.viewportCount = 1;
-        viewportState.pViewports = &viewport;
+        viewportState.pViewports = nullptr;
         viewportState.scissorCount = 1;
-        viewportState.pScissors = &scissor;
+        viewportState.pScissors = nullptr;
 
         VkPipelineRasterizationStateCreateInfo rasterizer{};
         rasterizer.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
         rasterizer.depthClampEnable = VK_FALSE;
         rasterizer.rasterizerDiscardEnable = VK_FALSE;
-        rasterizer.polygonMode = VK_POLYGON_MODE_FILL;
+        rasterizer.polygonMode = state.mPolygonMode;
         rasterizer.lineWidth = 1.0f;
-        rasterizer.cullMode = VK_CULL_MODE_NONE;
-        rasterizer.frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE;
+        rasterizer.cullMode = state.mCullMode;
+        rasterizer.frontFace = state.mFrontFace;
         rasterizer.depthBiasEnable = VK_FALSE;
         rasterizer.depthBiasConstantFactor = 0.0f;
         rasterizer.depthBiasClamp = 0.0f;
@@ -658,118 +974,274 @@ namespace Ngine
         VkPipelineMultisampleStateCreateInfo multisampling{};
         multisampling.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
         multisampling.sampleShadingEnable = VK_FALSE;
-        multisampling.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
+        multisampling.rasterizationSamples = state.mSamples;
         multisampling.minSampleShading = 1.0f;
         multisampling.pSampleMask = nullptr;
         multisampling.alphaToCoverageEnable = VK_FALSE;
         multisampling.alphaToOneEnable = VK_FALSE;
 
         VkPipelineColorBlendAttachmentState colorBlendAttachment{};
-        colorBlendAttachment.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
-        colorBlendAttachment.blendEnable = VK_TRUE;
-        colorBlendAttachment.srcColorBlendFactor = VK_BLEND_FACTOR_SRC_ALPHA;
-        colorBlendAttachment.dstColorBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
-        colorBlendAttachment.colorBlendOp = VK_BLEND_OP_ADD;
-        colorBlendAttachment.srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
-        colorBlendAttachment.dstAlphaBlendFactor = VK_BLEND_FACTOR_ZERO;
-        colorBlendAttachment.alphaBlendOp = VK_BLEND_OP_ADD;
+        colorBlendAttachment.colorWriteMask = state.mColorWriteMask;
+        colorBlendAttachment.blendEnable = state.mBlendEnable;
+        colorBlendAttachment.srcColorBlendFactor = state.mSrcColorBlend;
+        colorBlendAttachment.dstColorBlendFactor = state.mDstColorBlend;
+        colorBlendAttachment.colorBlendOp = state.mColorBlendOp;
+        colorBlendAttachment.srcAlphaBlendFactor = state.mSrcAlphaBlend;
+        colorBlendAttachment.dstAlphaBlendFactor = state.mDstAlphaBlend;
+        colorBlendAttachment.alphaBlendOp = state.mAlphaBlendOp;
 
         VkPipelineColorBlendStateCreateInfo colorBlending{};
         colorBlending.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
         colorBlending.logicOpEnable = VK_FALSE;
         colorBlending.logicOp = VK_LOGIC_OP_COPY;
-        colorBlending.attachmentCount = 1;
+        colorBlending.attachmentCount = depthOnly ? 0 : 1;
         colorBlending.pAttachments = &colorBlendAttachment;
         colorBlending.blendConstants[0] = 0.0f;
         colorBlending.blendConstants[1] = 0.0f;
         colorBlending.blendConstants[2] = 0.0f;
         colorBlending.blendConstants[3] = 0.0f;
 
-        VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
-        pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
-        pipelineLayoutInfo.setLayoutCount = 1;
-        pipelineLayoutInfo.pSetLayouts = &shader.mDescLayout; 
-        pipelineLayoutInfo.pushConstantRangeCount = 0;
-        pipelineLayoutInfo.pPushConstantRanges = nullptr;
-
-        VkResult res = vkCreatePipelineLayout(mDevice, &pipelineLayoutInfo, nullptr, &shader.mPipelineLayout);
-        VK_THROW_IF_FAILED(res);
+        VkPipelineDepthStencilStateCreateInfo depthStencil{};
+        depthStencil.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
+        depthStencil.depthTestEnable = state.mDepthTest;
+        depthStencil.depthWriteEnable = state.mDepthWrite;
+        depthStencil.depthCompareOp = state.mDepthCompare;
+        depthStencil.depthBoundsTestEnable = VK_FALSE;
+        depthStencil.stencilTestEnable = VK_FALSE;
+        depthStencil.minDepthBounds = 0.0f;
+        depthStencil.maxDepthBounds = 1.0f;
 
         VkGraphicsPipelineCreateInfo pipelineInfo{};
         pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
-        pipelineInfo.stageCount = 2;
-        pipelineInfo.pStages = shader.mShaderStages;
+        pipelineInfo.stageCount = depthOnly ? 1 : 2;
+        pipelineInfo.pStages = shaderStages;
         pipelineInfo.pVertexInputState = &vertexInputInfo;
         pipelineInfo.pInputAssemblyState = &inputAssembly;
         pipelineInfo.pViewportState = &viewportState;
         pipelineInfo.pRasterizationState = &rasterizer;
         pipelineInfo.pMultisampleState = &multisampling;
-        pipelineInfo.pDepthStencilState = nullptr; // Optional
+        pipelineInfo.pDepthStencilState = &depthStencil;
         pipelineInfo.pColorBlendState = &colorBlending;
         pipelineInfo.pDynamicState = &dynamicState;
-        pipelineInfo.layout = shader.mPipelineLayout;
-        pipelineInfo.renderPass = mRenderPass;
-        pipelineInfo.subpass = 0;
+        pipelineInfo.layout = state.mLayout;
+        pipelineInfo.renderPass = state.mRenderPass;
+        pipelineInfo.subpass = state.mSubpass;
         pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
         pipelineInfo.basePipelineIndex = -1;
 
-        res = vkCreateGraphicsPipelines(mDevice, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &shader.mPipeline);
-        VK_THROW_IF_FAILED(res);
+        //Pipeline cache is internally synchronized, compiler threads can share it
+        return vkCreateGraphicsPipelines(mDevice, mPipelineCache.GetHandle(), 1, &pipelineInfo, nullptr, &outPipeline);
+    }
+
+    void GraphicsCore::CollectPipelines()
+    {
+        if(mPendingPipelines.empty())
+            return;
+
+        std::vector<PipelineCompileResult> vecResults;
+        mCompiler.Collect(vecResults);
+
+        for(auto& result : vecResults)
+        {
+            auto pending = mPendingPipelines.find(result.mTicket);
+            if(pending == mPendingPipelines.end())
+                continue;
+
+            PipelineStateEntry* pEntry = pending->second;
+            mPendingPipelines.erase(pending);
+
+            bool succeeded = result.mResult == VK_SUCCESS;
+            LOG_IF_F(ERROR, !succeeded, "Background pipeline compilation failed! EC = %d", result.mResult);
+
+            pEntry->mPending = false;
+            pEntry->mPipeline = succeeded ? result.mPipeline : VK_NULL_HANDLE;
+            mPipelineCache.RecordCreation(result.mCompileMs, 1);
+
+            //Usually exactly one shader waits for a state, it is found again by comparing states
+            for(auto& shader : vecShaders)
+            {
+                for(uint32_t pass = 0; pass < (uint32_t)ShaderPass::Count && shader.mPendingPipelines > 0; pass++)
+                {
+                    for(uint32_t layout = 0; layout < (uint32_t)VertexLayout::Count && shader.mPendingPipelines > 0; layout++)
+                    {
+                        if(shader.mPipelines[pass][layout] != VK_NULL_HANDLE || (pass != (uint32_t)ShaderPass::Main && !shader.mPrepassVariants))
+                            continue;
+
+                        PipelineState state = GetPipelineState(shader, (VertexLayout)layout, (ShaderPass)pass);
+                        if(memcmp(&state, &pEntry->mState, sizeof(state)) != 0)
+                            continue;
+
+                        shader.mPipelines[pass][layout] = pEntry->mPipeline;
+                        shader.mCompileMs += result.mCompileMs;
+                        shader.mCompileFailed |= !succeeded;
+                        shader.mPendingPipelines--;
+
+                        LOG_F(INFO, "Pipeline of shader %u for vertex layout %u and pass %u compiled in %.2f ms on background thread", shader.mId, layout, pass, result.mCompileMs);
+
+                        if(shader.mPendingPipelines == 0)
+                            PublishShaderReady(shader);
+                    }
+                }
+            }
+
+            //Failed state is forgotten, so loading the shader again compiles it again instead of drawing nothing
+            if(!succeeded)
+            {
+                auto range = mPipelineStates.equal_range(PipelineCache::Hash(&pEntry->mState, sizeof(pEntry->mState)));
+                for(auto it = range.first; it != range.second; it++)
+                {
+                    if(&it->second == pEntry)
+                    {
+                        mPipelineStates.erase(it);
+                        break;
+                    }
+                }
+            }
+        }
+    }
+
+    void GraphicsCore::PublishShaderReady(const Shader& shader)
+    {
+        EventShaderReady* pEvent = new EventShaderReady();
+        pEvent->mShaderId = shader.mId;
+        pEvent->mCompileMs = shader.mCompileMs;
+        pEvent->mSucceeded = !shader.mCompileFailed;
+
+        EventHandler::AddEventToBuffer(pEvent, EventType::EventType_ShaderReady);
+    }
+
+    bool GraphicsCore::IsShaderReady(uint32_t shaderId) const
+    {
+        for(auto& shader : vecShaders)
+        {
+            if(shader.mId == shaderId)
+                return shader.mPendingPipelines == 0 && !shader.mCompileFailed;
+        }
+
+        return false;
+    }
+
+    void GraphicsCore::ChooseDepthFormat()
+    {
+        //Format is picked once, render passes and pipelines are built for it
+        const VkFormat candidates[] = { VK_FORMAT_D32_SFLOAT, VK_FORMAT_D32_SFLOAT_S8_UINT, VK_FORMAT_D24_UNORM_S8_UINT };
+        for(VkFormat format : candidates)
+        {
+            VkFormatProperties props;
+            vkGetPhysicalDeviceFormatProperties(mPhysDevice, format, &props);
+            if(props.optimalTilingFeatures & VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT)
+            {
+                mDepthFormat = format;
+                break;
+            }
+        }
+
+        if(mDepthFormat == VK_FORMAT_UNDEFINED)
+        {
+            LOG_F(ERROR, "Device supports none of depth attachment formats");
+            throw Exception();
+        }
+
+        //Layout transitions of combined formats have to name both aspects
+        mDepthAspect = VK_IMAGE_ASPECT_DEPTH_BIT | (mDepthFormat != VK_FORMAT_D32_SFLOAT ? VK_IMAGE_ASPECT_STENCIL_BIT : 0);
     }
 
     void GraphicsCore::CreateRenderPass()
     {
-        VkAttachmentDescription colorAttachment = {};
+        VkAttachmentDescription attachments[2] = {};
+
+        //Render graph transitions the images before and after the pass and waits for acquire
+        VkAttachmentDescription& colorAttachment = attachments[0];
         colorAttachment.format = mSwapFormat;
         colorAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
         colorAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
         colorAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
         colorAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
         colorAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
-        colorAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-        colorAttachment.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+        colorAttachment.initialLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+        colorAttachment.finalLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+
+        //Depth is not needed once the frame is shaded
+        VkAttachmentDescription& depthAttachment = attachments[1];
+        depthAttachment.format = mDepthFormat;
+        depthAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
+        depthAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+        depthAttachment.storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+        depthAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+        depthAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+        depthAttachment.initialLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+        depthAttachment.finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
 
         VkAttachmentReference colorAttachmentRef = {};
         colorAttachmentRef.attachment = 0;
         colorAttachmentRef.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
 
+        VkAttachmentReference depthAttachmentRef = {};
+        depthAttachmentRef.attachment = 1;
+        depthAttachmentRef.layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+
         VkSubpassDescription subpass = {};
         subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
         subpass.colorAttachmentCount = 1;
         subpass.pColorAttachments = &colorAttachmentRef;
-
-        VkSubpassDependency dependency = {};
-        dependency.srcSubpass = VK_SUBPASS_EXTERNAL;
-        dependency.dstSubpass = 0;
-        dependency.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-        dependency.srcAccessMask = 0;
-        dependency.dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-        dependency.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+        subpass.pDepthStencilAttachment = &depthAttachmentRef;
 
         VkRenderPassCreateInfo renderPassInfo{};
         renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
-        renderPassInfo.attachmentCount = 1;
-        renderPassInfo.pAttachments = &colorAttachment;
+        renderPassInfo.attachmentCount = 2;
+        renderPassInfo.pAttachments = attachments;
         renderPassInfo.subpassCount = 1;
         renderPassInfo.pSubpasses = &subpass;
-        renderPassInfo.dependencyCount = 1;
-        renderPassInfo.pDependencies = &dependency;
 
         VkResult res = vkCreateRenderPass(mDevice, &renderPassInfo, nullptr, &mRenderPass);
         VK_THROW_IF_FAILED(res);
+
+        //Shading after pre-pass differs only in load op, so pipelines and framebuffers of mRenderPass work with it.
+        //Depth stays writable for shaders that were left out of pre-pass
+        depthAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_LOAD;
+
+        res = vkCreateRenderPass(mDevice, &renderPassInfo, nullptr, &mAfterPrepassRenderPass);
+        VK_THROW_IF_FAILED(res);
+
+        //Pre-pass has depth alone and keeps it for shading pass
+        depthAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+        depthAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+        depthAttachment.initialLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+        depthAttachment.finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+        depthAttachmentRef.attachment = 0;
+        depthAttachmentRef.layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+
+        subpass.colorAttachmentCount = 0;
+        subpass.pColorAttachments = nullptr;
+        renderPassInfo.attachmentCount = 1;
+        renderPassInfo.pAttachments = &depthAttachment;
+
+        res = vkCreateRenderPass(mDevice, &renderPassInfo, nullptr, &mPrepassRenderPass);
+        VK_THROW_IF_FAILED(res);
     }
 
-    void GraphicsCore::CreateFrameBuffers()
+    void GraphicsCore::UpdateFrameBuffers(VkImageView depthView)
     {
+        //Render graph creates a new depth image whenever it packs its transients again
+        if(depthView == mFrameBufferDepthView && !vecFrameBuffers.empty())
+            return;
+
+        //Frames in flight may still render into the old ones, they go once this frame in flight comes around again
+        for(auto framebuffer : vecFrameBuffers)
+            vecRetiredFrameBuffers.push_back({ mCurrentFrame, framebuffer });
+        if(mPrepassFrameBuffer != VK_NULL_HANDLE)
+            vecRetiredFrameBuffers.push_back({ mCurrentFrame, mPrepassFrameBuffer });
+
         vecFrameBuffers.resize(vecSwapImageViews.size());
 
+        //Every swapchain image shares the single depth image, frames in flight are ordered by render graph barriers
         for (size_t i = 0; i < vecSwapImageViews.size(); i++)
         {
-            VkImageView attachments[] = {vecSwapImageViews.at(i)};
+            VkImageView attachments[] = {vecSwapImageViews.at(i), depthView};
             VkFramebufferCreateInfo fbInfo = {};
             fbInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
             fbInfo.renderPass = mRenderPass;
-            fbInfo.attachmentCount = 1;
+            fbInfo.attachmentCount = 2;
             fbInfo.pAttachments = attachments;
             fbInfo.width = mSwapExtent.width;
             fbInfo.height = mSwapExtent.height;
@@ -778,6 +1250,36 @@ namespace Ngine
             VkResult res = vkCreateFramebuffer(mDevice, &fbInfo, nullptr, &vecFrameBuffers[i]);
             VK_THROW_IF_FAILED(res);
         }
+
+        VkFramebufferCreateInfo fbInfo = {};
+        fbInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+        fbInfo.renderPass = mPrepassRenderPass;
+        fbInfo.attachmentCount = 1;
+        fbInfo.pAttachments = &depthView;
+        fbInfo.width = mSwapExtent.width;
+        fbInfo.height = mSwapExtent.height;
+        fbInfo.layers = 1;
+
+        VkResult res = vkCreateFramebuffer(mDevice, &fbInfo, nullptr, &mPrepassFrameBuffer);
+        VK_THROW_IF_FAILED(res);
+
+        mFrameBufferDepthView = depthView;
+    }
+
+    void GraphicsCore::DestroyFrameBuffers()
+    {
+        //Only called with idle device, retired ones included
+        for (auto framebuffer : vecFrameBuffers)
+            vkDestroyFramebuffer(mDevice, framebuffer, nullptr);
+        for (auto& retired : vecRetiredFrameBuffers)
+            vkDestroyFramebuffer(mDevice, retired.second, nullptr);
+        if(mPrepassFrameBuffer != VK_NULL_HANDLE)
+            vkDestroyFramebuffer(mDevice, mPrepassFrameBuffer, nullptr);
+
+        vecFrameBuffers.clear();
+        vecRetiredFrameBuffers.clear();
+        mPrepassFrameBuffer = VK_NULL_HANDLE;
+        mFrameBufferDepthView = VK_NULL_HANDLE;
     }
 
     void GraphicsCore::CreateCommandPool()
@@ -842,16 +1344,27 @@ namespace Ngine
         }
     }
 
+    void GraphicsCore::CreateUploadManager()
+    {
+        int ringSizeMB = FileUtils::GetIntegerFromConfig("Resource/ngine.ini", "Memory", "StagingRingSizeMB");
+        int batchCount = FileUtils::GetIntegerFromConfig("Resource/ngine.ini", "Memory", "UploadBatchCount");
+        VkDeviceSize ringSize = (VkDeviceSize)(ringSizeMB > 0 ? ringSizeMB : 32) * 1024 * 1024;
+
+        mStagingRing.Initialize(mDevice, &mAllocator, ringSize);
+        uint32_t graphicsFamily = mQueueData.mGraphicsQueueIndex.value();
+        uint32_t transferFamily = mQueueData.mTransferQueueIndex.value_or(graphicsFamily);
+
+        mUploader.Initialize(mDevice, mTransferQueue, transferFamily, graphicsFamily, &mStagingRing, batchCount > 0 ? batchCount : 4);
+    }
+
     void GraphicsCore::RecreateSwapChain(NgineWindow* p)
     {
         int width = p->GetWidth(); int height = p->GetHeight();
         
         vkDeviceWaitIdle(mDevice);
 
-        for (size_t i = 0; i < vecFrameBuffers.size(); i++)
-        {
-            vkDestroyFramebuffer(mDevice, vecFrameBuffers[i], nullptr);
-        }
+        //Next frame creates them again for the new swapchain images and depth extent
+        DestroyFrameBuffers();
 
         for (size_t i = 0; i < vecSwapImageViews.size(); i++)
         {
@@ -862,290 +1375,1502 @@ namespace Ngine
 
         CreateSwapchain(p);
         CreateImageViews();
-        CreateFrameBuffers();
     }
 
-    void GraphicsCore::CreateVertexBuffer(Mesh& m, std::vector<Vertex> verts)
+    void GraphicsCore::CreateGeometryArena()
     {
-        VkBuffer stagingBuffer;
-        VkDeviceMemory stagingMemory;
+        int vertexPageMB = FileUtils::GetIntegerFromConfig("Resource/ngine.ini", "Memory", "GeometryVertexPageMB");
+        int indexPageMB = FileUtils::GetIntegerFromConfig("Resource/ngine.ini", "Memory", "GeometryIndexPageMB");
 
-        //Callucate memory size required to hold the buffer
-        VkDeviceSize bufferSize = sizeof(verts[0]) * verts.size();
+        VkDeviceSize vertexPageSize = (VkDeviceSize)(vertexPageMB > 0 ? vertexPageMB : 64) * 1024 * 1024;
+        VkDeviceSize indexPageSize = (VkDeviceSize)(indexPageMB > 0 ? indexPageMB : 16) * 1024 * 1024;
 
-        //Create buffer that can interact with CPU
-        CreateBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, stagingBuffer, stagingMemory);
+        mGeometry.Initialize(mDevice, &mAllocator, vertexPageSize, indexPageSize);
+    }
 
-        //Copy data from CPU to staging buffer
-        void* data;
-        vkMapMemory(mDevice, stagingMemory, 0, bufferSize, 0, &data);
-        memcpy(data, verts.data(), (size_t)bufferSize);
-        vkUnmapMemory(mDevice, stagingMemory);
+    void GraphicsCore::CreateFrameUniformAllocator()
+    {
+        int sizeKB = FileUtils::GetIntegerFromConfig("Resource/ngine.ini", "Memory", "FrameUniformSizeKB");
+        VkDeviceSize size = (VkDeviceSize)(sizeKB > 0 ? sizeKB : 4096) * 1024;
 
-        //Create vertex buffer that will be utilized by GPU
-        CreateBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, m.mVertexBuffer, m.mVertexMemory);
+        VkPhysicalDeviceProperties devProp;
+        vkGetPhysicalDeviceProperties(mPhysDevice, &devProp);
 
-        //Copy data from staging buffer to vertex buffer
-        CopyBuffer(stagingBuffer, m.mVertexBuffer, bufferSize);
+        //Dynamic offsets have to be multiple of minUniformBufferOffsetAlignment
+        mFrameUniforms.Initialize(mDevice, &mAllocator, size, devProp.limits.minUniformBufferOffsetAlignment);
 
-        //Clear staging buffer
-        vkDestroyBuffer(mDevice, stagingBuffer, nullptr);
-        vkFreeMemory(mDevice, stagingMemory, nullptr);
-    }
+        int instanceSizeKB = FileUtils::GetIntegerFromConfig("Resource/ngine.ini", "Memory", "FrameInstanceSizeKB");
+        VkDeviceSize instanceSize = (VkDeviceSize)(instanceSizeKB > 0 ? instanceSizeKB : 8192) * 1024;
 
-    uint32_t GraphicsCore::FindMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags props)
-    {
-        VkPhysicalDeviceMemoryProperties memProps;
-        vkGetPhysicalDeviceMemoryProperties(mPhysDevice, &memProps);
+        //Culling pass writes surviving instances straight into instance buffer
+        VkBufferUsageFlags instanceUsage = VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | (mGpuCulling ? VK_BUFFER_USAGE_STORAGE_BUFFER_BIT : 0);
+        mFrameInstances.Initialize(mDevice, &mAllocator, instanceSize, sizeof(InstanceData), instanceUsage);
 
-        for (uint32_t i = 0; i < memProps.memoryTypeCount; i++)
+        if(mIndirectDraw)
         {
-            if ((typeFilter & (1 << i)) && (memProps.memoryTypes[i].propertyFlags & props) == props)
-                return i;
+            int indirectSizeKB = FileUtils::GetIntegerFromConfig("Resource/ngine.ini", "Memory", "FrameIndirectSizeKB");
+            VkDeviceSize indirectSize = (VkDeviceSize)(indirectSizeKB > 0 ? indirectSizeKB : 1024) * 1024;
+
+            //Indirect and count offsets only have to be multiple of 4
+            VkBufferUsageFlags indirectUsage = VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT;
+            if(mGpuCulling)
+                indirectUsage |= VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+
+            mFrameIndirect.Initialize(mDevice, &mAllocator, indirectSize, sizeof(uint32_t), indirectUsage);
+            mMaxDrawIndirectCount = devProp.limits.maxDrawIndirectCount;
         }
 
-        throw Exception();
-    }
+        if(mBindless)
+        {
+            int bindlessSizeKB = FileUtils::GetIntegerFromConfig("Resource/ngine.ini", "Memory", "FrameBindlessSizeKB");
+            VkDeviceSize bindlessSize = (VkDeviceSize)(bindlessSizeKB > 0 ? bindlessSizeKB : 4096) * 1024;
 
-    void GraphicsCore::CreateBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags props, VkBuffer& buffer, VkDeviceMemory& memory)
-    {
-        VkBufferCreateInfo bufferInfo{};
-        bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
-        bufferInfo.size = size;
-        bufferInfo.usage = usage;
-        bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+            //std430 alignment, camera and objects are multiples of it so every object offset maps to an index
+            mBindlessObjects.Initialize(mDevice, &mAllocator, bindlessSize, 16, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
+        }
 
-        VkResult res = vkCreateBuffer(mDevice, &bufferInfo, nullptr, &buffer);
-        VK_THROW_IF_FAILED(res);
+        if(mGpuCulling)
+        {
+            int cullSizeKB = FileUtils::GetIntegerFromConfig("Resource/ngine.ini", "Memory", "FrameCullSizeKB");
+            VkDeviceSize cullSize = (VkDeviceSize)(cullSizeKB > 0 ? cullSizeKB : 16384) * 1024;
 
-        VkMemoryRequirements memReq;
-        vkGetBufferMemoryRequirements(mDevice, buffer, &memReq);
+            mGpuCulling = mCuller.Initialize(mDevice, &mAllocator, mPipelineCache.GetHandle(), "Resource/Shader/cull_comp.spv", cullSize, &mFrameInstances, &mFrameIndirect);
+        }
+    }
 
-        VkMemoryAllocateInfo allocInfo = {};
-        allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-        allocInfo.allocationSize = memReq.size;
-        allocInfo.memoryTypeIndex = FindMemoryType(memReq.memoryTypeBits, props);
+    void GraphicsCore::CreateOcclusionBuffer()
+    {
+        //Calling thread always takes part in the work, so one thread is left for it
+        int workers = FileUtils::GetIntegerFromConfig("Resource/ngine.ini", "General", "WorkerThreads");
+        mWorkers.Initialize(workers > 0 ? workers : std::max((int)std::thread::hardware_concurrency() - 1, 1));
 
-        res = vkAllocateMemory(mDevice, &allocInfo, nullptr, &memory);
-        VK_THROW_IF_FAILED(res);
+        mOcclusionCulling = FileUtils::GetBoolFromConfig("Resource/ngine.ini", "Occlusion", "Enable");
+        if(!mOcclusionCulling)
+            return;
 
-        vkBindBufferMemory(mDevice, buffer, memory, 0);
+        int width = FileUtils::GetIntegerFromConfig("Resource/ngine.ini", "Occlusion", "Width");
+        int height = FileUtils::GetIntegerFromConfig("Resource/ngine.ini", "Occlusion", "Height");
+        mOcclusion.Initialize(width > 0 ? width : 256, height > 0 ? height : 128, &mWorkers);
     }
 
-    void GraphicsCore::CopyBuffer(VkBuffer src, VkBuffer dst, VkDeviceSize size)
+    void GraphicsCore::CreateRecordContexts()
     {
-        VkCommandBufferAllocateInfo allocInfo = {};
-        allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
-        allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-        allocInfo.commandPool = mCmdPool;
-        allocInfo.commandBufferCount = 1;
-
-        VkCommandBuffer cmdBuffer;
-        vkAllocateCommandBuffers(mDevice, &allocInfo, &cmdBuffer);
+        mParallelRecording = FileUtils::GetBoolFromConfig("Resource/ngine.ini", "General", "ParallelRecording");
+        if(!mParallelRecording)
+            return;
 
-        VkCommandBufferBeginInfo beginInfo = {};
-        beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-        beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+        //Every thread that can record a chunk gets its own context, plus one for instance groups
+        mRecordThreads = mWorkers.GetThreadCount();
+        mRecordContextCount = mRecordThreads + 1;
+        vecRecordContexts.resize(MAX_FRAMES_IN_FLIGHT * mRecordContextCount);
 
-        vkBeginCommandBuffer(cmdBuffer, &beginInfo);
+        for(auto& context : vecRecordContexts)
+        {
+            //Whole pool is reset once its frame is finished, buffers are never reset one by one
+            VkCommandPoolCreateInfo cmdPoolInfo = {};
+            cmdPoolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+            cmdPoolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+            cmdPoolInfo.queueFamilyIndex = mQueueData.mGraphicsQueueIndex.value();
 
-        VkBufferCopy copyRegion = {};
-        copyRegion.srcOffset = 0; // Optional
-        copyRegion.dstOffset = 0; // Optional
-        copyRegion.size = size;
+            VkResult res = vkCreateCommandPool(mDevice, &cmdPoolInfo, nullptr, &context.mPool);
+            VK_THROW_IF_FAILED(res);
 
-        vkCmdCopyBuffer(cmdBuffer, src, dst, 1, &copyRegion);
-        vkEndCommandBuffer(cmdBuffer);
+            VkCommandBufferAllocateInfo allocInfo = {};
+            allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+            allocInfo.commandPool = context.mPool;
+            allocInfo.level = VK_COMMAND_BUFFER_LEVEL_SECONDARY;
+            allocInfo.commandBufferCount = 1;
 
-        VkSubmitInfo submitInfo{};
-        submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-        submitInfo.commandBufferCount = 1;
-        submitInfo.pCommandBuffers = &cmdBuffer;
+            res = vkAllocateCommandBuffers(mDevice, &allocInfo, &context.mCmdBuffer);
+            VK_THROW_IF_FAILED(res);
 
-        vkQueueSubmit(mGraphicsQueue, 1, &submitInfo, VK_NULL_HANDLE);
-        vkQueueWaitIdle(mGraphicsQueue);
+            //Pre-pass records the same chunk into a buffer of its own before shading pass begins
+            if(mDepthPrepassPipelines)
+            {
+                res = vkAllocateCommandBuffers(mDevice, &allocInfo, &context.mPrepassCmdBuffer);
+                VK_THROW_IF_FAILED(res);
+            }
+        }
 
-        vkFreeCommandBuffers(mDevice, mCmdPool, 1, &cmdBuffer);
+        LOG_F(INFO, "Draw list is recorded into secondary command buffers by up to %u threads", mRecordThreads);
     }
 
-    void GraphicsCore::CreateIndexBuffer(Mesh& m, std::vector<uint16_t> indices)
+    void GraphicsCore::CreateStatisticsQueries()
     {
-        //Calculate memory required to hold the buffer
-        VkDeviceSize bufferSize = sizeof(indices[0]) * indices.size();
-        VkBuffer stagingBuffer;
-        VkDeviceMemory stagingMemory;
-
-        //Create staging buffer
-        CreateBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, stagingBuffer, stagingMemory);
+        if(!mPipelineStatistics)
+            return;
 
-        //Copy data to staging buffer
-        void* data;
-        vkMapMemory(mDevice, stagingMemory, 0, bufferSize, 0, &data);
-        memcpy(data, indices.data(), (size_t)bufferSize);
-        vkUnmapMemory(mDevice, stagingMemory);
+        VkQueryPoolCreateInfo poolInfo = {};
+        poolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+        poolInfo.queryType = VK_QUERY_TYPE_PIPELINE_STATISTICS;
+        poolInfo.queryCount = MAX_FRAMES_IN_FLIGHT;
+        poolInfo.pipelineStatistics = VK_QUERY_PIPELINE_STATISTIC_FRAGMENT_SHADER_INVOCATIONS_BIT;
 
-        //Create index buffer
-        CreateBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, m.mIndexBuffer, m.mIndexMemory);
-        
-        //Copy data from staging to index buffer
-        CopyBuffer(stagingBuffer, m.mIndexBuffer, bufferSize);
+        VkResult res = vkCreateQueryPool(mDevice, &poolInfo, nullptr, &mStatisticsPool);
+        VK_THROW_IF_FAILED(res);
 
-        //Release staging buffer
-        vkDestroyBuffer(mDevice, stagingBuffer, nullptr);
-        vkFreeMemory(mDevice, stagingMemory, nullptr);
+        vecStatisticsEpochs.assign(MAX_FRAMES_IN_FLIGHT, 0);
+        LOG_F(INFO, "Fragment shader invocations of shading pass are counted");
     }
 
-    void GraphicsCore::CreateDescriptorSetLayout(Shader& shader)
+    void GraphicsCore::ReadStatisticsQueries()
     {
-        VkDescriptorSetLayoutBinding mvpLayoutBinding = {};
-        mvpLayoutBinding.binding = 0;
-        mvpLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-        mvpLayoutBinding.descriptorCount = 1;
-        mvpLayoutBinding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
-        mvpLayoutBinding.pImmutableSamplers = nullptr;
+        if(mStatisticsPool == VK_NULL_HANDLE || vecStatisticsEpochs[mCurrentFrame] == 0)
+            return;
 
-        VkDescriptorSetLayoutCreateInfo layoutInfo = {};
-        layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
-        layoutInfo.bindingCount = 1;
-        layoutInfo.pBindings = &mvpLayoutBinding;
+        //Fence of this frame was waited for, so the result is there unless the query was never ended
+        uint64_t invocations = 0;
+        VkResult res = vkGetQueryPoolResults(mDevice, mStatisticsPool, mCurrentFrame, 1, sizeof(invocations), &invocations, sizeof(invocations), VK_QUERY_RESULT_64_BIT);
 
-        VkResult res = vkCreateDescriptorSetLayout(mDevice, &layoutInfo, nullptr, &shader.mDescLayout);
-        VK_THROW_IF_FAILED(res);
+        //Frames recorded before the last stats reset do not count
+        if(res == VK_SUCCESS && vecStatisticsEpochs[mCurrentFrame] == mStatisticsEpoch)
+        {
+            mFragmentInvocationSum += invocations;
+            mFragmentsPerPixelSum += (double)invocations / ((double)mSwapExtent.width * mSwapExtent.height);
+            mFragmentFrames++;
+        }
+
+        vecStatisticsEpochs[mCurrentFrame] = 0;
     }
 
-    void GraphicsCore::CreateMvpBuffer(Model& m)
+    void GraphicsCore::SetRecordThreads(uint32_t count)
     {
-        VkDeviceSize bufferSize = sizeof(MVP);
-	
-        m.vecUniformBuffers.resize(MAX_FRAMES_IN_FLIGHT);
-        m.vecUniformBuffersMapped.resize(MAX_FRAMES_IN_FLIGHT);
-        m.vecUniformMemory.resize(MAX_FRAMES_IN_FLIGHT);
-
-        for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
-        {
-            CreateBuffer(bufferSize, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, m.vecUniformBuffers[i], m.vecUniformMemory[i]);
-            vkMapMemory(mDevice, m.vecUniformMemory[i], 0, bufferSize, 0, &m.vecUniformBuffersMapped[i]);
-        }
+        mRecordThreads = std::clamp(count, 1u, mWorkers.GetThreadCount());
     }
 
-    void GraphicsCore::CreateDescriptorPool(Shader& shader)
+    void GraphicsCore::SetDepthPrepass(bool enable)
     {
-        VkDescriptorPoolSize poolSize = {};
-        poolSize.type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+        if(enable && !mDepthPrepassPipelines)
+            LOG_F(WARNING, "Depth pre-pass needs [General] DepthPrepass so shaders get pre-pass pipelines");
+
+        mDepthPrepass = enable && mDepthPrepassPipelines;
+    }
+
+    void GraphicsCore::CreateMeshGeometry(Mesh& m, const std::vector<Vertex>& verts, const std::vector<uint16_t>& indices, const glm::vec4& quantization)
+    {
+        CreateMeshGeometry(m, verts, indices.data(), indices.size(), VK_INDEX_TYPE_UINT16, quantization);
+    }
+
+    void GraphicsCore::CreateMeshGeometry(Mesh& m, const std::vector<Vertex>& verts, const std::vector<uint32_t>& indices, const glm::vec4& quantization)
+    {
+        CreateMeshGeometry(m, verts, indices.data(), indices.size(), VK_INDEX_TYPE_UINT32, quantization);
+    }
+
+    void GraphicsCore::CreateMeshGeometry(Mesh& m, const std::vector<Vertex>& verts, const void* pIndices, uint32_t indexCount, VkIndexType indexType, const glm::vec4& quantization)
+    {
+        VkDeviceSize indexStride = indexType == VK_INDEX_TYPE_UINT32 ? sizeof(uint32_t) : sizeof(uint16_t);
+
+        m.mVertexCount = verts.size();
+        CalculateBounds(m, verts);
+        m.mIndexCount = indexCount;
+        m.mIndexType = indexType;
+
+        //Bounds stay in model space, only data uploaded for the GPU is moved into quantization box
+        m.mLayout = quantization.w > 0.0f ? ChooseVertexLayout(m, verts, quantization) : VertexLayout::Full;
+        VkDeviceSize vertexStride = Vertex::GetStride(m.mLayout);
+
+        //Callucate memory size required to hold mesh data
+        VkDeviceSize vertexSize = vertexStride * verts.size();
+        VkDeviceSize indexSize = indexStride * indexCount;
+
+        const void* pVertexData = verts.data();
+        std::vector<uint8_t> vecVertexData;
+
+        if(quantization.w > 0.0f)
+        {
+            vecVertexData.resize(vertexSize);
+            WriteVertices(verts, m.mLayout, quantization, vecVertexData.data());
+            pVertexData = vecVertexData.data();
+        }
+
+        //Reserve ranges inside one of shared arena pages instead of creating buffers per mesh
+        m.mGeometry = mGeometry.Allocate(vertexSize, vertexStride, indexSize, indexStride);
+        m.mVertexOffset = m.mGeometry.mVertexOffset / vertexStride;
+        m.mFirstIndex = m.mGeometry.mIndexOffset / indexStride;
+
+        //Queue copies from staging ring to arena, they will be submitted together with other uploads
+        m.mUploadTicket = mUploader.Upload(mGeometry.GetVertexBuffer(m.mGeometry.mPage), m.mGeometry.mVertexOffset, pVertexData, vertexSize);
+
+        if(indexSize > 0)
+            m.mUploadTicket = mUploader.Upload(mGeometry.GetIndexBuffer(m.mGeometry.mPage), m.mGeometry.mIndexOffset, pIndices, indexSize);
+    }
+
+    VertexLayout GraphicsCore::ChooseVertexLayout(const Mesh& m, const std::vector<Vertex>& verts, const glm::vec4& quantization) const
+    {
+        //16 bit grid spans the whole model, small detailed parts of big models would lose their shape on it
+        float positionStep = quantization.w / INT16_MAX;
+        if(positionStep * 0.5f > mQuantizePositionError * m.mBoundingSphere.w)
+            return VertexLayout::Full;
+
+        //Half floats lose precision quickly away from zero, so tiled UVs with large coordinates stay 32 bit
+        for(auto& vertex : verts)
+        {
+            glm::vec2 uv = glm::unpackHalf2x16(glm::packHalf2x16(vertex.uv));
+            if(std::fabs(uv.x - vertex.uv.x) > mQuantizeUvError || std::fabs(uv.y - vertex.uv.y) > mQuantizeUvError)
+                return VertexLayout::Full;
+        }
+
+        return VertexLayout::Packed;
+    }
+
+    void GraphicsCore::WriteVertices(const std::vector<Vertex>& verts, VertexLayout layout, const glm::vec4& quantization, uint8_t* pOut)
+    {
+        glm::vec3 center = glm::vec3(quantization);
+        float invScale = 1.0f / quantization.w;
+
+        if(layout == VertexLayout::Full)
+        {
+            Vertex* pVerts = reinterpret_cast<Vertex*>(pOut);
+
+            for(size_t i = 0; i < verts.size(); i++)
+            {
+                pVerts[i] = verts[i];
+                pVerts[i].pos = (verts[i].pos - center) * invScale;
+            }
+
+            return;
+        }
+
+        PackedVertex* pVerts = reinterpret_cast<PackedVertex*>(pOut);
+
+        for(size_t i = 0; i < verts.size(); i++)
+        {
+            glm::vec3 pos = (verts[i].pos - center) * invScale;
+
+            pVerts[i].pos[0] = (int16_t)std::lround(glm::clamp(pos.x, -1.0f, 1.0f) * INT16_MAX);
+            pVerts[i].pos[1] = (int16_t)std::lround(glm::clamp(pos.y, -1.0f, 1.0f) * INT16_MAX);
+            pVerts[i].pos[2] = (int16_t)std::lround(glm::clamp(pos.z, -1.0f, 1.0f) * INT16_MAX);
+            pVerts[i].pos[3] = INT16_MAX;
+            pVerts[i].color = glm::packUnorm4x8(glm::vec4(verts[i].color, 1.0f));
+            pVerts[i].uv = glm::packHalf2x16(verts[i].uv);
+        }
+    }
+
+    glm::vec4 GraphicsCore::CalculateQuantization(const aiScene* pScene)
+    {
+        glm::vec3 boundsMin = glm::vec3(FLT_MAX), boundsMax = glm::vec3(-FLT_MAX);
+
+        for(uint32_t m = 0; m < pScene->mNumMeshes; m++)
+        {
+            const aiMesh* pMesh = pScene->mMeshes[m];
+
+            for(uint32_t i = 0; i < pMesh->mNumVertices; i++)
+            {
+                glm::vec3 pos = glm::vec3(pMesh->mVertices[i].x, pMesh->mVertices[i].y, pMesh->mVertices[i].z);
+                boundsMin = glm::min(boundsMin, pos);
+                boundsMax = glm::max(boundsMax, pos);
+            }
+        }
+
+        if(boundsMin.x > boundsMax.x)
+            return glm::vec4(0.0f);
+
+        //Cube keeps dequantization a uniform scale, so bounding spheres can be moved into the box as well
+        glm::vec3 halfSize = (boundsMax - boundsMin) * 0.5f;
+        float scale = std::max({ halfSize.x, halfSize.y, halfSize.z });
+
+        return glm::vec4((boundsMin + boundsMax) * 0.5f, scale > 0.0f ? scale : 1.0f);
+    }
+
+    glm::mat4 GraphicsCore::GetShaderWorld(const glm::mat4& world, const Model& m)
+    {
+        if(m.mQuantization.w <= 0.0f)
+            return world;
+
+        //world * translate(center) * scale(w), written out since it is done for every drawn object
+        glm::mat4 result = world;
+        result[0] *= m.mQuantization.w;
+        result[1] *= m.mQuantization.w;
+        result[2] *= m.mQuantization.w;
+        result[3] = world * glm::vec4(glm::vec3(m.mQuantization), 1.0f);
+        return result;
+    }
+
+    void GraphicsCore::CreateBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags props, VkBuffer& buffer, Allocation& alloc)
+    {
+        VkBufferCreateInfo bufferInfo{};
+        bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+        bufferInfo.size = size;
+        bufferInfo.usage = usage;
+        bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+        VkResult res = vkCreateBuffer(mDevice, &bufferInfo, nullptr, &buffer);
+        VK_THROW_IF_FAILED(res);
+
+        VkMemoryRequirements memReq;
+        vkGetBufferMemoryRequirements(mDevice, buffer, &memReq);
+
+        //Suballocate memory from one of allocator blocks instead of calling vkAllocateMemory per buffer
+        alloc = mAllocator.Allocate(memReq, props);
+
+        res = vkBindBufferMemory(mDevice, buffer, alloc.mMemory, alloc.mOffset);
+        VK_THROW_IF_FAILED(res);
+    }
+
+    void GraphicsCore::DestroyBuffer(VkBuffer& buffer, Allocation& alloc)
+    {
+        if(buffer != VK_NULL_HANDLE)
+            vkDestroyBuffer(mDevice, buffer, nullptr);
+
+        mAllocator.Free(alloc);
+        buffer = VK_NULL_HANDLE;
+    }
+
+    void GraphicsCore::CreateShaderLayouts()
+    {
+        VkDescriptorSetLayoutBinding mvpLayoutBinding = {};
+        mvpLayoutBinding.binding = 0;
+        mvpLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+        mvpLayoutBinding.descriptorCount = 1;
+        mvpLayoutBinding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+        mvpLayoutBinding.pImmutableSamplers = nullptr;
+
+        VkDescriptorSetLayoutCreateInfo layoutInfo = {};
+        layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+        layoutInfo.bindingCount = 1;
+        layoutInfo.pBindings = &mvpLayoutBinding;
+
+        VkResult res = vkCreateDescriptorSetLayout(mDevice, &layoutInfo, nullptr, &mObjectSetLayout);
+        VK_THROW_IF_FAILED(res);
+
+        //Shaders differ only in push constant use, so two pipeline layouts cover all of them
+        VkPushConstantRange pushRange = {};
+        pushRange.stageFlags = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT;
+        pushRange.offset = 0;
+        pushRange.size = sizeof(ObjectPushConstants);
+
+        for(uint32_t usesPush = 0; usesPush < 2; usesPush++)
+        {
+            VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+            pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+            pipelineLayoutInfo.setLayoutCount = 1;
+            pipelineLayoutInfo.pSetLayouts = &mObjectSetLayout;
+            pipelineLayoutInfo.pushConstantRangeCount = usesPush;
+            pipelineLayoutInfo.pPushConstantRanges = usesPush ? &pushRange : nullptr;
+
+            res = vkCreatePipelineLayout(mDevice, &pipelineLayoutInfo, nullptr, &mPipelineLayouts[usesPush]);
+            VK_THROW_IF_FAILED(res);
+        }
+    }
+
+    void GraphicsCore::CreateBindlessSet()
+    {
+        if(!mBindless)
+            return;
+
+        VkPhysicalDeviceVulkan12Properties props12 = {};
+        props12.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_PROPERTIES;
+
+        VkPhysicalDeviceProperties2 props = {};
+        props.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+        props.pNext = &props12;
+        vkGetPhysicalDeviceProperties2(mPhysDevice, &props);
+
+        int textures = FileUtils::GetIntegerFromConfig("Resource/ngine.ini", "General", "BindlessTextures");
+        mBindlessTextureCapacity = std::min<uint32_t>(textures > 0 ? textures : 4096, props12.maxDescriptorSetUpdateAfterBindSampledImages);
+        mBindlessTextureCapacity = std::min(mBindlessTextureCapacity, props12.maxPerStageDescriptorUpdateAfterBindSampledImages);
+
+        VkDescriptorSetLayoutBinding bindings[2] = {};
+        bindings[0].binding = 0;
+        bindings[0].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        bindings[0].descriptorCount = MAX_FRAMES_IN_FLIGHT;
+        bindings[0].stageFlags = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT;
+        bindings[1].binding = 1;
+        bindings[1].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+        bindings[1].descriptorCount = mBindlessTextureCapacity;
+        bindings[1].stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+
+        //Frame buffers are written once here, texture slots are filled one by one while the set is in use
+        VkDescriptorBindingFlags bindingFlags[2] = { 0, VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT | VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT };
+
+        VkDescriptorSetLayoutBindingFlagsCreateInfo flagsInfo = {};
+        flagsInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO;
+        flagsInfo.bindingCount = 2;
+        flagsInfo.pBindingFlags = bindingFlags;
+
+        VkDescriptorSetLayoutCreateInfo layoutInfo = {};
+        layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+        layoutInfo.pNext = &flagsInfo;
+        layoutInfo.flags = VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT;
+        layoutInfo.bindingCount = 2;
+        layoutInfo.pBindings = bindings;
+
+        VkResult res = vkCreateDescriptorSetLayout(mDevice, &layoutInfo, nullptr, &mBindlessSetLayout);
+        VK_THROW_IF_FAILED(res);
+
+        VkPushConstantRange pushRange = {};
+        pushRange.stageFlags = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT;
+        pushRange.offset = 0;
+        pushRange.size = sizeof(BindlessPushConstants);
+
+        VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+        pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+        pipelineLayoutInfo.setLayoutCount = 1;
+        pipelineLayoutInfo.pSetLayouts = &mBindlessSetLayout;
+        pipelineLayoutInfo.pushConstantRangeCount = 1;
+        pipelineLayoutInfo.pPushConstantRanges = &pushRange;
+
+        res = vkCreatePipelineLayout(mDevice, &pipelineLayoutInfo, nullptr, &mBindlessPipelineLayout);
+        VK_THROW_IF_FAILED(res);
+
+        VkDescriptorPoolSize poolSizes[2] = {};
+        poolSizes[0].type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        poolSizes[0].descriptorCount = MAX_FRAMES_IN_FLIGHT;
+        poolSizes[1].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+        poolSizes[1].descriptorCount = mBindlessTextureCapacity;
+
+        VkDescriptorPoolCreateInfo poolInfo = {};
+        poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+        poolInfo.flags = VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT;
+        poolInfo.poolSizeCount = 2;
+        poolInfo.pPoolSizes = poolSizes;
+        poolInfo.maxSets = 1;
+
+        res = vkCreateDescriptorPool(mDevice, &poolInfo, nullptr, &mBindlessPool);
+        VK_THROW_IF_FAILED(res);
+
+        VkDescriptorSetAllocateInfo allocInfo = {};
+        allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+        allocInfo.descriptorPool = mBindlessPool;
+        allocInfo.descriptorSetCount = 1;
+        allocInfo.pSetLayouts = &mBindlessSetLayout;
+
+        res = vkAllocateDescriptorSets(mDevice, &allocInfo, &mBindlessSet);
+        VK_THROW_IF_FAILED(res);
+
+        std::vector<VkDescriptorBufferInfo> vecBufferInfos(MAX_FRAMES_IN_FLIGHT);
+        for(uint32_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
+        {
+            vecBufferInfos[i].buffer = mBindlessObjects.GetBuffer(i);
+            vecBufferInfos[i].offset = 0;
+            vecBufferInfos[i].range = VK_WHOLE_SIZE;
+        }
+
+        VkWriteDescriptorSet descriptorWrite{};
+        descriptorWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        descriptorWrite.dstSet = mBindlessSet;
+        descriptorWrite.dstBinding = 0;
+        descriptorWrite.dstArrayElement = 0;
+        descriptorWrite.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        descriptorWrite.descriptorCount = MAX_FRAMES_IN_FLIGHT;
+        descriptorWrite.pBufferInfo = vecBufferInfos.data();
+
+        vkUpdateDescriptorSets(mDevice, 1, &descriptorWrite, 0, nullptr);
+
+        LOG_F(INFO, "Bindless descriptor set created (%u texture slots)", mBindlessTextureCapacity);
+    }
+
+    std::optional<uint32_t> GraphicsCore::RegisterBindlessTexture(VkImageView view, VkSampler sampler)
+    {
+        if(!mBindless || mBindlessTextureCount >= mBindlessTextureCapacity)
+        {
+            LOG_F(ERROR, "Cannot register bindless texture, %s", mBindless ? "all texture slots are used" : "bindless descriptors are disabled");
+            return std::nullopt;
+        }
+
+        VkDescriptorImageInfo imageInfo = {};
+        imageInfo.sampler = sampler;
+        imageInfo.imageView = view;
+        imageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+
+        VkWriteDescriptorSet descriptorWrite{};
+        descriptorWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        descriptorWrite.dstSet = mBindlessSet;
+        descriptorWrite.dstBinding = 1;
+        descriptorWrite.dstArrayElement = mBindlessTextureCount;
+        descriptorWrite.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+        descriptorWrite.descriptorCount = 1;
+        descriptorWrite.pImageInfo = &imageInfo;
+
+        //Slot is not used by any recorded draw yet, update after bind makes writing it legal while frames are in flight
+        vkUpdateDescriptorSets(mDevice, 1, &descriptorWrite, 0, nullptr);
+
+        return mBindlessTextureCount++;
+    }
+
+    void GraphicsCore::CreateDescriptorPool(Shader& shader)
+    {
+        VkDescriptorPoolSize poolSize = {};
+        poolSize.type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
         poolSize.descriptorCount = static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT);
 
-        VkDescriptorPoolCreateInfo poolInfo = {};
-        poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
-        poolInfo.poolSizeCount = 1;
-        poolInfo.pPoolSizes = &poolSize;
-        poolInfo.maxSets = (MAX_FRAMES_IN_FLIGHT * 200);
+        VkDescriptorPoolCreateInfo poolInfo = {};
+        poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+        poolInfo.poolSizeCount = 1;
+        poolInfo.pPoolSizes = &poolSize;
+        poolInfo.maxSets = MAX_FRAMES_IN_FLIGHT;
+
+        VkResult res = vkCreateDescriptorPool(mDevice, &poolInfo, nullptr, &shader.mDescPool);
+        VK_THROW_IF_FAILED(res);
+    }
+
+    void GraphicsCore::CreateDescriptorSets(Shader& shader)
+    {
+        std::vector<VkDescriptorSetLayout> layouts(MAX_FRAMES_IN_FLIGHT, shader.mDescLayout);
+        VkDescriptorSetAllocateInfo allocInfo = {};
+        allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+        allocInfo.descriptorPool = shader.mDescPool;
+        allocInfo.descriptorSetCount = static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT);
+        allocInfo.pSetLayouts = layouts.data();
+
+        shader.vecDescSets.resize(MAX_FRAMES_IN_FLIGHT);
+        VkResult res = vkAllocateDescriptorSets(mDevice, &allocInfo, shader.vecDescSets.data());
+        VK_THROW_IF_FAILED(res);
+
+        //Every set points at whole frame uniform buffer, objects select their data with dynamic offset
+        for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
+        {
+            VkDescriptorBufferInfo bufferInfo = {};
+            bufferInfo.buffer = mFrameUniforms.GetBuffer(i);
+            bufferInfo.offset = 0;
+            bufferInfo.range = (shader.mUsesPushConstants || shader.mUsesInstancing) ? sizeof(CameraConstants) : sizeof(MVP);
+
+            VkWriteDescriptorSet descriptorWrite{};
+            descriptorWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+            descriptorWrite.dstSet = shader.vecDescSets[i];
+            descriptorWrite.dstBinding = 0;
+            descriptorWrite.dstArrayElement = 0;
+            descriptorWrite.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+            descriptorWrite.descriptorCount = 1;
+            descriptorWrite.pBufferInfo = &bufferInfo;
+            descriptorWrite.pImageInfo = nullptr;
+            descriptorWrite.pTexelBufferView = nullptr;
+
+            vkUpdateDescriptorSets(mDevice, 1, &descriptorWrite, 0, nullptr);
+        }
+    }
+
+    void GraphicsCore::WriteObjectConstants(GameObject3D* pGo, MVP* pMvp)
+    {
+        pMvp->model = GetShaderWorld(pGo->GetWorldMatrix(), vecModels[pGo->mModelIndex]);
+        pMvp->view = view;
+        pMvp->projection = proj;
+    }
+
+    bool GraphicsCore::WriteCameraConstants(uint32_t& outOffset)
+    {
+        CameraConstants* pCamera = static_cast<CameraConstants*>(mFrameUniforms.Allocate(sizeof(CameraConstants), outOffset));
+        if(pCamera == nullptr)
+            return false;
+
+        pCamera->view = view;
+        pCamera->projection = proj;
+        return true;
+    }
+
+    bool GraphicsCore::ShaderUsesPushConstants(const std::vector<char>& code)
+    {
+        const uint32_t spirvMagic = 0x07230203;
+        const uint32_t opVariable = 59;
+        const uint32_t storageClassPushConstant = 9;
+
+        const uint32_t* pWords = reinterpret_cast<const uint32_t*>(code.data());
+        size_t wordCount = code.size() / sizeof(uint32_t);
+
+        if(wordCount < 5 || pWords[0] != spirvMagic)
+            return false;
+
+        //Walk instructions after 5 word header looking for OpVariable %type %id PushConstant
+        for(size_t i = 5; i < wordCount;)
+        {
+            uint32_t instrLength = pWords[i] >> 16;
+            uint32_t opcode = pWords[i] & 0xFFFF;
+
+            if(instrLength == 0)
+                break;
+
+            if(opcode == opVariable && instrLength >= 4 && i + 3 < wordCount && pWords[i + 3] == storageClassPushConstant)
+                return true;
+
+            i += instrLength;
+        }
+
+        return false;
+    }
+
+    bool GraphicsCore::ShaderUsesStorageBuffer(const std::vector<char>& code)
+    {
+        const uint32_t spirvMagic = 0x07230203;
+        const uint32_t opDecorate = 71;
+        const uint32_t opVariable = 59;
+        const uint32_t decorationBufferBlock = 3;
+        const uint32_t storageClassStorageBuffer = 12;
+
+        const uint32_t* pWords = reinterpret_cast<const uint32_t*>(code.data());
+        size_t wordCount = code.size() / sizeof(uint32_t);
+
+        if(wordCount < 5 || pWords[0] != spirvMagic)
+            return false;
+
+        //SPIR-V 1.3+ uses StorageBuffer class, older modules mark Uniform block with BufferBlock
+        for(size_t i = 5; i < wordCount;)
+        {
+            uint32_t instrLength = pWords[i] >> 16;
+            uint32_t opcode = pWords[i] & 0xFFFF;
+
+            if(instrLength == 0 || i + instrLength > wordCount)
+                break;
+
+            if(opcode == opDecorate && instrLength >= 3 && pWords[i + 2] == decorationBufferBlock)
+                return true;
+
+            if(opcode == opVariable && instrLength >= 4 && pWords[i + 3] == storageClassStorageBuffer)
+                return true;
+
+            i += instrLength;
+        }
+
+        return false;
+    }
+
+    bool GraphicsCore::ShaderReadsInputLocation(const std::vector<char>& code, uint32_t location)
+    {
+        const uint32_t spirvMagic = 0x07230203;
+        const uint32_t opDecorate = 71;
+        const uint32_t opVariable = 59;
+        const uint32_t decorationLocation = 30;
+        const uint32_t storageClassInput = 1;
+
+        const uint32_t* pWords = reinterpret_cast<const uint32_t*>(code.data());
+        size_t wordCount = code.size() / sizeof(uint32_t);
+
+        if(wordCount < 5 || pWords[0] != spirvMagic)
+            return false;
+
+        //Decorations come before variables so ids with matching location are known when OpVariable is reached
+        std::vector<uint32_t> vecLocationIds;
+
+        for(size_t i = 5; i < wordCount;)
+        {
+            uint32_t instrLength = pWords[i] >> 16;
+            uint32_t opcode = pWords[i] & 0xFFFF;
+
+            if(instrLength == 0 || i + instrLength > wordCount)
+                break;
+
+            if(opcode == opDecorate && instrLength >= 4 && pWords[i + 2] == decorationLocation && pWords[i + 3] == location)
+                vecLocationIds.push_back(pWords[i + 1]);
+
+            if(opcode == opVariable && instrLength >= 4 && pWords[i + 3] == storageClassInput)
+            {
+                if(std::find(vecLocationIds.begin(), vecLocationIds.end(), pWords[i + 2]) != vecLocationIds.end())
+                    return true;
+            }
+
+            i += instrLength;
+        }
+
+        return false;
+    }
+
+    bool GraphicsCore::ShaderDisablesEarlyDepth(const std::vector<char>& code)
+    {
+        const uint32_t spirvMagic = 0x07230203;
+        const uint32_t opDecorate = 71;
+        const uint32_t opKill = 252;
+        const uint32_t opTerminateInvocation = 4416;
+        const uint32_t opDemoteToHelperInvocation = 5380;
+        const uint32_t decorationBuiltIn = 11;
+        const uint32_t builtInFragDepth = 22;
+
+        const uint32_t* pWords = reinterpret_cast<const uint32_t*>(code.data());
+        size_t wordCount = code.size() / sizeof(uint32_t);
+
+        if(wordCount < 5 || pWords[0] != spirvMagic)
+            return false;
+
+        //Discarding or writing depth makes the driver test depth only after the fragment shader ran
+        for(size_t i = 5; i < wordCount;)
+        {
+            uint32_t instrLength = pWords[i] >> 16;
+            uint32_t opcode = pWords[i] & 0xFFFF;
+
+            if(instrLength == 0 || i + instrLength > wordCount)
+                break;
+
+            if(opcode == opKill || opcode == opTerminateInvocation || opcode == opDemoteToHelperInvocation)
+                return true;
+
+            if(opcode == opDecorate && instrLength >= 4 && pWords[i + 2] == decorationBuiltIn && pWords[i + 3] == builtInFragDepth)
+                return true;
+
+            i += instrLength;
+        }
+
+        return false;
+    }
+
+    bool GraphicsCore::ShaderHasInvariantPosition(const std::vector<char>& code)
+    {
+        const uint32_t spirvMagic = 0x07230203;
+        const uint32_t opDecorate = 71;
+        const uint32_t opMemberDecorate = 72;
+        const uint32_t decorationBuiltIn = 11;
+        const uint32_t decorationInvariant = 18;
+        const uint32_t builtInPosition = 0;
+
+        const uint32_t* pWords = reinterpret_cast<const uint32_t*>(code.data());
+        size_t wordCount = code.size() / sizeof(uint32_t);
+
+        if(wordCount < 5 || pWords[0] != spirvMagic)
+            return false;
+
+        //Position is either a plain output variable or a member of gl_PerVertex block, both decorations name the same target.
+        //Target is kept as (id, member), member is UINT32_MAX for variables
+        std::vector<std::pair<uint32_t, uint32_t>> vecPositions;
+        std::vector<std::pair<uint32_t, uint32_t>> vecInvariants;
+
+        for(size_t i = 5; i < wordCount;)
+        {
+            uint32_t instrLength = pWords[i] >> 16;
+            uint32_t opcode = pWords[i] & 0xFFFF;
+
+            if(instrLength == 0 || i + instrLength > wordCount)
+                break;
+
+            if(opcode == opDecorate && instrLength >= 3)
+            {
+                if(pWords[i + 2] == decorationBuiltIn && instrLength >= 4 && pWords[i + 3] == builtInPosition)
+                    vecPositions.push_back({ pWords[i + 1], UINT32_MAX });
+                else if(pWords[i + 2] == decorationInvariant)
+                    vecInvariants.push_back({ pWords[i + 1], UINT32_MAX });
+            }
+
+            if(opcode == opMemberDecorate && instrLength >= 4)
+            {
+                if(pWords[i + 3] == decorationBuiltIn && instrLength >= 5 && pWords[i + 4] == builtInPosition)
+                    vecPositions.push_back({ pWords[i + 1], pWords[i + 2] });
+                else if(pWords[i + 3] == decorationInvariant)
+                    vecInvariants.push_back({ pWords[i + 1], pWords[i + 2] });
+            }
+
+            i += instrLength;
+        }
+
+        for(auto& position : vecPositions)
+        {
+            if(std::find(vecInvariants.begin(), vecInvariants.end(), position) == vecInvariants.end())
+                return false;
+        }
+
+        return !vecPositions.empty();
+    }
+
+    void GraphicsCore::PrepareInstanceGroups(VkCommandBuffer cmdBuffer)
+    {
+        vecIndirectCommands.clear();
+        vecIndirectBatches.clear();
+        vecCounterCopies.clear();
+
+        for(auto& group : vecInstanceGroups)
+        {
+            group.mPrepared = false;
+
+            if(group.vecObjects.empty())
+                continue;
+
+            Model& model = vecModels[group.mModelIndex];
+            if(!IsModelReady(model))
+                continue;
+
+            uint32_t instanceCount = group.vecObjects.size();
+
+            //Whole group gets a range of per frame instance buffer, written either here or by culling pass
+            uint32_t instanceOffset = 0;
+            InstanceData* pInstances = static_cast<InstanceData*>(mFrameInstances.Allocate(sizeof(InstanceData) * instanceCount, instanceOffset));
+            if(pInstances == nullptr)
+                continue;
+
+            group.mFirstInstance = instanceOffset / sizeof(InstanceData);
+
+            //Culled instance count is known only on GPU, so every mesh of the group has to be drawn indirectly
+            group.mCulled = mGpuCulling && std::all_of(model.vecMeshes.begin(), model.vecMeshes.end(), [](const Mesh& mesh) { return mesh.mIndexCount > 0; });
+
+            uint32_t counterOffset = 0;
+            uint32_t* pCounter = group.mCulled ? static_cast<uint32_t*>(mFrameIndirect.Allocate(sizeof(uint32_t), counterOffset)) : nullptr;
+            CullInstance* pCull = pCounter != nullptr ? mCuller.Allocate(instanceCount) : nullptr;
+
+            if(pCull != nullptr)
+            {
+                *pCounter = 0;
+
+                //Culling pass tests the sphere with the same matrix it writes out, so the sphere is moved into quantization box
+                glm::vec4 sphere = model.mBoundingSphere;
+                if(model.mQuantization.w > 0.0f)
+                    sphere = glm::vec4((glm::vec3(sphere) - glm::vec3(model.mQuantization)) / model.mQuantization.w, sphere.w / model.mQuantization.w);
+
+                for(uint32_t i = 0; i < instanceCount; i++)
+                {
+                    pCull[i].world = GetShaderWorld(group.vecObjects[i]->GetWorldMatrix(), model);
+                    pCull[i].sphere = sphere;
+                    pCull[i].outputIndex = group.mFirstInstance;
+                    pCull[i].counterIndex = counterOffset / sizeof(uint32_t);
+                }
+            }
+            else
+            {
+                group.mCulled = false;
+                instanceCount = WriteVisibleInstances(group, model, pInstances);
+            }
+
+            //Whole group is outside of the frustum
+            if(instanceCount == 0)
+                continue;
+
+            group.mInstanceCount = instanceCount;
+            group.mPrepared = true;
+
+            //Instances share a single draw, so the closest one decides level of detail for all of them
+            group.mLodPixelsPerUnit = 0.0f;
+            if(std::any_of(model.vecMeshes.begin(), model.vecMeshes.end(), [](const Mesh& mesh) { return !mesh.vecLods.empty(); }))
+            {
+                for(auto object : group.vecObjects)
+                    group.mLodPixelsPerUnit = std::max(group.mLodPixelsPerUnit, GetPixelsPerUnit(object->GetWorldMatrix(), model.mBoundingSphere));
+            }
+
+            if(!mIndirectDraw)
+                continue;
+
+            for(auto& mesh : model.vecMeshes)
+            {
+                if(mesh.mIndexCount == 0)
+                    continue;
+
+                IndirectCommand command;
+                command.mKey = ((uint64_t)group.mShaderIndex << 32) | (mesh.mGeometry.mPage << 2) | ((uint32_t)mesh.mLayout << 1) | (mesh.mIndexType == VK_INDEX_TYPE_UINT32 ? 1 : 0);
+                uint32_t lod = SelectLod(mesh, group.mLodPixelsPerUnit);
+                command.mCommand.indexCount = mesh.GetLodIndexCount(lod);
+                command.mCommand.instanceCount = group.mCulled ? 0 : instanceCount;
+                command.mCommand.firstIndex = mesh.GetLodFirstIndex(lod);
+                command.mCommand.vertexOffset = mesh.mVertexOffset;
+                command.mCommand.firstInstance = group.mFirstInstance;
+
+                if(group.mCulled)
+                    command.mCounterOffset = counterOffset;
+                else
+                    mDrawStats.mTriangles += command.mCommand.indexCount / 3 * instanceCount;
+
+                vecIndirectCommands.push_back(command);
+            }
+        }
+
+        if(!vecIndirectCommands.empty())
+            WriteIndirectCommands();
+    }
+
+    void GraphicsCore::WriteIndirectCommands()
+    {
+        //Commands sharing shader and geometry page end up next to each other and are submitted together
+        std::stable_sort(vecIndirectCommands.begin(), vecIndirectCommands.end(),
+            [](const IndirectCommand& a, const IndirectCommand& b) { return a.mKey < b.mKey; });
+
+        size_t first = 0;
+        while(first < vecIndirectCommands.size())
+        {
+            size_t last = first + 1;
+            while(last < vecIndirectCommands.size() && last - first < mMaxDrawIndirectCount && vecIndirectCommands[last].mKey == vecIndirectCommands[first].mKey)
+                last++;
+
+            IndirectBatch batch;
+            batch.mShaderIndex = vecIndirectCommands[first].mKey >> 32;
+            batch.mPage = (vecIndirectCommands[first].mKey & 0xFFFFFFFF) >> 2;
+            batch.mLayout = (VertexLayout)((vecIndirectCommands[first].mKey >> 1) & 1);
+            batch.mIndexType = (vecIndirectCommands[first].mKey & 1) ? VK_INDEX_TYPE_UINT32 : VK_INDEX_TYPE_UINT16;
+            batch.mDrawCount = last - first;
+
+            auto pCommands = static_cast<VkDrawIndexedIndirectCommand*>(mFrameIndirect.Allocate(sizeof(VkDrawIndexedIndirectCommand) * batch.mDrawCount, batch.mCommandOffset));
+            if(pCommands == nullptr)
+                return;
+
+            for(uint32_t i = 0; i < batch.mDrawCount; i++)
+            {
+                const IndirectCommand& command = vecIndirectCommands[first + i];
+                pCommands[i] = command.mCommand;
+
+                if(command.mCounterOffset.has_value())
+                {
+                    VkBufferCopy copy = {};
+                    copy.srcOffset = command.mCounterOffset.value();
+                    copy.dstOffset = batch.mCommandOffset + sizeof(VkDrawIndexedIndirectCommand) * i + offsetof(VkDrawIndexedIndirectCommand, instanceCount);
+                    copy.size = sizeof(uint32_t);
+                    vecCounterCopies.push_back(copy);
+                }
+            }
+
+            //Count buffer lets later GPU passes drop draws without CPU knowing how many are left
+            uint32_t countOffset = 0;
+            uint32_t* pCount = mDrawIndirectCount ? static_cast<uint32_t*>(mFrameIndirect.Allocate(sizeof(uint32_t), countOffset)) : nullptr;
+
+            if(pCount != nullptr)
+            {
+                *pCount = batch.mDrawCount;
+                batch.mCountOffset = countOffset;
+            }
+
+            vecIndirectBatches.push_back(batch);
+            first = last;
+        }
+    }
+
+    void GraphicsCore::DrawInstanceGroups(VkCommandBuffer cmdBuffer, std::optional<uint32_t>& cameraOffset, ShaderPass pass)
+    {
+        std::optional<uint32_t> boundPipeline; //(shader index * layout count + layout)
+        DrawStats& stats = pass == ShaderPass::DepthPrepass ? mPrepassStats : mDrawStats;
+        bool instancesBound = false;
+
+        for(auto& group : vecInstanceGroups)
+        {
+            if(!group.mPrepared)
+                continue;
+
+            Model& model = vecModels[group.mModelIndex];
+            Shader& shader = vecShaders[group.mShaderIndex];
+
+            if(!cameraOffset.has_value())
+            {
+                uint32_t offset = 0;
+                if(!WriteCameraConstants(offset))
+                    return;
+                cameraOffset = offset;
+            }
+
+            //Instance buffer is bound once at its start, groups select their range with firstInstance
+            if(!instancesBound)
+            {
+                VkBuffer instanceBuffers[] = { mFrameInstances.GetBuffer(mCurrentFrame) };
+                VkDeviceSize instanceOffsets[] = { 0 };
+                vkCmdBindVertexBuffers(cmdBuffer, 1, 1, instanceBuffers, instanceOffsets);
+                stats.mVertexBufferBinds++;
+                instancesBound = true;
+            }
+
+            for(auto& mesh : model.vecMeshes)
+            {
+                //Drawn later together with the rest of its indirect batch
+                if(mIndirectDraw && mesh.mIndexCount > 0)
+                    continue;
+
+                if(pass == ShaderPass::DepthPrepass && !shader.mPrepassVariants)
+                    continue;
+
+                if(GetPipeline(shader, mesh.mLayout, pass) == VK_NULL_HANDLE)
+                {
+                    stats.mNotReadySkipped++;
+                    continue;
+                }
+
+                uint32_t pipeline = group.mShaderIndex * (uint32_t)VertexLayout::Count + (uint32_t)mesh.mLayout;
+                if(!boundPipeline.has_value() || boundPipeline.value() != pipeline)
+                {
+                    vkCmdBindPipeline(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, GetPipeline(shader, mesh.mLayout, pass));
+                    vkCmdBindDescriptorSets(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, shader.mPipelineLayout, 0, 1, &shader.vecDescSets[mCurrentFrame], 1, &cameraOffset.value());
+                    boundPipeline = pipeline;
+                    stats.mPipelineBinds++;
+                    stats.mDescriptorBinds++;
+                }
+
+                VkBuffer vertexBuffers[] = { mGeometry.GetVertexBuffer(mesh.mGeometry.mPage) };
+                VkDeviceSize offset[] = { 0 };
+                vkCmdBindVertexBuffers(cmdBuffer, 0, 1, vertexBuffers, offset);
+                stats.mVertexBufferBinds++;
+
+                if (mesh.mIndexCount > 0)
+                {
+                    vkCmdBindIndexBuffer(cmdBuffer, mGeometry.GetIndexBuffer(mesh.mGeometry.mPage), 0, mesh.mIndexType);
+                    uint32_t lod = SelectLod(mesh, group.mLodPixelsPerUnit);
+                    vkCmdDrawIndexed(cmdBuffer, mesh.GetLodIndexCount(lod), group.mInstanceCount, mesh.GetLodFirstIndex(lod), mesh.mVertexOffset, group.mFirstInstance);
+                    stats.mIndexBufferBinds++;
+                    stats.mTriangles += mesh.GetLodIndexCount(lod) / 3 * group.mInstanceCount;
+                }
+                else
+                    vkCmdDraw(cmdBuffer, mesh.mVertexCount, group.mInstanceCount, mesh.mVertexOffset, group.mFirstInstance);
+
+                stats.mDrawCalls++;
+            }
+        }
+
+        VkBuffer indirectBuffer = vecIndirectBatches.empty() ? VK_NULL_HANDLE : mFrameIndirect.GetBuffer(mCurrentFrame);
+
+        for(auto& batch : vecIndirectBatches)
+        {
+            Shader& shader = vecShaders[batch.mShaderIndex];
+
+            if(pass == ShaderPass::DepthPrepass && !shader.mPrepassVariants)
+                continue;
+
+            if(GetPipeline(shader, batch.mLayout, pass) == VK_NULL_HANDLE)
+            {
+                stats.mNotReadySkipped++;
+                continue;
+            }
+
+            uint32_t pipeline = batch.mShaderIndex * (uint32_t)VertexLayout::Count + (uint32_t)batch.mLayout;
+            if(!boundPipeline.has_value() || boundPipeline.value() != pipeline)
+            {
+                vkCmdBindPipeline(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, GetPipeline(shader, batch.mLayout, pass));
+                vkCmdBindDescriptorSets(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, shader.mPipelineLayout, 0, 1, &shader.vecDescSets[mCurrentFrame], 1, &cameraOffset.value());
+                boundPipeline = pipeline;
+                stats.mPipelineBinds++;
+                stats.mDescriptorBinds++;
+            }
+
+            VkBuffer vertexBuffers[] = { mGeometry.GetVertexBuffer(batch.mPage) };
+            VkDeviceSize offset[] = { 0 };
+            vkCmdBindVertexBuffers(cmdBuffer, 0, 1, vertexBuffers, offset);
+            vkCmdBindIndexBuffer(cmdBuffer, mGeometry.GetIndexBuffer(batch.mPage), 0, batch.mIndexType);
+            stats.mVertexBufferBinds++;
+            stats.mIndexBufferBinds++;
+
+            if(batch.mCountOffset.has_value())
+                vkCmdDrawIndexedIndirectCount(cmdBuffer, indirectBuffer, batch.mCommandOffset, indirectBuffer, batch.mCountOffset.value(), batch.mDrawCount, sizeof(VkDrawIndexedIndirectCommand));
+            else
+                vkCmdDrawIndexedIndirect(cmdBuffer, indirectBuffer, batch.mCommandOffset, batch.mDrawCount, sizeof(VkDrawIndexedIndirectCommand));
+
+            stats.mDrawCalls++;
+            stats.mIndirectCommands += batch.mDrawCount;
+        }
+    }
+
+    uint32_t GraphicsCore::WriteVisibleInstances(InstanceGroup& group, const Model& model, InstanceData* pInstances)
+    {
+        if(!mCpuCulling)
+        {
+            for(size_t i = 0; i < group.vecObjects.size(); i++)
+                pInstances[i].world = GetShaderWorld(group.vecObjects[i]->GetWorldMatrix(), model);
+
+            return group.vecObjects.size();
+        }
+
+        mCullSpheres.Clear();
+        for(auto object : group.vecObjects)
+            mCullSpheres.Add(object->GetWorldMatrix(), model.mBoundingSphere);
+
+        vecVisible.resize(group.vecObjects.size());
+        mFrustum.CullSpheres(mCullSpheres, vecVisible.data());
+
+        //Survivors are packed to the start of group range so they can be drawn with single instance count
+        uint32_t written = 0, occluded = 0;
+        for(size_t i = 0; i < group.vecObjects.size(); i++)
+        {
+            if(!vecVisible[i])
+                continue;
+
+            if(mOcclusionReady && group.vecObjects[i]->mOccluded)
+            {
+                occluded++;
+                continue;
+            }
 
-        VkResult res = vkCreateDescriptorPool(mDevice, &poolInfo, nullptr, &shader.mDescPool);
-        VK_THROW_IF_FAILED(res);
+            pInstances[written++].world = GetShaderWorld(group.vecObjects[i]->GetWorldMatrix(), model);
+        }
+
+        mDrawStats.mCulledObjects += group.vecObjects.size() - written - occluded;
+        mDrawStats.mOccludedObjects += occluded;
+        return written;
     }
 
-    void GraphicsCore::CreateDescriptorSets(Model& m, Shader& shader)
+    void GraphicsCore::CalculateBounds(Mesh& m, const std::vector<Vertex>& verts)
     {
-        std::vector<VkDescriptorSetLayout> layouts(MAX_FRAMES_IN_FLIGHT, shader.mDescLayout);
-        VkDescriptorSetAllocateInfo allocInfo = {};
-        allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
-        allocInfo.descriptorPool = shader.mDescPool;
-        allocInfo.descriptorSetCount = static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT);
-        allocInfo.pSetLayouts = layouts.data();
+        if(verts.empty())
+            return;
 
-        for (auto& mesh : m.vecMeshes)
+        m.mBoundsMin = verts[0].pos;
+        m.mBoundsMax = verts[0].pos;
+
+        for(auto& vertex : verts)
         {
-            mesh.vecDescSets.resize(MAX_FRAMES_IN_FLIGHT);
-            VkResult res = vkAllocateDescriptorSets(mDevice, &allocInfo, mesh.vecDescSets.data());
-            VK_THROW_IF_FAILED(res);
+            m.mBoundsMin = glm::min(m.mBoundsMin, vertex.pos);
+            m.mBoundsMax = glm::max(m.mBoundsMax, vertex.pos);
         }
-        
 
-        for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
-            VkDescriptorBufferInfo bufferInfo = {};
-            bufferInfo.buffer = m.vecUniformBuffers[i];
-            bufferInfo.offset = 0;
-            bufferInfo.range = sizeof(MVP);
+        glm::vec3 center = (m.mBoundsMin + m.mBoundsMax) * 0.5f;
+        float radius = 0.0f;
+
+        //Radius measured from box center to furthest vertex is tighter than half of box diagonal
+        for(auto& vertex : verts)
+            radius = std::max(radius, glm::length(vertex.pos - center));
+
+        m.mBoundingSphere = glm::vec4(center, radius);
+    }
+
+    void GraphicsCore::CalculateBounds(Model& m)
+    {
+        if(m.vecMeshes.empty())
+            return;
+
+        glm::vec3 boundsMin = m.vecMeshes[0].mBoundsMin;
+        glm::vec3 boundsMax = m.vecMeshes[0].mBoundsMax;
+
+        for(auto& mesh : m.vecMeshes)
+        {
+            boundsMin = glm::min(boundsMin, mesh.mBoundsMin);
+            boundsMax = glm::max(boundsMax, mesh.mBoundsMax);
+        }
+
+        m.mBoundsMin = boundsMin;
+        m.mBoundsMax = boundsMax;
+
+        //Every mesh sphere has to fit inside, so radius reaches the far side of the furthest one
+        glm::vec3 center = (boundsMin + boundsMax) * 0.5f;
+        float radius = 0.0f;
+
+        for(auto& mesh : m.vecMeshes)
+            radius = std::max(radius, glm::length(glm::vec3(mesh.mBoundingSphere) - center) + mesh.mBoundingSphere.w);
+
+        m.mBoundingSphere = glm::vec4(center, radius);
+    }
+
+    void GraphicsCore::BuildDrawList()
+    {
+        mDrawList.Clear();
+        mCullSpheres.Clear();
+        vecCullCandidates.clear();
+
+        //Tree rejects whole subtrees outside of the frustum, spheres of the rest are still tested below
+        std::vector<GameObject3D*>* pObjects = &vecObjects;
+        if(mSpatialCulling)
+        {
+            vecSpatialResults.clear();
+            mSpatialTree.QueryFrustum(mFrustum, vecSpatialResults);
+            pObjects = &vecSpatialResults;
+        }
+
+        for(auto object : *pObjects)
+        {
+            if(!object->mDrawable)
+                continue;
+
+            Model& model = vecModels[object->mModelIndex];
+            Shader& shader = vecShaders[object->mShaderIndex];
+
+            //Objects with instanced shaders are drawn by their instance group
+            if(shader.mUsesInstancing || !IsModelReady(model))
+                continue;
+
+            vecCullCandidates.push_back(object);
+
+            if(mCpuCulling)
+                mCullSpheres.Add(object->GetWorldMatrix(), model.mBoundingSphere);
+        }
+
+        //Whole frame is culled in one go so the kernel can test 8 spheres per iteration
+        vecVisible.resize(vecCullCandidates.size());
+
+        if(mCpuCulling)
+            mDrawStats.mCulledObjects += vecCullCandidates.size() - mFrustum.CullSpheres(mCullSpheres, vecVisible.data());
+        else
+            std::fill(vecVisible.begin(), vecVisible.end(), 1);
+
+        for(size_t c = 0; c < vecCullCandidates.size(); c++)
+        {
+            if(!vecVisible[c])
+                continue;
+
+            GameObject3D* object = vecCullCandidates[c];
+            if(mOcclusionReady && object->mOccluded)
+            {
+                mDrawStats.mOccludedObjects++;
+                continue;
+            }
 
-            for (auto& mesh : m.vecMeshes)
+            Model& model = vecModels[object->mModelIndex];
+
+            //Distance along view direction, so packets sharing state are drawn front to back
+            glm::vec4 viewPos = view * object->GetWorldMatrix()[3];
+            float depth = -viewPos.z;
+            float pixelsPerUnit = GetPixelsPerUnit(object->GetWorldMatrix(), model.mBoundingSphere);
+
+            for(uint32_t i = 0; i < model.vecMeshes.size(); i++)
             {
-                VkWriteDescriptorSet descriptorWrite{};
-                descriptorWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-                descriptorWrite.dstSet = mesh.vecDescSets[i];
-                descriptorWrite.dstBinding = 0;
-                descriptorWrite.dstArrayElement = 0;
-                descriptorWrite.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-                descriptorWrite.descriptorCount = 1;
-                descriptorWrite.pBufferInfo = &bufferInfo;
-                descriptorWrite.pImageInfo = nullptr;
-                descriptorWrite.pTexelBufferView = nullptr;
-
-                vkUpdateDescriptorSets(mDevice, 1, &descriptorWrite, 0, nullptr);
+                const Mesh& mesh = model.vecMeshes[i];
+                uint32_t geometry = (mesh.mGeometry.mPage << 1) | (mesh.mIndexType == VK_INDEX_TYPE_UINT32 ? 1 : 0);
+
+                //Pipeline is picked by shader and vertex layout, descriptor sets belong to shader alone
+                uint32_t pipeline = object->mShaderIndex * (uint32_t)VertexLayout::Count + (uint32_t)mesh.mLayout;
+                DrawPacket packet;
+                packet.mSortKey = DrawList::MakeSortKey(pipeline, object->mShaderIndex, geometry, depth);
+                packet.pObject = object;
+                packet.mModelIndex = object->mModelIndex;
+                packet.mMeshIndex = i;
+                packet.mLod = SelectLod(mesh, pixelsPerUnit);
+                mDrawList.Add(packet);
             }
         }
 
+        mDrawList.Sort();
+        mDrawStats.mPackets = mDrawList.GetSize();
     }
 
-    void GraphicsCore::CreateDescriptorSets(GameObject3D* pGo)
+    float GraphicsCore::GetPixelsPerUnit(const glm::mat4& world, const glm::vec4& localSphere) const
     {
-        for(auto& model : vecModels)
+        glm::vec3 axisX = glm::vec3(world[0]), axisY = glm::vec3(world[1]), axisZ = glm::vec3(world[2]);
+        float scale = std::sqrt(std::max({ glm::dot(axisX, axisX), glm::dot(axisY, axisY), glm::dot(axisZ, axisZ) }));
+
+        //Distance to the closest point of bounding sphere, camera inside of it always gets full detail
+        glm::vec4 viewCenter = view * world * glm::vec4(glm::vec3(localSphere), 1.0f);
+        float depth = -viewCenter.z - localSphere.w * scale;
+        if(depth <= 0.0f)
+            return INFINITY;
+
+        //Model space unit -> world space -> pixels at that depth, projection scale is cot(fov / 2)
+        return scale * std::fabs(proj[1][1]) * 0.5f * mSwapExtent.height / depth;
+    }
+
+    uint32_t GraphicsCore::SelectLod(const Mesh& mesh, float pixelsPerUnit) const
+    {
+        //Coarsest level whose error still stays under configured number of pixels
+        uint32_t lod = 0;
+        while(lod < mesh.vecLods.size() && mesh.vecLods[lod].mError * pixelsPerUnit <= mLodErrorPixels)
+            lod++;
+
+        return lod;
+    }
+
+    bool GraphicsCore::PrepareDrawChunk(DrawChunk& chunk)
+    {
+        const std::vector<DrawPacket>& packets = mDrawList.GetPackets();
+        GameObject3D* pLastObject = nullptr;
+
+        chunk.mObjectCount = 0;
+        chunk.pObjectConstants = nullptr;
+        chunk.mBindlessCount = 0;
+        chunk.pBindlessObjects = nullptr;
+        chunk.mStats = DrawStats();
+        chunk.mPrepassStats = DrawStats();
+
+        //Same rule as recording uses - consecutive packets of one object share its constants
+        for(size_t i = chunk.mFirst; i < chunk.mFirst + chunk.mCount; i++)
+        {
+            GameObject3D* object = packets[i].pObject;
+            const Shader& shader = vecShaders[object->mShaderIndex];
+
+            if(object != pLastObject && shader.mBindless)
+                chunk.mBindlessCount++;
+            else if(object != pLastObject && !shader.mUsesPushConstants)
+                chunk.mObjectCount++;
+
+            pLastObject = object;
+        }
+
+        if(chunk.mBindlessCount > 0)
+        {
+            uint32_t offset = 0;
+            chunk.pBindlessObjects = static_cast<BindlessObject*>(mBindlessObjects.Allocate(sizeof(BindlessObject) * chunk.mBindlessCount, offset));
+            if(chunk.pBindlessObjects == nullptr)
+                return false;
+
+            //Camera is in front of the array and every allocation is whole number of objects
+            chunk.mBindlessFirst = (offset - sizeof(CameraConstants)) / sizeof(BindlessObject);
+        }
+
+        if(chunk.mObjectCount == 0)
+            return true;
+
+        //Frame uniform buffer is not thread safe, so the whole chunk gets its range before recording starts
+        VkDeviceSize stride = mFrameUniforms.GetAlignedSize(sizeof(MVP));
+        chunk.pObjectConstants = static_cast<uint8_t*>(mFrameUniforms.Allocate(stride * chunk.mObjectCount, chunk.mObjectOffset));
+        return chunk.pObjectConstants != nullptr;
+    }
+
+    void GraphicsCore::RecordDrawList(VkCommandBuffer cmdBuffer, DrawChunk& chunk, std::optional<uint32_t> cameraOffset, ShaderPass pass)
+    {
+        std::optional<uint32_t> boundPipeline;
+        std::optional<uint32_t> boundSetShader;
+        std::optional<uint32_t> boundSetOffset;
+        std::optional<uint32_t> boundVertexPage;
+        std::optional<uint32_t> boundIndexPage;
+        VkIndexType boundIndexType = VK_INDEX_TYPE_UINT16;
+        GameObject3D* pLastObject = nullptr;
+        GameObject3D* pSlotObject = nullptr;
+        uint32_t objectOffset = 0;
+        uint32_t objectIndex = 0;
+        uint32_t objectStride = mFrameUniforms.GetAlignedSize(sizeof(MVP));
+        uint32_t bindlessIndex = 0;
+        uint32_t bindlessObject = 0;
+        const uint32_t bindlessSetKey = UINT32_MAX; //Stands in for shader index, every bindless shader shares the set
+        DrawStats& stats = pass == ShaderPass::DepthPrepass ? chunk.mPrepassStats : chunk.mStats;
+
+        for(size_t p = chunk.mFirst; p < chunk.mFirst + chunk.mCount; p++)
         {
-            if(model.mId == pGo->mAssocMdl)
+            const DrawPacket& packet = mDrawList.GetPackets()[p];
+            GameObject3D* object = packet.pObject;
+            Shader& shader = vecShaders[object->mShaderIndex];
+            const Mesh& mesh = vecModels[packet.mModelIndex].vecMeshes[packet.mMeshIndex];
+            uint32_t dynamicOffset = 0;
+            VkPipeline pipelineHandle = GetPipeline(shader, mesh.mLayout, pass);
+
+            //Slots are handed out for every packet like PrepareDrawChunk counted them, whatever gets skipped below.
+            //Pre-pass and shading pass write the same slots then, so each object reads its own constants in both
+            if(shader.mBindless)
             {
-                for(auto& shader : vecShaders)
+                //Object data is addressed by index, so nothing is rebound between objects
+                if(object != pSlotObject)
                 {
-                    if(shader.mId == pGo->mAssocShader)
-                    {
-                        std::vector<VkDescriptorSetLayout> layouts(MAX_FRAMES_IN_FLIGHT, shader.mDescLayout);
-                        VkDescriptorSetAllocateInfo allocInfo = {};
-                        allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
-                        allocInfo.descriptorPool = shader.mDescPool;
-                        allocInfo.descriptorSetCount = static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT);
-                        allocInfo.pSetLayouts = layouts.data();
-
-                        for (auto& mesh : model.vecMeshes)
-                        {
-                            mesh.vecDescSets.resize(MAX_FRAMES_IN_FLIGHT);
-                            VkResult res = vkAllocateDescriptorSets(mDevice, &allocInfo, mesh.vecDescSets.data());
-                            VK_THROW_IF_FAILED(res);
-                            LOG_F(INFO, "Descriptor set allocated!");
-                        }
-                        
-
-                        for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
-                            VkDescriptorBufferInfo bufferInfo = {};
-                            bufferInfo.buffer = model.vecUniformBuffers[i];
-                            bufferInfo.offset = 0;
-                            bufferInfo.range = sizeof(MVP);
-
-                            for (auto& mesh : model.vecMeshes)
-                            {
-                                VkWriteDescriptorSet descriptorWrite{};
-                                descriptorWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-                                descriptorWrite.dstSet = mesh.vecDescSets[i];
-                                descriptorWrite.dstBinding = 0;
-                                descriptorWrite.dstArrayElement = 0;
-                                descriptorWrite.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-                                descriptorWrite.descriptorCount = 1;
-                                descriptorWrite.pBufferInfo = &bufferInfo;
-                                descriptorWrite.pImageInfo = nullptr;
-                                descriptorWrite.pTexelBufferView = nullptr;
-
-                                vkUpdateDescriptorSets(mDevice, 1, &descriptorWrite, 0, nullptr);
-                            }
-                        }
-                    }
+                    BindlessObject& data = chunk.pBindlessObjects[bindlessIndex];
+                    data.model = GetShaderWorld(object->GetWorldMatrix(), vecModels[packet.mModelIndex]);
+                    data.payload = object->GetDrawPayload();
+                    bindlessObject = chunk.mBindlessFirst + bindlessIndex;
+                    bindlessIndex++;
+                }
+            }
+            else if(!shader.mUsesPushConstants)
+            {
+                //Every object gets its own slice of chunk range, meshes of the same object share it
+                if(object != pSlotObject)
+                {
+                    WriteObjectConstants(object, reinterpret_cast<MVP*>(chunk.pObjectConstants + objectStride * objectIndex));
+                    objectOffset = chunk.mObjectOffset + objectStride * objectIndex;
+                    objectIndex++;
+                }
+
+                dynamicOffset = objectOffset;
+            }
+
+            pSlotObject = object;
+
+            //Shading pass draws it against depth of the objects that were in pre-pass
+            if(pass == ShaderPass::DepthPrepass && !shader.mPrepassVariants)
+                continue;
+
+            //Pipeline is still compiling in background, object shows up once it is collected
+            if(pipelineHandle == VK_NULL_HANDLE)
+            {
+                stats.mNotReadySkipped++;
+                continue;
+            }
+
+            if(shader.mUsesPushConstants)
+            {
+                //Camera data is written once per frame and shared by every push constant shader
+                if(!cameraOffset.has_value())
+                    continue;
+
+                dynamicOffset = cameraOffset.value();
+            }
+
+            //Every shader has a pipeline per vertex layout, they share pipeline layout and descriptor sets
+            uint32_t pipeline = object->mShaderIndex * (uint32_t)VertexLayout::Count + (uint32_t)mesh.mLayout;
+            if(!boundPipeline.has_value() || boundPipeline.value() != pipeline)
+            {
+                vkCmdBindPipeline(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineHandle);
+                boundPipeline = pipeline;
+                stats.mPipelineBinds++;
+            }
+            else
+                stats.mPipelineBindsElided++;
+
+            uint32_t setKey = shader.mBindless ? bindlessSetKey : object->mShaderIndex;
+            if(!boundSetShader.has_value() || boundSetShader.value() != setKey || boundSetOffset.value() != dynamicOffset)
+            {
+                if(shader.mBindless)
+                    vkCmdBindDescriptorSets(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, mBindlessPipelineLayout, 0, 1, &mBindlessSet, 0, nullptr);
+                else
+                    vkCmdBindDescriptorSets(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, shader.mPipelineLayout, 0, 1, &shader.vecDescSets[mCurrentFrame], 1, &dynamicOffset);
+
+                boundSetShader = setKey;
+                boundSetOffset = dynamicOffset;
+                stats.mDescriptorBinds++;
+            }
+            else
+                stats.mDescriptorBindsElided++;
+
+            if(shader.mBindless && object != pLastObject)
+            {
+                BindlessPushConstants constants;
+                constants.mFrame = mCurrentFrame;
+                constants.mObject = bindlessObject;
+                vkCmdPushConstants(cmdBuffer, mBindlessPipelineLayout, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(constants), &constants);
+            }
+
+            if(shader.mUsesPushConstants && object != pLastObject)
+            {
+                ObjectPushConstants constants = {};
+                constants.model = GetShaderWorld(object->GetWorldMatrix(), vecModels[packet.mModelIndex]);
+                constants.payload = object->GetDrawPayload();
+                vkCmdPushConstants(cmdBuffer, shader.mPipelineLayout, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(constants), &constants);
+            }
+
+            pLastObject = object;
+
+            //Geometry lives in shared arena pages, buffers only change when mesh is in a different page
+            if(!boundVertexPage.has_value() || boundVertexPage.value() != mesh.mGeometry.mPage)
+            {
+                VkBuffer vertexBuffers[] = { mGeometry.GetVertexBuffer(mesh.mGeometry.mPage) };
+                VkDeviceSize offset[] = { 0 };
+                vkCmdBindVertexBuffers(cmdBuffer, 0, 1, vertexBuffers, offset);
+                boundVertexPage = mesh.mGeometry.mPage;
+                stats.mVertexBufferBinds++;
+            }
+            else
+                stats.mVertexBufferBindsElided++;
+
+            if(mesh.mIndexCount > 0)
+            {
+                //firstIndex is counted in elements of bound index type, so index width change needs rebind too
+                if(!boundIndexPage.has_value() || boundIndexPage.value() != mesh.mGeometry.mPage || boundIndexType != mesh.mIndexType)
+                {
+                    vkCmdBindIndexBuffer(cmdBuffer, mGeometry.GetIndexBuffer(mesh.mGeometry.mPage), 0, mesh.mIndexType);
+                    boundIndexPage = mesh.mGeometry.mPage;
+                    boundIndexType = mesh.mIndexType;
+                    stats.mIndexBufferBinds++;
                 }
+                else
+                    stats.mIndexBufferBindsElided++;
+
+                uint32_t indexCount = mesh.GetLodIndexCount(packet.mLod);
+                vkCmdDrawIndexed(cmdBuffer, indexCount, 1, mesh.GetLodFirstIndex(packet.mLod), mesh.mVertexOffset, 0);
+                stats.mTriangles += indexCount / 3;
             }
+            else
+                vkCmdDraw(cmdBuffer, mesh.mVertexCount, 1, mesh.mVertexOffset, 0);
+
+            stats.mDrawCalls++;
         }
     }
 
     void GraphicsCore::DrawFrame(NgineWindow* pWin)
     {
-        uint32_t bindCount = 0;
+        std::optional<uint32_t> cameraOffset;
 
+        RecordFrameTime();
         vkWaitForFences(mDevice, 1, &vecFlightFences[mCurrentFrame], VK_TRUE, UINT64_MAX);
 
+        //Query written by this frame in flight is finished together with its fence
+        ReadStatisticsQueries();
+
+        //Secondary buffers of this frame are done as well, their pools can be recycled as a whole
+        for(uint32_t i = 0; i < mRecordContextCount; i++)
+            vkResetCommandPool(mDevice, vecRecordContexts[mCurrentFrame * mRecordContextCount + i].mPool, 0);
+
+        //Shaders whose pipelines finished compiling are drawn starting with this frame
+        CollectPipelines();
+
+        //Submit uploads requested since last frame and check which of them are already finished
+        mUploader.Update();
+        mFrameUniforms.BeginFrame(mCurrentFrame);
+        mFrameInstances.BeginFrame(mCurrentFrame);
+        mFrameIndirect.BeginFrame(mCurrentFrame);
+        mRenderGraph.BeginFrame(mCurrentFrame);
+
+        for(auto it = vecRetiredFrameBuffers.begin(); it != vecRetiredFrameBuffers.end();)
+        {
+            if(it->first == mCurrentFrame)
+            {
+                vkDestroyFramebuffer(mDevice, it->second, nullptr);
+                it = vecRetiredFrameBuffers.erase(it);
+            }
+            else
+                it++;
+        }
+
+        if(mBindless)
+            mBindlessObjects.BeginFrame(mCurrentFrame);
+
+        if(mGpuCulling)
+            mCuller.BeginFrame(mCurrentFrame);
+
+        mFrustum = Frustum::FromMatrix(proj * view);
+
         uint32_t imgIndex;
         VkResult res = vkAcquireNextImageKHR(mDevice, mSwapchain, UINT64_MAX, vecImgAvSemaphores[mCurrentFrame], VK_NULL_HANDLE, &imgIndex);
         if (res == VK_ERROR_OUT_OF_DATE_KHR || res == VK_SUBOPTIMAL_KHR || mFramebufferResized) {
@@ -1160,75 +2885,157 @@ namespace Ngine
         vkResetCommandBuffer(vecCmdBuffers[mCurrentFrame], 0);
         RecordCommandBuffer(vecCmdBuffers[mCurrentFrame], imgIndex);
 
-        VkClearValue clearColor = { 0.0f, 0.4f, 0.6f, 1.0f };
+        //Take ownership of buffers finished by transfer queue before anything reads them
+        mUploader.RecordAcquireBarriers(vecCmdBuffers[mCurrentFrame]);
+
+        auto recordStart = std::chrono::high_resolution_clock::now();
+        mDrawStats = DrawStats();
+        mPrepassStats = DrawStats();
+
+        PrepareInstanceGroups(vecCmdBuffers[mCurrentFrame]);
+
+        VkClearValue clearValues[2] = {};
+        clearValues[0].color = { 0.0f, 0.4f, 0.6f, 1.0f };
+        clearValues[1].depthStencil = { 1.0f, 0 };
+
+        //After pre-pass depth is already final, shading pass only loads it
+        ShaderPass shadePass = mDepthPrepass ? ShaderPass::AfterPrepass : ShaderPass::Main;
 
         VkRenderPassBeginInfo rpInfo = {};
         rpInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
-        rpInfo.renderPass = mRenderPass;
-        rpInfo.framebuffer = vecFrameBuffers.at(imgIndex);
+        rpInfo.renderPass = mDepthPrepass ? mAfterPrepassRenderPass : mRenderPass;
         rpInfo.renderArea.offset = { 0,0 };
         rpInfo.renderArea.extent = mSwapExtent;
-        rpInfo.clearValueCount = 1;
-        rpInfo.pClearValues = &clearColor;
+        rpInfo.clearValueCount = 2;
+        rpInfo.pClearValues = clearValues;
 
-        vkCmdBeginRenderPass(vecCmdBuffers[mCurrentFrame], &rpInfo, VK_SUBPASS_CONTENTS_INLINE);
+        VkRenderPassBeginInfo prepassInfo = rpInfo;
+        prepassInfo.renderPass = mPrepassRenderPass;
+        prepassInfo.clearValueCount = 1;
+        prepassInfo.pClearValues = &clearValues[1];
 
-        VkViewport viewport = {};
-        viewport.x = 0.0f;
-        viewport.y = 0.0f;
-        viewport.width = (float)mSwapExtent.width;
-        viewport.height = (float)mSwapExtent.height;
-        viewport.minDepth = 0.0f;
-        viewport.maxDepth = 1.0f;
-        vkCmdSetViewport(vecCmdBuffers[mCurrentFrame], 0, 1, &viewport);
+        //Camera data is shared by every push constant and instanced draw, workers only read its offset
+        uint32_t offset = 0;
+        if(WriteCameraConstants(offset))
+            cameraOffset = offset;
 
-        VkRect2D scissor = {};
-        scissor.offset = { 0,0 };
-        scissor.extent = mSwapExtent;
-        vkCmdSetScissor(vecCmdBuffers[mCurrentFrame], 0, 1, &scissor);
+        //Bindless frame buffer starts with camera, objects recorded this frame follow it
+        if(mBindless)
+        {
+            uint32_t bindlessCamera = 0;
+            CameraConstants* pCamera = static_cast<CameraConstants*>(mBindlessObjects.Allocate(sizeof(CameraConstants), bindlessCamera));
+            if(pCamera != nullptr)
+            {
+                pCamera->view = view;
+                pCamera->projection = proj;
+            }
+        }
 
-        int shd_index = 0;
+        BuildDrawList();
+        PrepareDrawChunks();
+
+        //Passes declare what they touch, graph records barriers and layout transitions between them
+        mRenderGraph.Reset();
+        RenderGraphHandle backbuffer = mRenderGraph.ImportImage("Backbuffer", vecSwapImages[imgIndex], vecSwapImageViews[imgIndex], VK_IMAGE_ASPECT_COLOR_BIT, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT);
+        mRenderGraph.MarkOutput(backbuffer, VK_IMAGE_LAYOUT_PRESENT_SRC_KHR);
+
+        //Depth is cleared every frame and never read after shading, so it lives in transient memory of the graph
+        RenderGraphImageDesc depthDesc;
+        depthDesc.mFormat = mDepthFormat;
+        depthDesc.mExtent = mSwapExtent;
+        depthDesc.mUsage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT;
+        depthDesc.mAspect = mDepthAspect;
+        RenderGraphHandle depth = mRenderGraph.CreateImage("Depth", depthDesc);
+
+        bool culling = mGpuCulling && mCuller.GetInstanceCount() > 0;
+        RenderGraphHandle instances = 0;
+        RenderGraphHandle indirect = 0;
+        if(culling)
+        {
+            instances = mRenderGraph.ImportBuffer("Instances", mFrameInstances.GetBuffer(mCurrentFrame));
+            indirect = mRenderGraph.ImportBuffer("Indirect", mFrameIndirect.GetBuffer(mCurrentFrame));
 
-        for(auto object : vecObjects)
+            uint32_t cullPass = mRenderGraph.AddPass("Cull", [this](VkCommandBuffer cmdBuffer) { mCuller.RecordDispatch(cmdBuffer, mFrustum); });
+            mRenderGraph.Write(cullPass, instances, RenderGraphUsage::ComputeWrite);
+            mRenderGraph.Write(cullPass, indirect, RenderGraphUsage::ComputeWrite);
+
+            if(!vecCounterCopies.empty())
+            {
+                uint32_t copyPass = mRenderGraph.AddPass("CounterCopy", [this](VkCommandBuffer cmdBuffer) { mCuller.RecordCounterCopies(cmdBuffer, vecCounterCopies); });
+                mRenderGraph.Read(copyPass, indirect, RenderGraphUsage::TransferSrc);
+                mRenderGraph.Write(copyPass, indirect, RenderGraphUsage::TransferDst);
+            }
+        }
+
+        if(mDepthPrepass)
         {
-            for(int i = 0; i < vecShaders.size(); i++)
+            uint32_t prepass = mRenderGraph.AddPass("DepthPrepass", [&](VkCommandBuffer cmdBuffer) { RecordScenePass(cmdBuffer, prepassInfo, cameraOffset, ShaderPass::DepthPrepass); });
+            mRenderGraph.Write(prepass, depth, RenderGraphUsage::DepthAttachment);
+
+            if(culling)
             {
-                if(vecShaders[i].mId == object->mAssocShader)
-                    shd_index = i;
+                mRenderGraph.Read(prepass, instances, RenderGraphUsage::VertexRead);
+                mRenderGraph.Read(prepass, indirect, RenderGraphUsage::IndirectRead);
             }
+        }
 
-            if(object->mAssocMdl != 0 && object->mAssocShader != 0)
+        uint32_t mainPass = mRenderGraph.AddPass("Main", [&](VkCommandBuffer cmdBuffer)
+        {
+            //Queries cannot be reset inside a render pass, the one of this frame in flight is reused
+            if(mStatisticsPool != VK_NULL_HANDLE)
             {
-                UpdateMvpBuffer(mCurrentFrame, object);
-                for(auto& model : vecModels)
-                {
-                    if(model.mId == object->mAssocMdl)
-                    {
-                        for(auto& mesh : model.vecMeshes)
-                        {
-                            VkBuffer vertexBuffers[] = { mesh.mVertexBuffer };
-                            VkDeviceSize offset[] = { 0 };
-                            vkCmdBindPipeline(vecCmdBuffers[mCurrentFrame], VK_PIPELINE_BIND_POINT_GRAPHICS, vecShaders[shd_index].mPipeline);
-                            vkCmdBindVertexBuffers(vecCmdBuffers[mCurrentFrame], bindCount, 1, vertexBuffers, offset);
-                            if (mesh.mIndexBuffer != VK_NULL_HANDLE)
-                            {
-                                vkCmdBindIndexBuffer(vecCmdBuffers[mCurrentFrame], mesh.mIndexBuffer, 0, VK_INDEX_TYPE_UINT16);
-                                vkCmdBindDescriptorSets(vecCmdBuffers[mCurrentFrame], VK_PIPELINE_BIND_POINT_GRAPHICS, vecShaders[shd_index].mPipelineLayout, 0, 1, &mesh.vecDescSets[mCurrentFrame], 0, nullptr);
-                                vkCmdDrawIndexed(vecCmdBuffers[mCurrentFrame], mesh.mIndexCount, 1, 0, 0, 0);
-                                    
-                            }
-                            else
-                            {
-                                vkCmdDraw(vecCmdBuffers[mCurrentFrame], mesh.mVertexCount, 1, 0, 0);
-                            }
-                            bindCount++;
-                        }
-                    }
-                }
+                vkCmdResetQueryPool(cmdBuffer, mStatisticsPool, mCurrentFrame, 1);
+                vkCmdBeginQuery(cmdBuffer, mStatisticsPool, mCurrentFrame, 0);
             }
+
+            RecordScenePass(cmdBuffer, rpInfo, cameraOffset, shadePass);
+
+            if(mStatisticsPool != VK_NULL_HANDLE)
+            {
+                vkCmdEndQuery(cmdBuffer, mStatisticsPool, mCurrentFrame);
+                vecStatisticsEpochs[mCurrentFrame] = mStatisticsEpoch;
+            }
+        });
+        mRenderGraph.Write(mainPass, backbuffer, RenderGraphUsage::ColorAttachment);
+
+        //Pre-pass depth is loaded and stays writable for shaders that were left out of pre-pass
+        if(mDepthPrepass)
+            mRenderGraph.Read(mainPass, depth, RenderGraphUsage::DepthAttachment);
+        mRenderGraph.Write(mainPass, depth, RenderGraphUsage::DepthAttachment);
+
+        if(culling)
+        {
+            mRenderGraph.Read(mainPass, instances, RenderGraphUsage::VertexRead);
+            mRenderGraph.Read(mainPass, indirect, RenderGraphUsage::IndirectRead);
+        }
+
+        mRenderGraph.Compile();
+
+        //Image view of depth is known only once transients are placed
+        UpdateFrameBuffers(mRenderGraph.GetImageView(depth));
+        rpInfo.framebuffer = vecFrameBuffers.at(imgIndex);
+        prepassInfo.framebuffer = mPrepassFrameBuffer;
+
+        mRenderGraph.Execute(vecCmdBuffers[mCurrentFrame]);
+
+        //Chunks were recorded by worker threads, their counts are summed once every pass is done
+        for(auto& chunk : vecDrawChunks)
+        {
+            mDrawStats.Add(chunk.mStats);
+            mPrepassStats.Add(chunk.mPrepassStats);
+        }
+        mDrawStats.mPrepassDrawCalls = mPrepassStats.mDrawCalls;
+
+        if(!mRenderGraphDumpPath.empty())
+        {
+            mRenderGraph.Dump(mRenderGraphDumpPath);
+            mRenderGraphDumpPath.clear();
         }
 
-        vkCmdEndRenderPass(vecCmdBuffers[mCurrentFrame]);
+        mOcclusionReady = false;
+
+        mRecordTimeSum += std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - recordStart).count();
+        mRecordTimeCount++;
 
 	    res = vkEndCommandBuffer(vecCmdBuffers[mCurrentFrame]);
         VK_THROW_IF_FAILED(res);
@@ -1274,50 +3081,204 @@ namespace Ngine
 	    mCurrentFrame = (mCurrentFrame + 1) % MAX_FRAMES_IN_FLIGHT;
     }
 
-    void GraphicsCore::UpdateMvpBuffer(uint32_t frameIndex, GameObject3D* go)
+    void GraphicsCore::PrepareDrawChunks()
     {
-        MVP mvp = {};
-        mvp.model = go->GetWorldMatrix();
-        mvp.view = view;
-        mvp.projection = proj;
+        const size_t minChunkPackets = 256;
+        size_t packetCount = mDrawList.GetSize();
 
-        for(auto& model : vecModels)
+        //Chunks keep draw list order, so executing them one after another draws packets in sorted order.
+        //Pre-pass and shading pass record the same chunks, so constants are allocated once per frame
+        uint32_t chunkCount = 1;
+        if(mParallelRecording)
+            chunkCount = (uint32_t)std::min<size_t>(mRecordThreads, (packetCount + minChunkPackets - 1) / minChunkPackets);
+
+        vecDrawChunks.resize(chunkCount);
+
+        for(uint32_t i = 0; i < chunkCount; i++)
+        {
+            DrawChunk& chunk = vecDrawChunks[i];
+            chunk.mFirst = packetCount * i / chunkCount;
+            chunk.mCount = packetCount * (i + 1) / chunkCount - chunk.mFirst;
+
+            if(!PrepareDrawChunk(chunk))
+                chunk.mCount = 0;
+        }
+    }
+
+    void GraphicsCore::RecordScenePass(VkCommandBuffer cmdBuffer, const VkRenderPassBeginInfo& rpInfo, std::optional<uint32_t>& cameraOffset, ShaderPass pass)
+    {
+        //Subpass recorded from secondary buffers cannot contain any commands of its own
+        vkCmdBeginRenderPass(cmdBuffer, &rpInfo, mParallelRecording ? VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS : VK_SUBPASS_CONTENTS_INLINE);
+
+        if(mParallelRecording)
+            RecordSecondaryBuffers(cmdBuffer, rpInfo, cameraOffset, pass);
+        else
+        {
+            SetViewportAndScissor(cmdBuffer);
+
+            if(!vecDrawChunks.empty())
+                RecordDrawList(cmdBuffer, vecDrawChunks[0], cameraOffset, pass);
+
+            DrawInstanceGroups(cmdBuffer, cameraOffset, pass);
+        }
+
+        vkCmdEndRenderPass(cmdBuffer);
+    }
+
+    void GraphicsCore::RecordSecondaryBuffers(VkCommandBuffer cmdBuffer, const VkRenderPassBeginInfo& rpInfo, std::optional<uint32_t>& cameraOffset, ShaderPass pass)
+    {
+        uint32_t chunkCount = (uint32_t)vecDrawChunks.size();
+        bool prepass = pass == ShaderPass::DepthPrepass;
+
+        VkCommandBufferInheritanceInfo inheritance = {};
+        inheritance.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+        inheritance.renderPass = rpInfo.renderPass;
+        inheritance.subpass = 0;
+        inheritance.framebuffer = rpInfo.framebuffer;
+
+        //Shading pass runs inside fragment invocation query of the primary buffer
+        if(mStatisticsPool != VK_NULL_HANDLE && !prepass)
+            inheritance.pipelineStatistics = VK_QUERY_PIPELINE_STATISTIC_FRAGMENT_SHADER_INVOCATIONS_BIT;
+
+        VkCommandBufferBeginInfo beginInfo = {};
+        beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+        beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT | VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT;
+        beginInfo.pInheritanceInfo = &inheritance;
+
+        //Last buffer holds instance groups, they are recorded next to draw list chunks
+        RecordContext* pContexts = &vecRecordContexts[mCurrentFrame * mRecordContextCount];
+        vecSecondaryBuffers.clear();
+
+        for(uint32_t i = 0; i <= chunkCount; i++)
+        {
+            //Begin and end stay on this thread so failures can be thrown, workers only record
+            VkCommandBuffer secondary = prepass ? pContexts[i].mPrepassCmdBuffer : pContexts[i].mCmdBuffer;
+            VkResult res = vkBeginCommandBuffer(secondary, &beginInfo);
+            VK_THROW_IF_FAILED(res);
+            vecSecondaryBuffers.push_back(secondary);
+        }
+
+        std::optional<uint32_t> groupCameraOffset = cameraOffset;
+
+        mWorkers.ParallelFor(chunkCount + 1, [&](uint32_t job)
+        {
+            //Dynamic state is not inherited from primary buffer
+            SetViewportAndScissor(vecSecondaryBuffers[job]);
+
+            if(job < chunkCount)
+                RecordDrawList(vecSecondaryBuffers[job], vecDrawChunks[job], cameraOffset, pass);
+            else
+                DrawInstanceGroups(vecSecondaryBuffers[job], groupCameraOffset, pass);
+        });
+
+        for(uint32_t i = 0; i <= chunkCount; i++)
         {
-            if(model.mId == go->mAssocMdl)
-                memcpy(model.vecUniformBuffersMapped[frameIndex], &mvp, sizeof(mvp));
+            VkResult res = vkEndCommandBuffer(vecSecondaryBuffers[i]);
+            VK_THROW_IF_FAILED(res);
         }
+
+        vkCmdExecuteCommands(cmdBuffer, vecSecondaryBuffers.size(), vecSecondaryBuffers.data());
+    }
+
+    void GraphicsCore::SetViewportAndScissor(VkCommandBuffer cmdBuffer)
+    {
+        VkViewport viewport = {};
+        viewport.x = 0.0f;
+        viewport.y = 0.0f;
+        viewport.width = (float)mSwapExtent.width;
+        viewport.height = (float)mSwapExtent.height;
+        viewport.minDepth = 0.0f;
+        viewport.maxDepth = 1.0f;
+        vkCmdSetViewport(cmdBuffer, 0, 1, &viewport);
+
+        VkRect2D scissor = {};
+        scissor.offset = { 0,0 };
+        scissor.extent = mSwapExtent;
+        vkCmdSetScissor(cmdBuffer, 0, 1, &scissor);
     }
 
-    std::array<VkVertexInputAttributeDescription, 3> Vertex::GetAttributeDescriptions()
+    void DrawStats::Add(const DrawStats& other)
+    {
+        mPackets += other.mPackets;
+        mCulledObjects += other.mCulledObjects;
+        mOccludedObjects += other.mOccludedObjects;
+        mTriangles += other.mTriangles;
+        mDrawCalls += other.mDrawCalls;
+        mIndirectCommands += other.mIndirectCommands;
+        mPipelineBinds += other.mPipelineBinds;
+        mPipelineBindsElided += other.mPipelineBindsElided;
+        mDescriptorBinds += other.mDescriptorBinds;
+        mDescriptorBindsElided += other.mDescriptorBindsElided;
+        mVertexBufferBinds += other.mVertexBufferBinds;
+        mVertexBufferBindsElided += other.mVertexBufferBindsElided;
+        mIndexBufferBinds += other.mIndexBufferBinds;
+        mIndexBufferBindsElided += other.mIndexBufferBindsElided;
+        mNotReadySkipped += other.mNotReadySkipped;
+        mPrepassDrawCalls += other.mPrepassDrawCalls;
+    }
+
+    std::array<VkVertexInputAttributeDescription, 3> Vertex::GetAttributeDescriptions(VertexLayout layout)
     {
         std::array<VkVertexInputAttributeDescription, 3> attrDesc = {};
+        bool packed = layout == VertexLayout::Packed;
 
         //Position
         attrDesc[0].binding = 0;
         attrDesc[0].location = 0;
-        attrDesc[0].format = VK_FORMAT_R32G32B32_SFLOAT;
-        attrDesc[0].offset = offsetof(Vertex, pos);
+        attrDesc[0].format = packed ? VK_FORMAT_R16G16B16A16_SNORM : VK_FORMAT_R32G32B32_SFLOAT;
+        attrDesc[0].offset = packed ? offsetof(PackedVertex, pos) : offsetof(Vertex, pos);
 
         //Color
         attrDesc[1].binding = 0;
         attrDesc[1].location = 1;
-        attrDesc[1].format = VK_FORMAT_R32G32B32_SFLOAT;
-        attrDesc[1].offset = offsetof(Vertex, color);
+        attrDesc[1].format = packed ? VK_FORMAT_R8G8B8A8_UNORM : VK_FORMAT_R32G32B32_SFLOAT;
+        attrDesc[1].offset = packed ? offsetof(PackedVertex, color) : offsetof(Vertex, color);
 
         //UV
         attrDesc[2].binding = 0;
         attrDesc[2].location = 2;
-        attrDesc[2].format = VK_FORMAT_R32G32_SFLOAT;
-        attrDesc[2].offset = offsetof(Vertex, uv);
+        attrDesc[2].format = packed ? VK_FORMAT_R16G16_SFLOAT : VK_FORMAT_R32G32_SFLOAT;
+        attrDesc[2].offset = packed ? offsetof(PackedVertex, uv) : offsetof(Vertex, uv);
+
+        return attrDesc;
+    }
+
+    uint32_t Vertex::GetStride(VertexLayout layout)
+    {
+        return layout == VertexLayout::Packed ? sizeof(PackedVertex) : sizeof(Vertex);
+    }
+
+    std::array<VkVertexInputAttributeDescription, 4> Vertex::GetInstanceAttributeDescriptions()
+    {
+        std::array<VkVertexInputAttributeDescription, 4> attrDesc = {};
+
+        //World matrix takes four consecutive locations, one per column
+        for(uint32_t i = 0; i < 4; i++)
+        {
+            attrDesc[i].binding = 1;
+            attrDesc[i].location = 3 + i;
+            attrDesc[i].format = VK_FORMAT_R32G32B32A32_SFLOAT;
+            attrDesc[i].offset = offsetof(InstanceData, world) + sizeof(glm::vec4) * i;
+        }
 
         return attrDesc;
     }
 
-    VkVertexInputBindingDescription Vertex::GetBindingDescription()
+    VkVertexInputBindingDescription Vertex::GetInstanceBindingDescription()
+    {
+        VkVertexInputBindingDescription bindingDesc = {};
+        bindingDesc.binding = 1;
+        bindingDesc.stride = sizeof(InstanceData);
+        bindingDesc.inputRate = VK_VERTEX_INPUT_RATE_INSTANCE;
+
+        return bindingDesc;
+    }
+
+    VkVertexInputBindingDescription Vertex::GetBindingDescription(VertexLayout layout)
     {
         VkVertexInputBindingDescription bindingDesc = {};
         bindingDesc.binding = 0;
-        bindingDesc.stride = sizeof(Vertex);
+        bindingDesc.stride = GetStride(layout);
         bindingDesc.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
 
         return bindingDesc;
@@ -1407,71 +3368,161 @@ namespace Ngine
         fragmentFile.read(fragmentShaderBuffer.data(), fragmentSize);
         fragmentFile.close();
 
-        //Create shader module for vertex shader
-        VkShaderModuleCreateInfo moduleInfo{};
-        moduleInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
-        moduleInfo.codeSize = vertexShaderBuffer.size();
-        moduleInfo.pCode = reinterpret_cast<const uint32_t*>(vertexShaderBuffer.data());
-
-        VkResult res = vkCreateShaderModule(mDevice, &moduleInfo, nullptr, &shader.mVertex);
-        if(res != VK_SUCCESS)
+        //Modules are shared by content, so the same file loaded twice maps to one module
+        shader.mVertex = GetShaderModule(vertexShaderBuffer);
+        if(shader.mVertex == VK_NULL_HANDLE)
         {
-            LOG_F(ERROR, "Error creating vertex shader module! EC = %d", res);
+            LOG_F(ERROR, "Cannot create vertex shader module from %s", vertexPath);
             return 0;
         }
 
-        //Create shader module for fragment shader
-        ZeroMemory(&moduleInfo, sizeof(moduleInfo));
-        moduleInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
-        moduleInfo.codeSize = fragmentShaderBuffer.size();
-        moduleInfo.pCode = reinterpret_cast<const uint32_t*>(fragmentShaderBuffer.data());
-        res = vkCreateShaderModule(mDevice, &moduleInfo, nullptr, &shader.mFragment);
-        if (res != VK_SUCCESS)
+        shader.mFragment = GetShaderModule(fragmentShaderBuffer);
+        if(shader.mFragment == VK_NULL_HANDLE)
         {
-            LOG_F(ERROR, "Error creating fragment shader module! EC = %d", res);
+            LOG_F(ERROR, "Cannot create fragment shader module from %s", fragmentPath);
             return 0;
         }
 
-        VkPipelineShaderStageCreateInfo vertShaderStageInfo{};
-        vertShaderStageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
-        vertShaderStageInfo.stage = VK_SHADER_STAGE_VERTEX_BIT;
-        vertShaderStageInfo.module = shader.mVertex;
-        vertShaderStageInfo.pName = "main";
+        //Same pair of modules means same SPIR-V, everything built from it would be identical
+        for(auto& loaded : vecShaders)
+        {
+            if(loaded.mVertex == shader.mVertex && loaded.mFragment == shader.mFragment)
+            {
+                mShaderCacheStats.mShaderHits++;
+
+                //Failed states were forgotten by CollectPipelines, only the missing pipelines are compiled again.
+                //Shader with some pipelines still in flight is retried by a later load once they are collected
+                if(loaded.mCompileFailed && loaded.mPendingPipelines == 0)
+                {
+                    LOG_F(INFO, "Shader %u failed to compile some pipelines, requesting them again", loaded.mId);
+                    loaded.mCompileFailed = false;
+                    RequestShaderPipelines(loaded);
+
+                    if(loaded.mPendingPipelines == 0)
+                        PublishShaderReady(loaded);
+                }
+
+                LOG_F(INFO, "Shader %s + %s is already loaded with ID = %d", vertexPath, fragmentPath, loaded.mId);
+                return loaded.mId;
+            }
+        }
+
+        shader.mBindless = ShaderUsesStorageBuffer(vertexShaderBuffer) || ShaderUsesStorageBuffer(fragmentShaderBuffer);
+        shader.mUsesPushConstants = !shader.mBindless && (ShaderUsesPushConstants(vertexShaderBuffer) || ShaderUsesPushConstants(fragmentShaderBuffer));
+        shader.mUsesInstancing = ShaderReadsInputLocation(vertexShaderBuffer, 3);
 
-        VkPipelineShaderStageCreateInfo fragShaderStageInfo{};
-        fragShaderStageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
-        fragShaderStageInfo.stage = VK_SHADER_STAGE_FRAGMENT_BIT;
-        fragShaderStageInfo.module = shader.mFragment;
-        fragShaderStageInfo.pName = "main";
+        if(shader.mBindless && (!mBindless || shader.mUsesInstancing))
+        {
+            LOG_F(ERROR, "Shader %s reads storage buffers, %s", vertexPath, mBindless ? "bindless shaders cannot use per instance attributes" : "bindless descriptors are disabled");
+            return 0;
+        }
 
-        shader.mShaderStages[0] = vertShaderStageInfo;
-        shader.mShaderStages[1] = fragShaderStageInfo;
+        LOG_IF_F(INFO, shader.mBindless, "Shader reads per object data from bindless set");
+        LOG_IF_F(INFO, shader.mUsesPushConstants, "Shader uses push constants for per object data");
+        LOG_IF_F(INFO, shader.mUsesInstancing, "Shader uses per instance attributes, objects will be drawn with instancing");
 
-        CreateDescriptorSetLayout(shader);
-        CreatePipeline(shader);
-        CreateDescriptorPool(shader);
+        //EQUAL test after pre-pass needs bit exact depth, which only invariant position guarantees across pipelines
+        shader.mPrepassVariants = mDepthPrepassPipelines && ShaderHasInvariantPosition(vertexShaderBuffer);
+        LOG_IF_F(WARNING, mDepthPrepassPipelines && !shader.mPrepassVariants, "Vertex shader %s does not declare gl_Position invariant, shader is left out of depth pre-pass", vertexPath);
+        LOG_IF_F(WARNING, shader.mPrepassVariants && ShaderDisablesEarlyDepth(fragmentShaderBuffer), "Fragment shader %s discards or writes depth, it runs before depth test even after pre-pass", fragmentPath);
 
+        shader.mDescLayout = shader.mBindless ? mBindlessSetLayout : mObjectSetLayout;
+        shader.mPipelineLayout = shader.mBindless ? mBindlessPipelineLayout : mPipelineLayouts[shader.mUsesPushConstants ? 1 : 0];
 
         shader.mId = GenerateExclusiveShaderId();
+
+        //Shader inputs stay floats, only the fetched format differs between layouts
+        auto pipelineStart = std::chrono::high_resolution_clock::now();
+
+        RequestShaderPipelines(shader);
+
+        double pipelineMs = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - pipelineStart).count();
+        LOG_IF_F(INFO, shader.mPendingPipelines == 0, "Shader pipelines created in %.2f ms%s", pipelineMs, mPipelineCache.IsWarm() ? " with warm pipeline cache" : "");
+        LOG_IF_F(INFO, shader.mPendingPipelines > 0, "Shader %u queued %u pipelines for background compilation", shader.mId, shader.mPendingPipelines);
+
+        //Bindless shaders share the global set, nothing is allocated per shader
+        if(!shader.mBindless)
+        {
+            CreateDescriptorPool(shader);
+            CreateDescriptorSets(shader);
+        }
+
         vecShaders.push_back(shader);
 
+        //Listeners get the same event whether pipelines were compiled now or are still in flight
+        if(shader.mPendingPipelines == 0)
+            PublishShaderReady(shader);
+
         LOG_F(INFO, "Shader loaded with ID = %d", shader.mId);
 
         return shader.mId;
     }
 
+    VkShaderModule GraphicsCore::GetShaderModule(const std::vector<char>& code)
+    {
+        uint64_t key = PipelineCache::Hash(code.data(), code.size());
+
+        //Hash only narrows the search, code is compared so colliding files never share a module
+        auto range = mShaderModules.equal_range(key);
+        for(auto it = range.first; it != range.second; it++)
+        {
+            if(it->second.vecCode == code)
+            {
+                mShaderCacheStats.mModuleHits++;
+                return it->second.mModule;
+            }
+        }
+
+        VkShaderModuleCreateInfo moduleInfo{};
+        moduleInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+        moduleInfo.codeSize = code.size();
+        moduleInfo.pCode = reinterpret_cast<const uint32_t*>(code.data());
+
+        ShaderModuleEntry entry;
+        VkResult res = vkCreateShaderModule(mDevice, &moduleInfo, nullptr, &entry.mModule);
+        if(res != VK_SUCCESS)
+        {
+            LOG_F(ERROR, "Error creating shader module! EC = %d", res);
+            return VK_NULL_HANDLE;
+        }
+
+        mShaderCacheStats.mModuleMisses++;
+        entry.vecCode = code;
+        mShaderModules.insert({ key, entry });
+        return entry.mModule;
+    }
+
     uint32_t GraphicsCore::CreateModelFromVertexList(std::vector<Vertex>& v, std::vector<uint16_t>& i)
     {
-        Model mdl = {};
-        mdl.vecMeshes.push_back(Mesh());
-        mdl.vecMeshes[0].mVertexCount = v.size();
-        mdl.vecMeshes[0].mIndexCount = i.size();
+        Mesh mesh;
+
+        try
+        {
+            CreateMeshGeometry(mesh, v, i);
+        }
+        catch (const VulkanException& ve)
+        {
+            LOG_F(ERROR, "%s", ve.what());
+            return 0;
+        }
+
+        return CreateModel(mesh);
+    }
+
+    uint32_t GraphicsCore::CreateModelFromVertexList(std::vector<Vertex>& v, std::vector<uint32_t>& i)
+    {
+        Mesh mesh;
 
         try
         {
-            CreateVertexBuffer(mdl.vecMeshes[0], v);
-            CreateIndexBuffer(mdl.vecMeshes[0], i);
-            CreateMvpBuffer(mdl);
+            //Index list that can be addressed with 16 bits is stored in half of the space
+            if(v.size() <= UINT16_MAX + 1)
+            {
+                std::vector<uint16_t> shortIndices(i.begin(), i.end());
+                CreateMeshGeometry(mesh, v, shortIndices);
+            }
+            else
+                CreateMeshGeometry(mesh, v, i);
         }
         catch (const VulkanException& ve)
         {
@@ -1479,8 +3530,18 @@ namespace Ngine
             return 0;
         }
 
+        return CreateModel(mesh);
+    }
+
+    uint32_t GraphicsCore::CreateModel(Mesh& mesh)
+    {
+        Model mdl = {};
+        mdl.vecMeshes.push_back(mesh);
 
+        //Model is returned right away, its copies are submitted with the rest of current upload batch
+        mdl.mUploadTicket = mesh.mUploadTicket;
         mdl.mId = GenerateExclusiveModelId();
+        CalculateBounds(mdl);
         vecModels.push_back(mdl);
 
         LOG_F(INFO, "Model created with ID = %d", mdl.mId);
@@ -1495,15 +3556,97 @@ namespace Ngine
 
     void GraphicsCore::AddGameObjectToDrawList(GameObject3D* pGo)
     {
-        CreateDescriptorSets(pGo);
+        //Resolve model and shader once so draw loop does not have to search for them every frame
+        bool modelFound = false, shaderFound = false;
+
+        for (uint32_t i = 0; i < vecModels.size(); i++)
+        {
+            if (vecModels[i].mId == pGo->mAssocMdl)
+            {
+                pGo->mModelIndex = i;
+                modelFound = true;
+            }
+        }
+
+        for (uint32_t i = 0; i < vecShaders.size(); i++)
+        {
+            if (vecShaders[i].mId == pGo->mAssocShader)
+            {
+                pGo->mShaderIndex = i;
+                shaderFound = true;
+            }
+        }
+
+        pGo->mDrawable = modelFound && shaderFound;
+        LOG_IF_F(WARNING, !pGo->mDrawable, "Game object references model or shader that does not exist, it won't be drawn");
+
+        //Objects using instanced shader are grouped by model and shader
+        if(pGo->mDrawable && vecShaders[pGo->mShaderIndex].mUsesInstancing)
+        {
+            uint64_t key = ((uint64_t)pGo->mShaderIndex << 32) | pGo->mModelIndex;
+            auto it = mInstanceGroupLookup.find(key);
+
+            if(it == mInstanceGroupLookup.end())
+            {
+                InstanceGroup group;
+                group.mModelIndex = pGo->mModelIndex;
+                group.mShaderIndex = pGo->mShaderIndex;
+                it = mInstanceGroupLookup.insert({key, (uint32_t)vecInstanceGroups.size()}).first;
+                vecInstanceGroups.push_back(group);
+            }
+
+            vecInstanceGroups[it->second].vecObjects.push_back(pGo);
+        }
+
+        if(pGo->mDrawable && pGo->pSpatialTree == nullptr)
+        {
+            Model& model = vecModels[pGo->mModelIndex];
+            pGo->mLocalBoundsMin = model.mBoundsMin;
+            pGo->mLocalBoundsMax = model.mBoundsMax;
+
+            glm::vec3 boundsMin, boundsMax;
+            DynamicBvh::TransformBounds(pGo->GetWorldMatrix(), model.mBoundsMin, model.mBoundsMax, boundsMin, boundsMax);
+            pGo->mSpatialProxy = mSpatialTree.Insert(pGo, boundsMin, boundsMax);
+            pGo->pSpatialTree = &mSpatialTree;
+        }
+
         vecObjects.push_back(pGo);
         LOG_F(INFO, "Game object added to draw list...");
     }
 
-    uint32_t GraphicsCore::LoadIntermediateModel(const char* modelPath)
+    void GraphicsCore::RemoveGameObjectFromDrawList(GameObject3D* pGo)
+    {
+        auto it = std::find(vecObjects.begin(), vecObjects.end(), pGo);
+        if(it != vecObjects.end())
+            vecObjects.erase(it);
+
+        if(pGo->pSpatialTree == &mSpatialTree)
+        {
+            mSpatialTree.Remove(pGo->mSpatialProxy);
+            pGo->pSpatialTree = nullptr;
+            pGo->mSpatialProxy = -1;
+        }
+
+        if(pGo->mDrawable && vecShaders[pGo->mShaderIndex].mUsesInstancing)
+        {
+            uint64_t key = ((uint64_t)pGo->mShaderIndex << 32) | pGo->mModelIndex;
+            auto groupIt = mInstanceGroupLookup.find(key);
+
+            if(groupIt != mInstanceGroupLookup.end())
+            {
+                auto& vecGroupObjects = vecInstanceGroups[groupIt->second].vecObjects;
+                auto objectIt = std::find(vecGroupObjects.begin(), vecGroupObjects.end(), pGo);
+                if(objectIt != vecGroupObjects.end())
+                    vecGroupObjects.erase(objectIt);
+            }
+        }
+    }
+
+    uint32_t GraphicsCore::LoadIntermediateModel(const char* modelPath, bool occluder)
     {
         std::string finalPath = "Resource/Model/" + FileUtils::CutPathToFileName(modelPath);
         LOG_F(INFO, "Beggining to load %s", finalPath.c_str());
+        auto loadStart = std::chrono::high_resolution_clock::now();
 
         Assimp::Importer imp;
         const aiScene* pScene = imp.ReadFile(finalPath.c_str(), aiProcess_Triangulate);
@@ -1515,15 +3658,42 @@ namespace Ngine
         }
 
         Model result;
+        result.mOccluder = occluder;
         LOG_F(INFO, "This model contains %d meshes", pScene->mNumMeshes);
 
+        //Every mesh of the model shares one quantization box, so it can be undone with the world matrix of the object
+        if(mQuantizeVertices)
+            result.mQuantization = CalculateQuantization(pScene);
+
+        mImportCacheBefore = VertexCacheStats();
+        mImportCacheAfter = VertexCacheStats();
         ProcessNode(pScene->mRootNode, pScene, result);
 
-        CreateMvpBuffer(result);
+        LOG_IF_F(INFO, mOptimizeMeshes, "Vertex cache (%u entries): ACMR %.3f -> %.3f, ATVR %.3f -> %.3f", MeshOptimizer::CACHE_SIZE,
+            mImportCacheBefore.GetAcmr(), mImportCacheAfter.GetAcmr(), mImportCacheBefore.GetAtvr(), mImportCacheAfter.GetAtvr());
+
+        uint64_t vertexBytes = 0, fullVertexBytes = 0;
+        uint32_t packedMeshes = 0;
+
+        for(auto& mesh : result.vecMeshes)
+        {
+            result.mUploadTicket = std::max(result.mUploadTicket, mesh.mUploadTicket);
+            vertexBytes += (uint64_t)mesh.mVertexCount * Vertex::GetStride(mesh.mLayout);
+            fullVertexBytes += (uint64_t)mesh.mVertexCount * sizeof(Vertex);
+            packedMeshes += mesh.mLayout == VertexLayout::Packed ? 1 : 0;
+        }
+
+        LOG_IF_F(INFO, mQuantizeVertices, "Packed vertices in %u of %zu meshes, vertex data %llu KB instead of %llu KB", packedMeshes, result.vecMeshes.size(),
+            (unsigned long long)(vertexBytes >> 10), (unsigned long long)(fullVertexBytes >> 10));
+
         result.mId = GenerateExclusiveModelId();
+        CalculateBounds(result);
         vecModels.push_back(result);
 
-        LOG_F(INFO, "Model %s loaded with id = %d", finalPath.c_str(), result.mId);
+        double loadTime = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - loadStart).count();
+        LOG_F(INFO, "Model %s loaded with id = %d in %.2f ms", finalPath.c_str(), result.mId, loadTime);
+        mAllocator.LogStats();
+        mGeometry.LogStats();
 
         return result.mId;
     }
@@ -1532,7 +3702,7 @@ namespace Ngine
     {
         for(uint32_t i = 0; i < pNode->mNumMeshes; i++)
         {
-            outMdl.vecMeshes.push_back(ProcessMesh(pScene->mMeshes[pNode->mMeshes[i]], pScene));
+            ProcessMesh(pScene->mMeshes[pNode->mMeshes[i]], pScene, outMdl);
         }
 
         for(uint32_t i = 0; i < pNode->mNumChildren; i++)
@@ -1541,12 +3711,12 @@ namespace Ngine
         }
     }
 
-    Mesh GraphicsCore::ProcessMesh(aiMesh* pMesh, const aiScene* pScene)
+    void GraphicsCore::ProcessMesh(aiMesh* pMesh, const aiScene* pScene, Model& outMdl)
     {
         Mesh result;
 
         std::vector<Vertex> verts;
-        std::vector<uint16_t> inds;
+        std::vector<uint32_t> inds;
 
         for(uint32_t i = 0; i < pMesh->mNumVertices; i++)
         {
@@ -1569,16 +3739,249 @@ namespace Ngine
         {
             aiFace face = pMesh->mFaces[i];
             for(uint32_t j = 0; j < face.mNumIndices; j++)
-                inds.push_back((uint16_t)face.mIndices[j]);
+                inds.push_back(face.mIndices[j]);
+        }
+
+        if(mOptimizeMeshes)
+            OptimizeMesh(verts, inds);
+
+        //Occluders keep positions on CPU for software rasterizer, meshes of one model share single list
+        if(outMdl.mOccluder)
+        {
+            uint32_t base = outMdl.vecOccluderPositions.size();
+
+            for(auto& v : verts)
+                outMdl.vecOccluderPositions.push_back(v.pos);
+
+            for(auto index : inds)
+                outMdl.vecOccluderIndices.push_back(base + index);
+        }
+
+        //Meshlets are separate meshes cut by vertex count, simplified levels of the whole mesh would not fit any of them
+        if(verts.size() > UINT16_MAX + 1 && FileUtils::GetBoolFromConfig("Resource/ngine.ini", "Memory", "SplitLargeMeshes"))
+        {
+            LOG_IF_F(INFO, mLodLevels > 0, "Mesh with %zu vertices is split into meshlets, it gets no LOD chain", verts.size());
+            SplitIntoMeshlets(verts, inds, outMdl);
+            return;
         }
 
-        result.mIndexCount = inds.size();
-        result.mVertexCount = verts.size();
+        //Simplified levels index the same vertices and are uploaded right after the full index list
+        uint32_t fullIndexCount = inds.size();
+        std::vector<uint32_t> lodInds;
 
-        CreateVertexBuffer(result, verts);
-        CreateIndexBuffer(result, inds);
+        if(mLodLevels > 0)
+            GenerateLods(verts, inds, lodInds, result.vecLods);
 
-        return result;
+        //Pick the narrowest index format that can address every vertex of the mesh
+        if(verts.size() <= UINT16_MAX + 1)
+        {
+            std::vector<uint16_t> shortInds(inds.begin(), inds.end());
+            shortInds.insert(shortInds.end(), lodInds.begin(), lodInds.end());
+            CreateMeshGeometry(result, verts, shortInds, outMdl.mQuantization);
+        }
+        else
+        {
+            LOG_F(INFO, "Mesh with %zu vertices uses 32 bit indices", verts.size());
+            inds.insert(inds.end(), lodInds.begin(), lodInds.end());
+            CreateMeshGeometry(result, verts, inds, outMdl.mQuantization);
+        }
+
+        result.mIndexCount = fullIndexCount;
+        for(auto& lod : result.vecLods)
+            lod.mFirstIndex += result.mFirstIndex + fullIndexCount;
+
+        outMdl.vecMeshes.push_back(result);
+    }
+
+    void GraphicsCore::OptimizeMesh(std::vector<Vertex>& verts, std::vector<uint32_t>& indices)
+    {
+        mImportCacheBefore.Add(MeshOptimizer::AnalyzeVertexCache(indices, verts.size()));
+
+        std::vector<uint32_t> vecOptimized;
+        MeshOptimizer::WeldIndices(verts.data(), verts.size(), sizeof(Vertex), indices, vecOptimized);
+        MeshOptimizer::OptimizeVertexCache(vecOptimized, verts.size());
+
+        std::vector<glm::vec3> vecPositions(verts.size());
+        for(size_t i = 0; i < verts.size(); i++)
+            vecPositions[i] = verts[i].pos;
+
+        MeshOptimizer::OptimizeOverdraw(vecOptimized, vecPositions);
+
+        //Last step, it renumbers vertices and drops duplicates that are no longer referenced
+        verts.resize(MeshOptimizer::OptimizeVertexFetch(verts.data(), verts.size(), sizeof(Vertex), vecOptimized));
+        indices.swap(vecOptimized);
+
+        mImportCacheAfter.Add(MeshOptimizer::AnalyzeVertexCache(indices, verts.size()));
+    }
+
+    void GraphicsCore::GenerateLods(const std::vector<Vertex>& verts, const std::vector<uint32_t>& indices, std::vector<uint32_t>& outIndices, std::vector<MeshLod>& outLods)
+    {
+        //Small meshes cost less to draw than to switch between their levels
+        if(indices.size() < 3 * 64)
+            return;
+
+        std::vector<glm::vec3> vecPositions(verts.size());
+        glm::vec3 boundsMin = verts[0].pos, boundsMax = verts[0].pos;
+
+        for(size_t i = 0; i < verts.size(); i++)
+        {
+            vecPositions[i] = verts[i].pos;
+            boundsMin = glm::min(boundsMin, verts[i].pos);
+            boundsMax = glm::max(boundsMax, verts[i].pos);
+        }
+
+        float maxError = glm::length(boundsMax - boundsMin) * 0.5f * mLodTargetError;
+
+        //Importer does not join identical vertices, without welding every triangle would look disconnected
+        std::vector<uint32_t> vecCurrent, vecNext;
+        MeshOptimizer::WeldIndices(verts.data(), verts.size(), sizeof(Vertex), indices, vecCurrent);
+
+        float error = 0.0f;
+        for(int level = 0; level < mLodLevels; level++)
+        {
+            float levelError = MeshSimplifier::Simplify(vecPositions, vecCurrent, vecCurrent.size() / 6 * 3, maxError, vecNext);
+
+            //Level that keeps most of the triangles is not worth its index memory
+            if(vecNext.size() > vecCurrent.size() * 3 / 4)
+                break;
+
+            //Every level is simplified from the previous one, so their errors add up
+            error += levelError;
+
+            if(mOptimizeMeshes)
+                MeshOptimizer::OptimizeVertexCache(vecNext, verts.size());
+
+            MeshLod lod;
+            lod.mFirstIndex = outIndices.size();
+            lod.mIndexCount = vecNext.size();
+            lod.mError = error;
+            outLods.push_back(lod);
+
+            outIndices.insert(outIndices.end(), vecNext.begin(), vecNext.end());
+            std::swap(vecCurrent, vecNext);
+        }
+
+        LOG_IF_F(INFO, !outLods.empty(), "Generated %zu LODs, coarsest has %u of %zu triangles", outLods.size(), outLods.back().mIndexCount / 3, indices.size() / 3);
+    }
+
+    void GraphicsCore::SplitIntoMeshlets(const std::vector<Vertex>& verts, const std::vector<uint32_t>& indices, Model& outMdl)
+    {
+        const uint32_t maxMeshletVertices = UINT16_MAX + 1;
+
+        std::vector<int32_t> vecRemap(verts.size(), -1); //Global vertex -> vertex inside current meshlet
+        std::vector<uint32_t> vecUsed; //Global vertices referenced by current meshlet
+        std::vector<Vertex> meshletVerts;
+        std::vector<uint16_t> meshletInds;
+        size_t meshletCount = 0;
+
+        auto flushMeshlet = [&]()
+        {
+            if(meshletInds.empty())
+                return;
+
+            Mesh meshlet;
+            CreateMeshGeometry(meshlet, meshletVerts, meshletInds, outMdl.mQuantization);
+            outMdl.vecMeshes.push_back(meshlet);
+            meshletCount++;
+
+            for(uint32_t v : vecUsed)
+                vecRemap[v] = -1;
+
+            vecUsed.clear();
+            meshletVerts.clear();
+            meshletInds.clear();
+        };
+
+        //Triangles are kept whole, new meshlet starts when next triangle would not be addressable with 16 bits
+        for(size_t i = 0; i + 2 < indices.size(); i += 3)
+        {
+            uint32_t newVerts = 0;
+            for(size_t j = 0; j < 3; j++)
+            {
+                if(vecRemap[indices[i + j]] < 0)
+                    newVerts++;
+            }
+
+            if(meshletVerts.size() + newVerts > maxMeshletVertices)
+                flushMeshlet();
+
+            for(size_t j = 0; j < 3; j++)
+            {
+                uint32_t global = indices[i + j];
+                if(vecRemap[global] < 0)
+                {
+                    vecRemap[global] = meshletVerts.size();
+                    vecUsed.push_back(global);
+                    meshletVerts.push_back(verts[global]);
+                }
+
+                meshletInds.push_back((uint16_t)vecRemap[global]);
+            }
+        }
+
+        flushMeshlet();
+
+        LOG_F(INFO, "Mesh with %zu vertices split into %zu meshlets with 16 bit indices", verts.size(), meshletCount);
+    }
+
+    void GraphicsCore::UpdateOcclusion()
+    {
+        if(!mOcclusionCulling)
+            return;
+
+        auto rasterStart = std::chrono::high_resolution_clock::now();
+        mOcclusionStats = OcclusionStats();
+        mOcclusion.BeginFrame(proj * view);
+
+        for(auto object : vecObjects)
+        {
+            if(!object->mDrawable || !vecModels[object->mModelIndex].mOccluder)
+                continue;
+
+            const Model& model = vecModels[object->mModelIndex];
+            mOcclusion.AddOccluder(object->GetWorldMatrix(), model.vecOccluderPositions, model.vecOccluderIndices);
+            mOcclusionStats.mOccluders++;
+        }
+
+        mOcclusion.Rasterize();
+        auto testStart = std::chrono::high_resolution_clock::now();
+
+        //Objects are split into chunks so workers don't fight over single counter for every object
+        const uint32_t chunkSize = 256;
+        uint32_t chunkCount = (vecObjects.size() + chunkSize - 1) / chunkSize;
+        std::atomic<uint32_t> occluded = 0;
+
+        mWorkers.ParallelFor(chunkCount, [&](uint32_t chunk)
+        {
+            uint32_t hidden = 0;
+            size_t last = std::min((size_t)(chunk + 1) * chunkSize, vecObjects.size());
+
+            for(size_t i = (size_t)chunk * chunkSize; i < last; i++)
+            {
+                GameObject3D* object = vecObjects[i];
+                object->mOccluded = false;
+
+                if(!object->mDrawable)
+                    continue;
+
+                const Model& model = vecModels[object->mModelIndex];
+                glm::vec3 boundsMin, boundsMax;
+                DynamicBvh::TransformBounds(object->GetWorldMatrix(), model.mBoundsMin, model.mBoundsMax, boundsMin, boundsMax);
+
+                object->mOccluded = !mOcclusion.IsVisible(boundsMin, boundsMax);
+                hidden += object->mOccluded ? 1 : 0;
+            }
+
+            occluded += hidden;
+        });
+
+        auto testEnd = std::chrono::high_resolution_clock::now();
+        mOcclusionStats.mOccluderTriangles = mOcclusion.GetTriangleCount();
+        mOcclusionStats.mTestedObjects = vecObjects.size();
+        mOcclusionStats.mOccludedObjects = occluded;
+        mOcclusionStats.mRasterMs = std::chrono::duration<double, std::milli>(testStart - rasterStart).count();
+        mOcclusionStats.mTestMs = std::chrono::duration<double, std::milli>(testEnd - testStart).count();
+        mOcclusionReady = true;
     }
 
     void GraphicsCore::SetCamera(Camera& c)
@@ -1587,6 +3990,117 @@ namespace Ngine
         proj = c.GetProjectionMatrix();
     }
 
+    AllocatorStats GraphicsCore::GetMemoryStats() const
+    {
+        return mAllocator.GetStats();
+    }
+
+    UploadStats GraphicsCore::GetUploadStats() const
+    {
+        return mUploader.GetStats();
+    }
+
+    FrameStats GraphicsCore::GetFrameStats() const
+    {
+        FrameStats stats;
+        if(vecFrameTimes.empty())
+            return stats;
+
+        std::vector<float> vecSorted = vecFrameTimes;
+        std::sort(vecSorted.begin(), vecSorted.end());
+
+        double sum = 0.0;
+        for(float time : vecSorted)
+            sum += time;
+
+        stats.mFrameCount = vecSorted.size();
+        stats.mAverageMs = sum / vecSorted.size();
+        stats.mMinMs = vecSorted.front();
+        stats.mMaxMs = vecSorted.back();
+        stats.mPercentile99Ms = vecSorted[(vecSorted.size() - 1) * 99 / 100];
+
+        double variance = 0.0;
+        for(float time : vecSorted)
+            variance += (time - stats.mAverageMs) * (time - stats.mAverageMs);
+
+        stats.mJitterMs = std::sqrt(variance / vecSorted.size());
+        stats.mRecordAverageMs = mRecordTimeCount > 0 ? mRecordTimeSum / mRecordTimeCount : 0.0;
+
+        if(mFragmentFrames > 0)
+        {
+            stats.mFragmentInvocations = mFragmentInvocationSum / mFragmentFrames;
+            stats.mFragmentsPerPixel = mFragmentsPerPixelSum / mFragmentFrames;
+        }
+
+        return stats;
+    }
+
+    void GraphicsCore::ResetFrameStats()
+    {
+        vecFrameTimes.clear();
+        mFrameTimeIndex = 0;
+        mRecordTimeSum = 0.0;
+        mRecordTimeCount = 0;
+
+        //Queries still in flight were recorded with the old settings
+        mStatisticsEpoch++;
+        mFragmentInvocationSum = 0;
+        mFragmentsPerPixelSum = 0.0;
+        mFragmentFrames = 0;
+    }
+
+    void GraphicsCore::RecordFrameTime()
+    {
+        const uint32_t historySize = 4096;
+        auto now = std::chrono::high_resolution_clock::now();
+
+        //First frame has nothing to compare against
+        if(mLastFrameStart.time_since_epoch().count() != 0)
+        {
+            float frameTime = std::chrono::duration<float, std::milli>(now - mLastFrameStart).count();
+
+            if(vecFrameTimes.size() < historySize)
+                vecFrameTimes.push_back(frameTime);
+            else
+                vecFrameTimes[mFrameTimeIndex] = frameTime;
+
+            mFrameTimeIndex = (mFrameTimeIndex + 1) % historySize;
+        }
+
+        mLastFrameStart = now;
+    }
+
+    bool GraphicsCore::IsModelReady(uint32_t modelId)
+    {
+        for(auto& model : vecModels)
+        {
+            if(model.mId == modelId)
+                return IsModelReady(model);
+        }
+
+        return false;
+    }
+
+    void GraphicsCore::WaitForModel(uint32_t modelId)
+    {
+        for(auto& model : vecModels)
+        {
+            if(model.mId == modelId)
+            {
+                mUploader.Wait(model.mUploadTicket);
+                model.mReady = true;
+            }
+        }
+    }
+
+    bool GraphicsCore::IsModelReady(Model& m)
+    {
+        if(!m.mReady)
+            m.mReady = mUploader.IsComplete(m.mUploadTicket);
+
+        return m.mReady;
+    }
+
     Camera::Camera()
     {
         pos = glm::vec3(5.0f, 5.0f, 5.0f);
@@ -1621,6 +4135,11 @@ namespace Ngine
         return proj;
     }
 
+    Frustum Camera::GetFrustum() const
+    {
+        return Frustum::FromMatrix(proj * view);
+    }
+
     const glm::mat4 Camera::GetViewMatrix() const
     {
         return view;
@@ -0,0 +1,317 @@
+#include "MemoryAllocator.h"
+#include "Exception.h"
+#include "FileUtils.h"
+#include <algorithm>
+
+namespace Ngine
+{
+    static uint64_t AlignUp(uint64_t value, uint64_t alignment)
+    {
+        if(alignment <= 1)
+            return value;
+
+        return (value + alignment - 1) / alignment * alignment;
+    }
+
+    RangeAllocator::RangeAllocator(uint64_t size)
+    {
+        mSize = size;
+        vecFreeRanges.push_back({0, size});
+    }
+
+    bool RangeAllocator::Allocate(uint64_t size, uint64_t alignment, uint64_t& outOffset)
+    {
+        if(size == 0)
+            size = 1;
+
+        //Best fit - pick the free range that leaves the smallest remainder after alignment
+        size_t bestIndex = vecFreeRanges.size();
+        uint64_t bestLeftover = UINT64_MAX;
+
+        for(size_t i = 0; i < vecFreeRanges.size(); i++)
+        {
+            const FreeRange& range = vecFreeRanges[i];
+            uint64_t aligned = AlignUp(range.mOffset, alignment);
+            uint64_t padding = aligned - range.mOffset;
+
+            if(padding + size > range.mSize)
+                continue;
+
+            uint64_t leftover = range.mSize - padding - size;
+            if(leftover < bestLeftover)
+            {
+                bestLeftover = leftover;
+                bestIndex = i;
+
+                if(leftover == 0)
+                    break;
+            }
+        }
+
+        if(bestIndex == vecFreeRanges.size())
+            return false;
+
+        FreeRange range = vecFreeRanges[bestIndex];
+        uint64_t aligned = AlignUp(range.mOffset, alignment);
+        uint64_t padding = aligned - range.mOffset;
+
+        vecFreeRanges.erase(vecFreeRanges.begin() + bestIndex);
+
+        //Return unused space before and after allocation to the free list
+        if(bestLeftover > 0)
+            vecFreeRanges.insert(vecFreeRanges.begin() + bestIndex, {aligned + size, bestLeftover});
+        if(padding > 0)
+            vecFreeRanges.insert(vecFreeRanges.begin() + bestIndex, {range.mOffset, padding});
+
+        mUsed += size;
+        outOffset = aligned;
+        return true;
+    }
+
+    void RangeAllocator::Free(uint64_t offset, uint64_t size)
+    {
+        if(size == 0)
+            size = 1;
+
+        auto it = std::lower_bound(vecFreeRanges.begin(), vecFreeRanges.end(), offset, [](const FreeRange& r, uint64_t o) { return r.mOffset < o; });
+        it = vecFreeRanges.insert(it, {offset, size});
+        mUsed -= size;
+
+        //Merge with next range
+        auto next = it + 1;
+        if(next != vecFreeRanges.end() && it->mOffset + it->mSize == next->mOffset)
+        {
+            it->mSize += next->mSize;
+            vecFreeRanges.erase(next);
+        }
+
+        //Merge with previous range
+        if(it != vecFreeRanges.begin())
+        {
+            auto prev = it - 1;
+            if(prev->mOffset + prev->mSize == it->mOffset)
+            {
+                prev->mSize += it->mSize;
+                vecFreeRanges.erase(it);
+            }
+        }
+    }
+
+#if defined(TARGET_PLATFORM_LINUX)
+
+    void MemoryAllocator::Initialize(VkPhysicalDevice physDevice, VkDevice device)
+    {
+        mDevice = device;
+        vkGetPhysicalDeviceMemoryProperties(physDevice, &mMemProps);
+
+        VkPhysicalDeviceProperties devProp;
+        vkGetPhysicalDeviceProperties(physDevice, &devProp);
+        mMaxAllocationCount = devProp.limits.maxMemoryAllocationCount;
+
+        int deviceBlockMB = FileUtils::GetIntegerFromConfig("Resource/ngine.ini", "Memory", "DeviceBlockSizeMB");
+        int hostBlockMB = FileUtils::GetIntegerFromConfig("Resource/ngine.ini", "Memory", "HostBlockSizeMB");
+
+        mDeviceBlockSize = (VkDeviceSize)(deviceBlockMB > 0 ? deviceBlockMB : 64) * 1024 * 1024;
+        mHostBlockSize = (VkDeviceSize)(hostBlockMB > 0 ? hostBlockMB : 16) * 1024 * 1024;
+
+        LOG_F(INFO, "Memory allocator initialized (device block = %llu MB, host block = %llu MB, allocation limit = %u)",
+            (unsigned long long)(mDeviceBlockSize >> 20), (unsigned long long)(mHostBlockSize >> 20), mMaxAllocationCount);
+    }
+
+    void MemoryAllocator::Destroy()
+    {
+        for(auto& pool : vecPools)
+        {
+            for(auto& block : pool)
+            {
+                if(block.mMemory != VK_NULL_HANDLE)
+                    ReleaseBlock(block);
+            }
+
+            pool.clear();
+        }
+    }
+
+    Allocation MemoryAllocator::Allocate(const VkMemoryRequirements& req, VkMemoryPropertyFlags props, bool optimalTiling)
+    {
+        uint32_t typeIndex = FindMemoryType(req.memoryTypeBits, props);
+        uint32_t poolIndex = typeIndex * 2 + (optimalTiling ? 1 : 0);
+        auto& pool = vecPools[poolIndex];
+
+        Allocation result = {};
+        result.mPoolIndex = poolIndex;
+        result.mSize = req.size;
+
+        VkDeviceSize blockSize = GetPreferredBlockSize(typeIndex);
+
+        //Resources bigger than half of the block get their own allocation so they don't fragment shared blocks
+        if(req.size > blockSize / 2)
+        {
+            result.mBlockIndex = CreateBlock(poolIndex, req.size, true);
+            MemoryBlock& block = pool[result.mBlockIndex];
+            block.mRanges.Allocate(req.size, req.alignment, result.mOffset);
+            block.mAllocationCount++;
+
+            result.mMemory = block.mMemory;
+            result.pMapped = block.pMapped;
+
+            mStats.mSubAllocations++;
+            mStats.mBytesUsed += req.size;
+            return result;
+        }
+
+        //Try to fit allocation into one of existing blocks
+        for(uint32_t i = 0; i < pool.size(); i++)
+        {
+            MemoryBlock& block = pool[i];
+            if(block.mMemory == VK_NULL_HANDLE || block.mDedicated)
+                continue;
+
+            if(block.mRanges.Allocate(req.size, req.alignment, result.mOffset))
+            {
+                result.mBlockIndex = i;
+                result.mMemory = block.mMemory;
+                result.pMapped = block.pMapped ? static_cast<char*>(block.pMapped) + result.mOffset : nullptr;
+                block.mAllocationCount++;
+
+                mStats.mSubAllocations++;
+                mStats.mBytesUsed += req.size;
+                return result;
+            }
+        }
+
+        //No space left - create new block
+        result.mBlockIndex = CreateBlock(poolIndex, blockSize, false);
+        MemoryBlock& block = pool[result.mBlockIndex];
+
+        if(!block.mRanges.Allocate(req.size, req.alignment, result.mOffset))
+        {
+            LOG_F(ERROR, "Cannot suballocate %llu bytes from a fresh memory block!", (unsigned long long)req.size);
+            throw Exception();
+        }
+
+        result.mMemory = block.mMemory;
+        result.pMapped = block.pMapped ? static_cast<char*>(block.pMapped) + result.mOffset : nullptr;
+        block.mAllocationCount++;
+
+        mStats.mSubAllocations++;
+        mStats.mBytesUsed += req.size;
+        return result;
+    }
+
+    void MemoryAllocator::Free(Allocation& alloc)
+    {
+        if(alloc.mMemory == VK_NULL_HANDLE)
+            return;
+
+        MemoryBlock& block = vecPools[alloc.mPoolIndex][alloc.mBlockIndex];
+        block.mRanges.Free(alloc.mOffset, alloc.mSize);
+        block.mAllocationCount--;
+
+        mStats.mSubAllocations--;
+        mStats.mBytesUsed -= alloc.mSize;
+
+        //Dedicated blocks are returned to the driver right away, shared blocks are kept unless it's not the first one
+        if(block.mAllocationCount == 0 && (block.mDedicated || alloc.mBlockIndex != 0))
+            ReleaseBlock(block);
+
+        alloc = Allocation();
+    }
+
+    AllocatorStats MemoryAllocator::GetStats() const
+    {
+        return mStats;
+    }
+
+    void MemoryAllocator::LogStats() const
+    {
+        LOG_F(INFO, "GPU memory: %u device allocations (%u total), %u suballocations, %llu KB used of %llu KB reserved",
+            mStats.mDeviceAllocations, mStats.mTotalDeviceAllocations, mStats.mSubAllocations,
+            (unsigned long long)(mStats.mBytesUsed >> 10), (unsigned long long)(mStats.mBytesReserved >> 10));
+    }
+
+    uint32_t MemoryAllocator::FindMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags props)
+    {
+        for (uint32_t i = 0; i < mMemProps.memoryTypeCount; i++)
+        {
+            if ((typeFilter & (1 << i)) && (mMemProps.memoryTypes[i].propertyFlags & props) == props)
+                return i;
+        }
+
+        LOG_F(ERROR, "Cannot find memory type matching requested properties!");
+        throw Exception();
+    }
+
+    VkDeviceSize MemoryAllocator::GetPreferredBlockSize(uint32_t typeIndex)
+    {
+        const VkMemoryType& type = mMemProps.memoryTypes[typeIndex];
+        VkDeviceSize heapSize = mMemProps.memoryHeaps[type.heapIndex].size;
+        VkDeviceSize blockSize = (type.propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) ? mHostBlockSize : mDeviceBlockSize;
+
+        //Small heaps (like 256 MB BAR heap) should not be eaten by a single block
+        return std::min(blockSize, heapSize / 8);
+    }
+
+    uint32_t MemoryAllocator::CreateBlock(uint32_t poolIndex, VkDeviceSize size, bool dedicated)
+    {
+        if(mStats.mDeviceAllocations >= mMaxAllocationCount)
+        {
+            LOG_F(ERROR, "Reached maxMemoryAllocationCount (%u)!", mMaxAllocationCount);
+            throw Exception();
+        }
+
+        uint32_t typeIndex = poolIndex / 2;
+
+        MemoryBlock block;
+        block.mDedicated = dedicated;
+        block.mRanges = RangeAllocator(size);
+
+        VkMemoryAllocateInfo allocInfo = {};
+        allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+        allocInfo.allocationSize = size;
+        allocInfo.memoryTypeIndex = typeIndex;
+
+        VkResult res = vkAllocateMemory(mDevice, &allocInfo, nullptr, &block.mMemory);
+        VK_THROW_IF_FAILED(res);
+
+        //Host visible blocks stay mapped for their whole lifetime
+        if(mMemProps.memoryTypes[typeIndex].propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT)
+        {
+            res = vkMapMemory(mDevice, block.mMemory, 0, VK_WHOLE_SIZE, 0, &block.pMapped);
+            VK_THROW_IF_FAILED(res);
+        }
+
+        mStats.mDeviceAllocations++;
+        mStats.mTotalDeviceAllocations++;
+        mStats.mBytesReserved += size;
+
+        //Reuse slot of previously released block if possible so indexes of alive blocks never change
+        auto& pool = vecPools[poolIndex];
+        for(uint32_t i = 0; i < pool.size(); i++)
+        {
+            if(pool[i].mMemory == VK_NULL_HANDLE)
+            {
+                pool[i] = block;
+                return i;
+            }
+        }
+
+        pool.push_back(block);
+        return pool.size() - 1;
+    }
+
+    void MemoryAllocator::ReleaseBlock(MemoryBlock& block)
+    {
+        if(block.pMapped)
+            vkUnmapMemory(mDevice, block.mMemory);
+
+        vkFreeMemory(mDevice, block.mMemory, nullptr);
+
+        mStats.mDeviceAllocations--;
+        mStats.mBytesReserved -= block.mRanges.GetSize();
+
+        block = MemoryBlock();
+    }
+
+#endif
+}
\ No newline at end of file
@@ -0,0 +1,272 @@
+#include "MeshOptimizer.h"
+#include <algorithm>
+#include <numeric>
+#include <cstring>
+
+namespace Ngine
+{
+#if defined(TARGET_PLATFORM_LINUX)
+
+    struct TriangleCluster
+    {
+        size_t mFirst = 0; //First index
+        size_t mCount = 0; //Index count
+        float mSortKey = 0.0f;
+    };
+
+    void MeshOptimizer::WeldIndices(const void* pVertices, size_t vertexCount, size_t stride, const std::vector<uint32_t>& vecIndices, std::vector<uint32_t>& vecOut)
+    {
+        const char* pBytes = static_cast<const char*>(pVertices);
+
+        std::vector<uint32_t> vecOrder(vertexCount);
+        std::iota(vecOrder.begin(), vecOrder.end(), 0);
+
+        //Equal vertices end up next to each other, ties keep lower index first
+        std::sort(vecOrder.begin(), vecOrder.end(), [&](uint32_t a, uint32_t b)
+        {
+            int result = memcmp(pBytes + a * stride, pBytes + b * stride, stride);
+            return result != 0 ? result < 0 : a < b;
+        });
+
+        std::vector<uint32_t> vecRemap(vertexCount);
+        for(size_t i = 0; i < vertexCount; i++)
+        {
+            bool sameAsPrevious = i > 0 && memcmp(pBytes + vecOrder[i] * stride, pBytes + vecOrder[i - 1] * stride, stride) == 0;
+            vecRemap[vecOrder[i]] = sameAsPrevious ? vecRemap[vecOrder[i - 1]] : vecOrder[i];
+        }
+
+        vecOut.resize(vecIndices.size());
+        for(size_t i = 0; i < vecIndices.size(); i++)
+            vecOut[i] = vecRemap[vecIndices[i]];
+    }
+
+    void MeshOptimizer::OptimizeVertexCache(std::vector<uint32_t>& vecIndices, size_t vertexCount)
+    {
+        size_t triangleCount = vecIndices.size() / 3;
+        if(triangleCount == 0)
+            return;
+
+        //Triangles around every vertex
+        std::vector<uint32_t> vecLive(vertexCount, 0); //Triangles not emitted yet
+        for(size_t i = 0; i < triangleCount * 3; i++)
+            vecLive[vecIndices[i]]++;
+
+        std::vector<uint32_t> vecAdjacencyStart(vertexCount + 1, 0);
+        for(size_t v = 0; v < vertexCount; v++)
+            vecAdjacencyStart[v + 1] = vecAdjacencyStart[v] + vecLive[v];
+
+        std::vector<uint32_t> vecAdjacency(triangleCount * 3);
+        std::vector<uint32_t> vecFill(vecAdjacencyStart.begin(), vecAdjacencyStart.end() - 1);
+        for(size_t i = 0; i < triangleCount * 3; i++)
+            vecAdjacency[vecFill[vecIndices[i]]++] = i / 3;
+
+        std::vector<uint32_t> vecCacheTime(vertexCount, 0);
+        std::vector<uint8_t> vecEmitted(triangleCount, 0);
+        std::vector<uint32_t> vecDeadEnd;
+        std::vector<uint32_t> vecCandidates;
+        std::vector<uint32_t> vecOut;
+        vecOut.reserve(triangleCount * 3);
+
+        uint32_t timestamp = CACHE_SIZE + 1;
+        size_t cursor = 0;
+        int64_t fanning = 0;
+
+        while(fanning >= 0)
+        {
+            vecCandidates.clear();
+
+            for(uint32_t a = vecAdjacencyStart[fanning]; a < vecAdjacencyStart[fanning + 1]; a++)
+            {
+                uint32_t triangle = vecAdjacency[a];
+                if(vecEmitted[triangle])
+                    continue;
+
+                for(int c = 0; c < 3; c++)
+                {
+                    uint32_t v = vecIndices[triangle * 3 + c];
+                    vecOut.push_back(v);
+                    vecDeadEnd.push_back(v);
+                    vecCandidates.push_back(v);
+                    vecLive[v]--;
+
+                    if(timestamp - vecCacheTime[v] > CACHE_SIZE)
+                        vecCacheTime[v] = timestamp++;
+                }
+
+                vecEmitted[triangle] = 1;
+            }
+
+            //Prefer neighbour that stays in cache long enough to emit all of its remaining triangles
+            fanning = -1;
+            int64_t bestPriority = -1;
+
+            for(uint32_t v : vecCandidates)
+            {
+                if(vecLive[v] == 0)
+                    continue;
+
+                int64_t priority = 0;
+                if(timestamp - vecCacheTime[v] + 2 * vecLive[v] <= CACHE_SIZE)
+                    priority = timestamp - vecCacheTime[v];
+
+                if(priority > bestPriority)
+                {
+                    bestPriority = priority;
+                    fanning = v;
+                }
+            }
+
+            //Dead end - go back to recently emitted vertices and then to any vertex with triangles left
+            while(fanning < 0 && !vecDeadEnd.empty())
+            {
+                uint32_t v = vecDeadEnd.back();
+                vecDeadEnd.pop_back();
+
+                if(vecLive[v] > 0)
+                    fanning = v;
+            }
+
+            while(fanning < 0 && cursor < vertexCount)
+            {
+                if(vecLive[cursor] > 0)
+                    fanning = cursor;
+                else
+                    cursor++;
+            }
+        }
+
+        vecIndices.swap(vecOut);
+    }
+
+    void MeshOptimizer::OptimizeOverdraw(std::vector<uint32_t>& vecIndices, const std::vector<glm::vec3>& vecPositions)
+    {
+        size_t triangleCount = vecIndices.size() / 3;
+        if(triangleCount == 0)
+            return;
+
+        //Triangle that misses cache with all three vertices starts a new cluster, moving it does not cost extra misses
+        std::vector<TriangleCluster> vecClusters;
+        std::vector<uint32_t> vecCacheTime(vecPositions.size(), 0);
+        uint32_t timestamp = CACHE_SIZE + 1;
+
+        for(size_t t = 0; t < triangleCount; t++)
+        {
+            int misses = 0;
+            for(int c = 0; c < 3; c++)
+            {
+                uint32_t v = vecIndices[t * 3 + c];
+                if(timestamp - vecCacheTime[v] > CACHE_SIZE)
+                {
+                    vecCacheTime[v] = timestamp++;
+                    misses++;
+                }
+            }
+
+            if(t == 0 || misses == 3)
+                vecClusters.push_back({ t * 3, 0, 0.0f });
+
+            vecClusters.back().mCount += 3;
+        }
+
+        glm::vec3 meshCenter = glm::vec3(0.0f);
+        float meshArea = 0.0f;
+        std::vector<glm::vec3> vecClusterCenter(vecClusters.size(), glm::vec3(0.0f));
+        std::vector<glm::vec3> vecClusterNormal(vecClusters.size(), glm::vec3(0.0f));
+
+        for(size_t c = 0; c < vecClusters.size(); c++)
+        {
+            float clusterArea = 0.0f;
+
+            for(size_t i = vecClusters[c].mFirst; i < vecClusters[c].mFirst + vecClusters[c].mCount; i += 3)
+            {
+                const glm::vec3& p0 = vecPositions[vecIndices[i]];
+                const glm::vec3& p1 = vecPositions[vecIndices[i + 1]];
+                const glm::vec3& p2 = vecPositions[vecIndices[i + 2]];
+
+                //Length of unnormalized normal is twice the area, which weights both sums by triangle size
+                glm::vec3 normal = glm::cross(p1 - p0, p2 - p0);
+                float area = glm::length(normal);
+                glm::vec3 center = (p0 + p1 + p2) / 3.0f;
+
+                vecClusterNormal[c] += normal;
+                vecClusterCenter[c] += center * area;
+                clusterArea += area;
+                meshCenter += center * area;
+                meshArea += area;
+            }
+
+            if(clusterArea > 0.0f)
+                vecClusterCenter[c] /= clusterArea;
+        }
+
+        if(meshArea > 0.0f)
+            meshCenter /= meshArea;
+
+        //Clusters facing away from mesh center are likely to be in front of the rest, so they are drawn first
+        for(size_t c = 0; c < vecClusters.size(); c++)
+        {
+            float length = glm::length(vecClusterNormal[c]);
+            vecClusters[c].mSortKey = length > 0.0f ? glm::dot(vecClusterCenter[c] - meshCenter, vecClusterNormal[c] / length) : 0.0f;
+        }
+
+        std::stable_sort(vecClusters.begin(), vecClusters.end(), [](const TriangleCluster& a, const TriangleCluster& b) { return a.mSortKey > b.mSortKey; });
+
+        std::vector<uint32_t> vecOut;
+        vecOut.reserve(vecIndices.size());
+
+        for(auto& cluster : vecClusters)
+            vecOut.insert(vecOut.end(), vecIndices.begin() + cluster.mFirst, vecIndices.begin() + cluster.mFirst + cluster.mCount);
+
+        vecIndices.swap(vecOut);
+    }
+
+    size_t MeshOptimizer::OptimizeVertexFetch(void* pVertices, size_t vertexCount, size_t stride, std::vector<uint32_t>& vecIndices)
+    {
+        std::vector<uint32_t> vecRemap(vertexCount, UINT32_MAX);
+        uint32_t next = 0;
+
+        for(auto& index : vecIndices)
+        {
+            if(vecRemap[index] == UINT32_MAX)
+                vecRemap[index] = next++;
+
+            index = vecRemap[index];
+        }
+
+        char* pBytes = static_cast<char*>(pVertices);
+        std::vector<char> vecCopy(pBytes, pBytes + vertexCount * stride);
+
+        for(size_t v = 0; v < vertexCount; v++)
+        {
+            if(vecRemap[v] != UINT32_MAX)
+                memcpy(pBytes + vecRemap[v] * stride, vecCopy.data() + v * stride, stride);
+        }
+
+        return next;
+    }
+
+    VertexCacheStats MeshOptimizer::AnalyzeVertexCache(const std::vector<uint32_t>& vecIndices, size_t vertexCount)
+    {
+        VertexCacheStats stats;
+        stats.mTriangles = vecIndices.size() / 3;
+
+        std::vector<uint32_t> vecCacheTime(vertexCount, 0);
+        uint32_t timestamp = CACHE_SIZE + 1;
+
+        for(uint32_t index : vecIndices)
+        {
+            if(vecCacheTime[index] == 0)
+                stats.mVertices++;
+
+            if(timestamp - vecCacheTime[index] > CACHE_SIZE)
+            {
+                vecCacheTime[index] = timestamp++;
+                stats.mMisses++;
+            }
+        }
+
+        return stats;
+    }
+
+#endif
+}
\ No newline at end of file
@@ -0,0 +1,247 @@
+#include "MeshSimplifier.h"
+#include <algorithm>
+#include <numeric>
+#include <unordered_map>
+
+namespace Ngine
+{
+#if defined(TARGET_PLATFORM_LINUX)
+
+    //Symmetric 4x4 matrix of summed plane equations, evaluates to sum of squared distances from those planes
+    struct Quadric
+    {
+        double a2 = 0, ab = 0, ac = 0, ad = 0, b2 = 0, bc = 0, bd = 0, c2 = 0, cd = 0, d2 = 0;
+
+        void AddPlane(double a, double b, double c, double d)
+        {
+            a2 += a * a; ab += a * b; ac += a * c; ad += a * d;
+            b2 += b * b; bc += b * c; bd += b * d;
+            c2 += c * c; cd += c * d;
+            d2 += d * d;
+        }
+
+        void Add(const Quadric& q)
+        {
+            a2 += q.a2; ab += q.ab; ac += q.ac; ad += q.ad;
+            b2 += q.b2; bc += q.bc; bd += q.bd;
+            c2 += q.c2; cd += q.cd;
+            d2 += q.d2;
+        }
+
+        double Evaluate(const glm::vec3& p) const
+        {
+            double x = p.x, y = p.y, z = p.z;
+            double result = a2 * x * x + 2.0 * ab * x * y + 2.0 * ac * x * z + 2.0 * ad * x
+                + b2 * y * y + 2.0 * bc * y * z + 2.0 * bd * y
+                + c2 * z * z + 2.0 * cd * z
+                + d2;
+
+            return std::max(result, 0.0);
+        }
+    };
+
+    struct Collapse
+    {
+        uint32_t mFrom = 0;
+        uint32_t mTo = 0;
+        float mCost = 0.0f; //Squared distance
+    };
+
+    static inline glm::vec3 TriangleNormal(const glm::vec3& p0, const glm::vec3& p1, const glm::vec3& p2)
+    {
+        return glm::cross(p1 - p0, p2 - p0);
+    }
+
+    float MeshSimplifier::Simplify(const std::vector<glm::vec3>& vecPositions, const std::vector<uint32_t>& vecIndices, size_t targetIndexCount, float maxError, std::vector<uint32_t>& vecOut)
+    {
+        size_t vertexCount = vecPositions.size();
+        vecOut = vecIndices;
+
+        std::vector<uint8_t> vecLocked(vertexCount, 0);
+        std::vector<Quadric> vecQuadrics(vertexCount);
+
+        //Vertices that share position with a different vertex sit on an attribute seam
+        std::vector<uint32_t> vecUsed(vecIndices.begin(), vecIndices.end());
+        std::sort(vecUsed.begin(), vecUsed.end());
+        vecUsed.erase(std::unique(vecUsed.begin(), vecUsed.end()), vecUsed.end());
+
+        std::sort(vecUsed.begin(), vecUsed.end(), [&](uint32_t a, uint32_t b)
+        {
+            const glm::vec3& pa = vecPositions[a];
+            const glm::vec3& pb = vecPositions[b];
+            return pa.x != pb.x ? pa.x < pb.x : (pa.y != pb.y ? pa.y < pb.y : pa.z < pb.z);
+        });
+
+        for(size_t i = 1; i < vecUsed.size(); i++)
+        {
+            if(vecPositions[vecUsed[i]] == vecPositions[vecUsed[i - 1]])
+            {
+                vecLocked[vecUsed[i]] = 1;
+                vecLocked[vecUsed[i - 1]] = 1;
+            }
+        }
+
+        //Edges used by single triangle form the border of an open mesh
+        std::unordered_map<uint64_t, uint32_t> mapEdgeUse;
+        for(size_t i = 0; i + 2 < vecOut.size(); i += 3)
+        {
+            for(int e = 0; e < 3; e++)
+            {
+                uint32_t a = vecOut[i + e], b = vecOut[i + (e + 1) % 3];
+                mapEdgeUse[((uint64_t)std::min(a, b) << 32) | std::max(a, b)]++;
+            }
+
+            const glm::vec3& p0 = vecPositions[vecOut[i]];
+            glm::vec3 normal = TriangleNormal(p0, vecPositions[vecOut[i + 1]], vecPositions[vecOut[i + 2]]);
+            float length = glm::length(normal);
+            if(length <= 0.0f)
+                continue;
+
+            normal /= length;
+            for(int v = 0; v < 3; v++)
+                vecQuadrics[vecOut[i + v]].AddPlane(normal.x, normal.y, normal.z, -glm::dot(normal, p0));
+        }
+
+        for(auto& [edge, useCount] : mapEdgeUse)
+        {
+            if(useCount == 1)
+            {
+                vecLocked[edge >> 32] = 1;
+                vecLocked[edge & 0xFFFFFFFF] = 1;
+            }
+        }
+
+        float maxCost = maxError * maxError;
+        float worstCost = 0.0f;
+
+        std::vector<Collapse> vecCandidates;
+        std::vector<uint32_t> vecRemap(vertexCount);
+        std::vector<uint8_t> vecTouched(vertexCount);
+        std::vector<uint32_t> vecAdjacencyStart(vertexCount + 1);
+        std::vector<uint32_t> vecAdjacency;
+
+        //Every pass collapses a batch of cheapest independent edges and then rebuilds the index list
+        while(vecOut.size() > targetIndexCount)
+        {
+            vecCandidates.clear();
+
+            for(size_t i = 0; i + 2 < vecOut.size(); i += 3)
+            {
+                for(int e = 0; e < 3; e++)
+                {
+                    uint32_t a = vecOut[i + e], b = vecOut[i + (e + 1) % 3];
+
+                    //Interior edge is seen from both of its triangles, keep only one direction.
+                    //Border edges are skipped too, but both of their vertices are locked anyway.
+                    if(a > b)
+                        continue;
+
+                    Quadric sum = vecQuadrics[a];
+                    sum.Add(vecQuadrics[b]);
+
+                    Collapse best;
+                    best.mCost = INFINITY;
+
+                    if(!vecLocked[a])
+                        best = { a, b, (float)sum.Evaluate(vecPositions[b]) };
+
+                    if(!vecLocked[b])
+                    {
+                        float cost = (float)sum.Evaluate(vecPositions[a]);
+                        if(cost < best.mCost)
+                            best = { b, a, cost };
+                    }
+
+                    if(best.mCost <= maxCost)
+                        vecCandidates.push_back(best);
+                }
+            }
+
+            if(vecCandidates.empty())
+                break;
+
+            std::sort(vecCandidates.begin(), vecCandidates.end(), [](const Collapse& a, const Collapse& b) { return a.mCost < b.mCost; });
+
+            //Triangles around every vertex, used to reject collapses that would flip a face
+            std::fill(vecAdjacencyStart.begin(), vecAdjacencyStart.end(), 0);
+            for(uint32_t index : vecOut)
+                vecAdjacencyStart[index + 1]++;
+            for(size_t v = 0; v < vertexCount; v++)
+                vecAdjacencyStart[v + 1] += vecAdjacencyStart[v];
+
+            vecAdjacency.resize(vecOut.size());
+            std::vector<uint32_t> vecFill(vecAdjacencyStart.begin(), vecAdjacencyStart.end() - 1);
+            for(size_t i = 0; i < vecOut.size(); i++)
+                vecAdjacency[vecFill[vecOut[i]]++] = i / 3;
+
+            std::iota(vecRemap.begin(), vecRemap.end(), 0);
+            std::fill(vecTouched.begin(), vecTouched.end(), 0);
+
+            size_t trianglesLeft = vecOut.size() / 3;
+            size_t targetTriangles = targetIndexCount / 3;
+            size_t collapsed = 0;
+
+            for(auto& candidate : vecCandidates)
+            {
+                if(vecTouched[candidate.mFrom] || vecTouched[candidate.mTo])
+                    continue;
+
+                bool flips = false;
+                for(uint32_t a = vecAdjacencyStart[candidate.mFrom]; a < vecAdjacencyStart[candidate.mFrom + 1] && !flips; a++)
+                {
+                    const uint32_t* pTri = &vecOut[vecAdjacency[a] * 3];
+                    if(pTri[0] == candidate.mTo || pTri[1] == candidate.mTo || pTri[2] == candidate.mTo)
+                        continue;
+
+                    glm::vec3 before = TriangleNormal(vecPositions[pTri[0]], vecPositions[pTri[1]], vecPositions[pTri[2]]);
+                    glm::vec3 p[3];
+                    for(int v = 0; v < 3; v++)
+                        p[v] = vecPositions[pTri[v] == candidate.mFrom ? candidate.mTo : pTri[v]];
+
+                    flips = glm::dot(before, TriangleNormal(p[0], p[1], p[2])) <= 0.0f;
+                }
+
+                if(flips)
+                    continue;
+
+                //Whole neighbourhood is frozen for the rest of the pass, flip test above would be stale otherwise
+                for(uint32_t a = vecAdjacencyStart[candidate.mFrom]; a < vecAdjacencyStart[candidate.mFrom + 1]; a++)
+                {
+                    const uint32_t* pTri = &vecOut[vecAdjacency[a] * 3];
+                    vecTouched[pTri[0]] = vecTouched[pTri[1]] = vecTouched[pTri[2]] = 1;
+                }
+
+                vecRemap[candidate.mFrom] = candidate.mTo;
+                vecQuadrics[candidate.mTo].Add(vecQuadrics[candidate.mFrom]);
+                worstCost = std::max(worstCost, candidate.mCost);
+                collapsed++;
+
+                //Interior collapse removes two triangles
+                trianglesLeft = trianglesLeft > 2 ? trianglesLeft - 2 : 0;
+                if(trianglesLeft <= targetTriangles)
+                    break;
+            }
+
+            if(collapsed == 0)
+                break;
+
+            size_t write = 0;
+            for(size_t i = 0; i + 2 < vecOut.size(); i += 3)
+            {
+                uint32_t a = vecRemap[vecOut[i]], b = vecRemap[vecOut[i + 1]], c = vecRemap[vecOut[i + 2]];
+                if(a == b || b == c || c == a)
+                    continue;
+
+                vecOut[write++] = a;
+                vecOut[write++] = b;
+                vecOut[write++] = c;
+            }
+
+            vecOut.resize(write);
+        }
+
+        return std::sqrt(worstCost);
+    }
+
+#endif
+}
\ No newline at end of file
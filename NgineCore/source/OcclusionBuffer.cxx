@@ -0,0 +1,306 @@
+#include "OcclusionBuffer.h"
+#include <algorithm>
+#include <cmath>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define NGINE_OCCLUSION_X86
+#endif
+
+namespace Ngine
+{
+#if defined(TARGET_PLATFORM_LINUX)
+
+    //Triangles closer than this are dropped instead of clipped, which only makes culling less aggressive
+    static constexpr float MIN_CLIP_W = 1e-3f;
+
+    void OcclusionBuffer::Initialize(uint32_t width, uint32_t height, ThreadPool* pPool)
+    {
+        pWorkers = pPool;
+        mTilesX = (width + TILE_WIDTH - 1) / TILE_WIDTH;
+        mTilesY = (height + TILE_HEIGHT - 1) / TILE_HEIGHT;
+        mWidth = mTilesX * TILE_WIDTH;
+        mHeight = mTilesY * TILE_HEIGHT;
+
+        vecDepth.resize(mWidth * mHeight, 0.0f);
+        vecTileFarthest.resize(mTilesX * mTilesY, 0.0f);
+        vecTileBins.resize(mTilesX * mTilesY);
+
+        LOG_F(INFO, "Occlusion buffer created (%ux%u, %u tiles)", mWidth, mHeight, mTilesX * mTilesY);
+    }
+
+    void OcclusionBuffer::BeginFrame(const glm::mat4& viewProj)
+    {
+        mViewProj = viewProj;
+        vecTriangles.clear();
+
+        for(auto& bin : vecTileBins)
+            bin.clear();
+    }
+
+    void OcclusionBuffer::AddOccluder(const glm::mat4& world, const std::vector<glm::vec3>& vecPositions, const std::vector<uint32_t>& vecIndices)
+    {
+        glm::mat4 worldViewProj = mViewProj * world;
+
+        for(size_t i = 0; i + 2 < vecIndices.size(); i += 3)
+        {
+            glm::vec4 c0 = worldViewProj * glm::vec4(vecPositions[vecIndices[i]], 1.0f);
+            glm::vec4 c1 = worldViewProj * glm::vec4(vecPositions[vecIndices[i + 1]], 1.0f);
+            glm::vec4 c2 = worldViewProj * glm::vec4(vecPositions[vecIndices[i + 2]], 1.0f);
+
+            if(c0.w < MIN_CLIP_W || c1.w < MIN_CLIP_W || c2.w < MIN_CLIP_W)
+                continue;
+
+            SetupTriangle(c0, c1, c2);
+        }
+    }
+
+    void OcclusionBuffer::SetupTriangle(const glm::vec4& c0, const glm::vec4& c1, const glm::vec4& c2)
+    {
+        glm::vec3 v[3];
+        const glm::vec4* pClip[3] = { &c0, &c1, &c2 };
+
+        for(int i = 0; i < 3; i++)
+        {
+            float invW = 1.0f / pClip[i]->w;
+            v[i].x = (pClip[i]->x * invW * 0.5f + 0.5f) * mWidth;
+            v[i].y = (pClip[i]->y * invW * 0.5f + 0.5f) * mHeight;
+            v[i].z = invW;
+        }
+
+        float area = (v[1].x - v[0].x) * (v[2].y - v[0].y) - (v[1].y - v[0].y) * (v[2].x - v[0].x);
+        if(std::fabs(area) < 1e-6f)
+            return;
+
+        //Occluders are rasterized from both sides, so winding is flipped to a single one
+        if(area < 0.0f)
+        {
+            std::swap(v[1], v[2]);
+            area = -area;
+        }
+
+        ScreenTriangle tri;
+        tri.minX = std::max((int32_t)std::floor(std::min({ v[0].x, v[1].x, v[2].x })), 0);
+        tri.minY = std::max((int32_t)std::floor(std::min({ v[0].y, v[1].y, v[2].y })), 0);
+        tri.maxX = std::min((int32_t)std::ceil(std::max({ v[0].x, v[1].x, v[2].x })), (int32_t)mWidth - 1);
+        tri.maxY = std::min((int32_t)std::ceil(std::max({ v[0].y, v[1].y, v[2].y })), (int32_t)mHeight - 1);
+
+        if(tri.minX > tri.maxX || tri.minY > tri.maxY)
+            return;
+
+        //Edge i is opposite to vertex i, so its function divided by area is barycentric weight of that vertex
+        for(int i = 0; i < 3; i++)
+        {
+            const glm::vec3& a = v[(i + 1) % 3];
+            const glm::vec3& b = v[(i + 2) % 3];
+            tri.edgeA[i] = a.y - b.y;
+            tri.edgeB[i] = b.x - a.x;
+            tri.edgeC[i] = -tri.edgeA[i] * a.x - tri.edgeB[i] * a.y;
+        }
+
+        float invArea = 1.0f / area;
+        tri.depthA = (tri.edgeA[0] * v[0].z + tri.edgeA[1] * v[1].z + tri.edgeA[2] * v[2].z) * invArea;
+        tri.depthB = (tri.edgeB[0] * v[0].z + tri.edgeB[1] * v[1].z + tri.edgeB[2] * v[2].z) * invArea;
+        tri.depthC = (tri.edgeC[0] * v[0].z + tri.edgeC[1] * v[1].z + tri.edgeC[2] * v[2].z) * invArea;
+
+        uint32_t index = vecTriangles.size();
+        vecTriangles.push_back(tri);
+
+        for(uint32_t ty = tri.minY / TILE_HEIGHT; ty <= tri.maxY / TILE_HEIGHT; ty++)
+            for(uint32_t tx = tri.minX / TILE_WIDTH; tx <= tri.maxX / TILE_WIDTH; tx++)
+                vecTileBins[ty * mTilesX + tx].push_back(index);
+    }
+
+    void OcclusionBuffer::Rasterize()
+    {
+        //Tiles never share pixels, so each of them can be filled by a different thread without locking
+        pWorkers->ParallelFor(mTilesX * mTilesY, [this](uint32_t tile) { RasterizeTile(tile); });
+    }
+
+    void OcclusionBuffer::RasterizeTile(uint32_t tile)
+    {
+        int32_t tileX = (tile % mTilesX) * TILE_WIDTH;
+        int32_t tileY = (tile / mTilesX) * TILE_HEIGHT;
+
+        for(uint32_t y = 0; y < TILE_HEIGHT; y++)
+            std::fill_n(&vecDepth[(tileY + y) * mWidth + tileX], TILE_WIDTH, 0.0f);
+
+#if defined(NGINE_OCCLUSION_X86)
+        const __m128 laneOffsets = _mm_setr_ps(0.5f, 1.5f, 2.5f, 3.5f);
+        const __m128 zero = _mm_setzero_ps();
+
+        for(uint32_t index : vecTileBins[tile])
+        {
+            const ScreenTriangle& tri = vecTriangles[index];
+
+            //Start is aligned to 4 pixels, tile origin is aligned too so it never leaves the tile
+            int32_t minX = std::max(tri.minX, tileX) & ~3;
+            int32_t maxX = std::min(tri.maxX, tileX + (int32_t)TILE_WIDTH - 1);
+            int32_t minY = std::max(tri.minY, tileY);
+            int32_t maxY = std::min(tri.maxY, tileY + (int32_t)TILE_HEIGHT - 1);
+
+            __m128 edgeA0 = _mm_set1_ps(tri.edgeA[0]), edgeA1 = _mm_set1_ps(tri.edgeA[1]), edgeA2 = _mm_set1_ps(tri.edgeA[2]);
+            __m128 depthA = _mm_set1_ps(tri.depthA);
+
+            for(int32_t y = minY; y <= maxY; y++)
+            {
+                float pixelY = y + 0.5f;
+                __m128 rowEdge0 = _mm_set1_ps(tri.edgeB[0] * pixelY + tri.edgeC[0]);
+                __m128 rowEdge1 = _mm_set1_ps(tri.edgeB[1] * pixelY + tri.edgeC[1]);
+                __m128 rowEdge2 = _mm_set1_ps(tri.edgeB[2] * pixelY + tri.edgeC[2]);
+                __m128 rowDepth = _mm_set1_ps(tri.depthB * pixelY + tri.depthC);
+                float* pRow = &vecDepth[y * mWidth];
+
+                for(int32_t x = minX; x <= maxX; x += 4)
+                {
+                    __m128 pixelX = _mm_add_ps(_mm_set1_ps((float)x), laneOffsets);
+
+                    __m128 e0 = _mm_add_ps(_mm_mul_ps(edgeA0, pixelX), rowEdge0);
+                    __m128 e1 = _mm_add_ps(_mm_mul_ps(edgeA1, pixelX), rowEdge1);
+                    __m128 e2 = _mm_add_ps(_mm_mul_ps(edgeA2, pixelX), rowEdge2);
+                    __m128 inside = _mm_and_ps(_mm_and_ps(_mm_cmpge_ps(e0, zero), _mm_cmpge_ps(e1, zero)), _mm_cmpge_ps(e2, zero));
+
+                    if(_mm_movemask_ps(inside) == 0)
+                        continue;
+
+                    __m128 depth = _mm_add_ps(_mm_mul_ps(depthA, pixelX), rowDepth);
+                    __m128 stored = _mm_loadu_ps(pRow + x);
+                    __m128 closest = _mm_max_ps(stored, depth);
+                    _mm_storeu_ps(pRow + x, _mm_or_ps(_mm_and_ps(inside, closest), _mm_andnot_ps(inside, stored)));
+                }
+            }
+        }
+
+        __m128 farthest = _mm_set1_ps(INFINITY);
+        for(uint32_t y = 0; y < TILE_HEIGHT; y++)
+        {
+            const float* pRow = &vecDepth[(tileY + y) * mWidth + tileX];
+            for(uint32_t x = 0; x < TILE_WIDTH; x += 4)
+                farthest = _mm_min_ps(farthest, _mm_loadu_ps(pRow + x));
+        }
+
+        alignas(16) float lanes[4];
+        _mm_store_ps(lanes, farthest);
+        vecTileFarthest[tile] = std::min(std::min(lanes[0], lanes[1]), std::min(lanes[2], lanes[3]));
+#else
+        for(uint32_t index : vecTileBins[tile])
+        {
+            const ScreenTriangle& tri = vecTriangles[index];
+            int32_t minX = std::max(tri.minX, tileX);
+            int32_t maxX = std::min(tri.maxX, tileX + (int32_t)TILE_WIDTH - 1);
+            int32_t minY = std::max(tri.minY, tileY);
+            int32_t maxY = std::min(tri.maxY, tileY + (int32_t)TILE_HEIGHT - 1);
+
+            for(int32_t y = minY; y <= maxY; y++)
+            {
+                float pixelY = y + 0.5f;
+                float* pRow = &vecDepth[y * mWidth];
+
+                for(int32_t x = minX; x <= maxX; x++)
+                {
+                    float pixelX = x + 0.5f;
+                    if(tri.edgeA[0] * pixelX + tri.edgeB[0] * pixelY + tri.edgeC[0] < 0.0f ||
+                        tri.edgeA[1] * pixelX + tri.edgeB[1] * pixelY + tri.edgeC[1] < 0.0f ||
+                        tri.edgeA[2] * pixelX + tri.edgeB[2] * pixelY + tri.edgeC[2] < 0.0f)
+                        continue;
+
+                    pRow[x] = std::max(pRow[x], tri.depthA * pixelX + tri.depthB * pixelY + tri.depthC);
+                }
+            }
+        }
+
+        float farthest = INFINITY;
+        for(uint32_t y = 0; y < TILE_HEIGHT; y++)
+        {
+            const float* pRow = &vecDepth[(tileY + y) * mWidth + tileX];
+            farthest = std::min(farthest, *std::min_element(pRow, pRow + TILE_WIDTH));
+        }
+
+        vecTileFarthest[tile] = farthest;
+#endif
+    }
+
+    bool OcclusionBuffer::IsVisible(const glm::vec3& boundsMin, const glm::vec3& boundsMax) const
+    {
+        float minX = INFINITY, minY = INFINITY, maxX = -INFINITY, maxY = -INFINITY;
+        float nearest = 0.0f;
+
+        for(int i = 0; i < 8; i++)
+        {
+            glm::vec3 corner = glm::vec3(i & 1 ? boundsMax.x : boundsMin.x, i & 2 ? boundsMax.y : boundsMin.y, i & 4 ? boundsMax.z : boundsMin.z);
+            glm::vec4 clip = mViewProj * glm::vec4(corner, 1.0f);
+
+            if(clip.w < MIN_CLIP_W)
+                return true;
+
+            float invW = 1.0f / clip.w;
+            float x = (clip.x * invW * 0.5f + 0.5f) * mWidth;
+            float y = (clip.y * invW * 0.5f + 0.5f) * mHeight;
+
+            minX = std::min(minX, x);
+            minY = std::min(minY, y);
+            maxX = std::max(maxX, x);
+            maxY = std::max(maxY, y);
+            nearest = std::max(nearest, invW);
+        }
+
+        //Only pixel centers inside of the projected box are tested, same rule as for occluders
+        int32_t x0 = std::max((int32_t)std::floor(minX), 0);
+        int32_t y0 = std::max((int32_t)std::floor(minY), 0);
+        int32_t x1 = std::min((int32_t)std::ceil(maxX), (int32_t)mWidth - 1);
+        int32_t y1 = std::min((int32_t)std::ceil(maxY), (int32_t)mHeight - 1);
+
+        //Outside of the screen is frustum culling's job
+        if(x0 > x1 || y0 > y1)
+            return true;
+
+#if defined(NGINE_OCCLUSION_X86)
+        const __m128 nearestDepth = _mm_set1_ps(nearest);
+        const __m128 laneOffsets = _mm_setr_ps(0.0f, 1.0f, 2.0f, 3.0f);
+        const __m128 firstX = _mm_set1_ps((float)x0);
+        const __m128 lastX = _mm_set1_ps((float)x1);
+
+#endif
+
+        for(int32_t ty = y0 / TILE_HEIGHT; ty <= y1 / (int32_t)TILE_HEIGHT; ty++)
+        {
+            for(int32_t tx = x0 / TILE_WIDTH; tx <= x1 / (int32_t)TILE_WIDTH; tx++)
+            {
+                //Whole tile is covered by something closer than the nearest point of the box
+                if(vecTileFarthest[ty * mTilesX + tx] > nearest)
+                    continue;
+
+                int32_t startX = std::max(x0, tx * (int32_t)TILE_WIDTH) & ~3;
+                int32_t endX = std::min(x1, (tx + 1) * (int32_t)TILE_WIDTH - 1);
+                int32_t startY = std::max(y0, ty * (int32_t)TILE_HEIGHT);
+                int32_t endY = std::min(y1, (ty + 1) * (int32_t)TILE_HEIGHT - 1);
+
+                for(int32_t y = startY; y <= endY; y++)
+                {
+                    const float* pRow = &vecDepth[y * mWidth];
+#if defined(NGINE_OCCLUSION_X86)
+                    for(int32_t x = startX; x <= endX; x += 4)
+                    {
+                        __m128 pixelX = _mm_add_ps(_mm_set1_ps((float)x), laneOffsets);
+                        __m128 inRange = _mm_and_ps(_mm_cmpge_ps(pixelX, firstX), _mm_cmple_ps(pixelX, lastX));
+                        __m128 uncovered = _mm_cmple_ps(_mm_loadu_ps(pRow + x), nearestDepth);
+
+                        if(_mm_movemask_ps(_mm_and_ps(inRange, uncovered)) != 0)
+                            return true;
+                    }
+#else
+                    for(int32_t x = std::max(startX, x0); x <= endX; x++)
+                    {
+                        if(pRow[x] <= nearest)
+                            return true;
+                    }
+#endif
+                }
+            }
+        }
+
+        return false;
+    }
+
+#endif
+}
\ No newline at end of file
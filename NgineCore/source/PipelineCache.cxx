@@ -0,0 +1,221 @@
+#include "PipelineCache.h"
+#include "Exception.h"
+#include <fstream>
+
+namespace Ngine
+{
+#if defined(TARGET_PLATFORM_LINUX)
+
+    void PipelineCache::Initialize(VkDevice device, VkPhysicalDevice physDevice, const std::string& path)
+    {
+        mDevice = device;
+        mPath = path;
+        vkGetPhysicalDeviceProperties(physDevice, &mDeviceProps);
+
+        std::vector<char> vecData;
+        mWarm = LoadFile(vecData);
+
+        VkPipelineCacheCreateInfo cacheInfo = {};
+        cacheInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+        cacheInfo.initialDataSize = mWarm ? vecData.size() : 0;
+        cacheInfo.pInitialData = mWarm ? vecData.data() : nullptr;
+
+        VkResult res = vkCreatePipelineCache(mDevice, &cacheInfo, nullptr, &mCache);
+
+        //Driver may still refuse data that passed our checks, empty cache is always accepted
+        if(res != VK_SUCCESS && mWarm)
+        {
+            LOG_F(WARNING, "Driver rejected pipeline cache %s (EC = %d), starting with empty cache", mPath.c_str(), res);
+            mWarm = false;
+            mLoadedHash = 0;
+            cacheInfo.initialDataSize = 0;
+            cacheInfo.pInitialData = nullptr;
+            res = vkCreatePipelineCache(mDevice, &cacheInfo, nullptr, &mCache);
+        }
+
+        VK_THROW_IF_FAILED(res);
+
+        if(mWarm)
+            LOG_F(INFO, "Pipeline cache loaded from %s (%zu KB)", mPath.c_str(), vecData.size() >> 10);
+    }
+
+    void PipelineCache::Destroy()
+    {
+        if(mCache == VK_NULL_HANDLE)
+            return;
+
+        Save();
+
+        LOG_IF_F(INFO, mCreateCount > 0, "Pipeline creation took %.2f ms for %u pipelines, warm cache saved about %.2f ms",
+            mCreateMs, mCreateCount, mSavedMs);
+
+        vkDestroyPipelineCache(mDevice, mCache, nullptr);
+        mCache = VK_NULL_HANDLE;
+    }
+
+    void PipelineCache::Save()
+    {
+        size_t dataSize = 0;
+        VkResult res = vkGetPipelineCacheData(mDevice, mCache, &dataSize, nullptr);
+        if(res != VK_SUCCESS || dataSize == 0)
+            return;
+
+        std::vector<char> vecData(dataSize);
+        res = vkGetPipelineCacheData(mDevice, mCache, &dataSize, vecData.data());
+        if(res != VK_SUCCESS)
+        {
+            LOG_F(WARNING, "Cannot read pipeline cache data (EC = %d), cache is not saved", res);
+            return;
+        }
+
+        vecData.resize(dataSize);
+
+        //First run without a cache measured full compilation cost, later runs keep that measurement
+        PipelineCacheFileHeader header;
+        header.mMagic = FILE_MAGIC;
+        header.mVersion = FILE_VERSION;
+        header.mDataSize = dataSize;
+        header.mDataHash = Hash(vecData.data(), dataSize);
+        header.mColdMsPerPipeline = mColdMsPerPipeline;
+
+        if(!mWarm && mCreateCount > 0)
+            header.mColdMsPerPipeline = (float)(mCreateMs / mCreateCount);
+
+        if(mWarm && header.mDataHash == mLoadedHash)
+            return;
+
+        std::string tempPath = mPath + ".tmp";
+        std::ofstream file(tempPath, std::ios::binary | std::ios::trunc);
+        if(!file.is_open())
+        {
+            LOG_F(WARNING, "Cannot open %s for writing, pipeline cache is not saved", tempPath.c_str());
+            return;
+        }
+
+        file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        file.write(vecData.data(), vecData.size());
+        file.close();
+
+        if(file.fail())
+        {
+            LOG_F(WARNING, "Writing %s failed, pipeline cache is not saved", tempPath.c_str());
+            std::filesystem::remove(tempPath);
+            return;
+        }
+
+        //Rename replaces old file in one step, readers see either the old or the new cache
+        std::error_code ec;
+        std::filesystem::rename(tempPath, mPath, ec);
+        if(ec)
+        {
+            LOG_F(WARNING, "Cannot replace %s (%s), pipeline cache is not saved", mPath.c_str(), ec.message().c_str());
+            std::filesystem::remove(tempPath, ec);
+            return;
+        }
+
+        LOG_F(INFO, "Pipeline cache saved to %s (%zu KB)", mPath.c_str(), dataSize >> 10);
+    }
+
+    double PipelineCache::RecordCreation(double ms, uint32_t pipelineCount)
+    {
+        mCreateMs += ms;
+        mCreateCount += pipelineCount;
+
+        if(!mWarm || mColdMsPerPipeline <= 0.0f)
+            return 0.0;
+
+        double saved = std::max(mColdMsPerPipeline * pipelineCount - ms, 0.0);
+        mSavedMs += saved;
+        return saved;
+    }
+
+    bool PipelineCache::LoadFile(std::vector<char>& outData)
+    {
+        std::ifstream file(mPath, std::ios::ate | std::ios::binary);
+        if(!file.is_open())
+        {
+            LOG_F(INFO, "No pipeline cache at %s, pipelines will be compiled from scratch", mPath.c_str());
+            return false;
+        }
+
+        size_t fileSize = (size_t)file.tellg();
+        file.seekg(0);
+
+        PipelineCacheFileHeader header;
+        if(fileSize < sizeof(header) || !file.read(reinterpret_cast<char*>(&header), sizeof(header)))
+        {
+            LOG_F(WARNING, "Pipeline cache %s is truncated, it will be rebuilt", mPath.c_str());
+            return false;
+        }
+
+        if(header.mMagic != FILE_MAGIC || header.mVersion != FILE_VERSION || header.mDataSize != fileSize - sizeof(header))
+        {
+            LOG_F(WARNING, "Pipeline cache %s has unknown format or wrong size, it will be rebuilt", mPath.c_str());
+            return false;
+        }
+
+        outData.resize(header.mDataSize);
+        if(!file.read(outData.data(), outData.size()) || Hash(outData.data(), outData.size()) != header.mDataHash)
+        {
+            LOG_F(WARNING, "Pipeline cache %s is corrupted, it will be rebuilt", mPath.c_str());
+            return false;
+        }
+
+        if(!IsCompatible(outData))
+            return false;
+
+        mLoadedHash = header.mDataHash;
+        mColdMsPerPipeline = header.mColdMsPerPipeline;
+        return true;
+    }
+
+    bool PipelineCache::IsCompatible(const std::vector<char>& data) const
+    {
+        //VkPipelineCacheHeaderVersionOne, read field by field since the driver blob has no alignment guarantees
+        uint32_t headerSize = 0, headerVersion = 0, vendorId = 0, deviceId = 0;
+        uint8_t uuid[VK_UUID_SIZE];
+
+        if(data.size() < 16 + VK_UUID_SIZE)
+        {
+            LOG_F(WARNING, "Pipeline cache %s has no driver header, it will be rebuilt", mPath.c_str());
+            return false;
+        }
+
+        memcpy(&headerSize, data.data(), sizeof(uint32_t));
+        memcpy(&headerVersion, data.data() + 4, sizeof(uint32_t));
+        memcpy(&vendorId, data.data() + 8, sizeof(uint32_t));
+        memcpy(&deviceId, data.data() + 12, sizeof(uint32_t));
+        memcpy(uuid, data.data() + 16, VK_UUID_SIZE);
+
+        if(headerSize < 16 + VK_UUID_SIZE || headerSize > data.size() || headerVersion != VK_PIPELINE_CACHE_HEADER_VERSION_ONE)
+        {
+            LOG_F(WARNING, "Pipeline cache %s has invalid driver header, it will be rebuilt", mPath.c_str());
+            return false;
+        }
+
+        //Different GPU or driver update, data would be ignored or rejected by the driver anyway
+        if(vendorId != mDeviceProps.vendorID || deviceId != mDeviceProps.deviceID || memcmp(uuid, mDeviceProps.pipelineCacheUUID, VK_UUID_SIZE) != 0)
+        {
+            LOG_F(INFO, "Pipeline cache %s was created by different device or driver, it will be rebuilt", mPath.c_str());
+            return false;
+        }
+
+        return true;
+    }
+
+    uint64_t PipelineCache::Hash(const void* pData, size_t size)
+    {
+        const uint8_t* pBytes = static_cast<const uint8_t*>(pData);
+        uint64_t hash = 14695981039346656037ull;
+
+        for(size_t i = 0; i < size; i++)
+        {
+            hash ^= pBytes[i];
+            hash *= 1099511628211ull;
+        }
+
+        return hash;
+    }
+
+#endif
+}
\ No newline at end of file
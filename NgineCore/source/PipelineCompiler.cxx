@@ -0,0 +1,87 @@
+#include "PipelineCompiler.h"
+#include <chrono>
+
+namespace Ngine
+{
+#if defined(TARGET_PLATFORM_LINUX)
+
+    void PipelineCompiler::Initialize(uint32_t threadCount)
+    {
+        mStop = false;
+
+        for(uint32_t i = 0; i < threadCount; i++)
+            vecThreads.emplace_back(&PipelineCompiler::WorkerLoop, this);
+
+        LOG_F(INFO, "Pipeline compiler created with %u threads", threadCount);
+    }
+
+    void PipelineCompiler::Destroy()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+            mStop = true;
+            LOG_IF_F(INFO, !mQueue.empty(), "Dropping %zu pipeline compile jobs that did not start", mQueue.size());
+            mQueue.clear();
+        }
+
+        mWake.notify_all();
+
+        for(auto& thread : vecThreads)
+            thread.join();
+
+        vecThreads.clear();
+    }
+
+    uint64_t PipelineCompiler::Submit(const std::function<VkResult(VkPipeline&)>& compile)
+    {
+        Job job;
+        job.mCompile = compile;
+
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+            job.mTicket = mNextTicket++;
+            mQueue.push_back(job);
+        }
+
+        mWake.notify_one();
+        return job.mTicket;
+    }
+
+    void PipelineCompiler::Collect(std::vector<PipelineCompileResult>& outResults)
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        outResults.insert(outResults.end(), vecResults.begin(), vecResults.end());
+        vecResults.clear();
+    }
+
+    void PipelineCompiler::WorkerLoop()
+    {
+        while(true)
+        {
+            Job job;
+
+            {
+                std::unique_lock<std::mutex> lock(mMutex);
+                mWake.wait(lock, [this]() { return mStop || !mQueue.empty(); });
+
+                if(mStop)
+                    return;
+
+                job = mQueue.front();
+                mQueue.pop_front();
+            }
+
+            PipelineCompileResult result;
+            result.mTicket = job.mTicket;
+
+            auto start = std::chrono::high_resolution_clock::now();
+            result.mResult = job.mCompile(result.mPipeline);
+            result.mCompileMs = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+
+            std::lock_guard<std::mutex> lock(mMutex);
+            vecResults.push_back(result);
+        }
+    }
+
+#endif
+}
\ No newline at end of file
@@ -0,0 +1,701 @@
+#include "RenderGraph.h"
+#include "Exception.h"
+#include <algorithm>
+#include <fstream>
+
+namespace Ngine
+{
+#if defined(TARGET_PLATFORM_LINUX)
+
+    //Stage, access and layout of every RenderGraphUsage in declaration order
+    struct UsageInfo
+    {
+        VkPipelineStageFlags mStages;
+        VkAccessFlags mAccess;
+        VkImageLayout mLayout;
+        bool mWrite;
+        const char* pName;
+    };
+
+    static const UsageInfo usageInfos[(uint32_t)RenderGraphUsage::Count] =
+    {
+        { VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, true, "ColorAttachment" },
+        { VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT, VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL, true, "DepthAttachment" },
+        { VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT, VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT, VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL, false, "DepthRead" },
+        { VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, false, "Sampled" },
+        { VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT, VK_IMAGE_LAYOUT_GENERAL, false, "ComputeRead" },
+        { VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT, VK_IMAGE_LAYOUT_GENERAL, true, "ComputeWrite" },
+        { VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_READ_BIT, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, false, "TransferSrc" },
+        { VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, true, "TransferDst" },
+        { VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT, VK_ACCESS_INDIRECT_COMMAND_READ_BIT, VK_IMAGE_LAYOUT_UNDEFINED, false, "IndirectRead" },
+        { VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT, VK_IMAGE_LAYOUT_UNDEFINED, false, "VertexRead" },
+    };
+
+    //Only these have to be made available by a barrier, read bits in source scope do nothing
+    static const VkAccessFlags writeAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT |
+                                                 VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_TRANSFER_WRITE_BIT;
+
+    void RenderGraph::Initialize(VkDevice device, MemoryAllocator* pAllocator)
+    {
+        mDevice = device;
+        this->pAllocator = pAllocator;
+    }
+
+    void RenderGraph::Destroy()
+    {
+        //Device is idle by now, so nothing waits for the frame that retired them
+        RetireTransients();
+        for(auto& retired : vecRetired)
+            DestroyRetired(retired);
+
+        vecRetired.clear();
+        vecTransients.clear();
+        Reset();
+    }
+
+    void RenderGraph::BeginFrame(uint32_t frameIndex)
+    {
+        mFrameIndex = frameIndex;
+
+        //Frames recorded before repacking used other slots or this one, all of them are finished now
+        for(auto it = vecRetired.begin(); it != vecRetired.end();)
+        {
+            if(it->mFrameIndex == frameIndex)
+            {
+                DestroyRetired(*it);
+                it = vecRetired.erase(it);
+            }
+            else
+                it++;
+        }
+    }
+
+    void RenderGraph::Reset()
+    {
+        vecResources.clear();
+        vecPasses.clear();
+        mFinalBarriers = Pass();
+
+        for(auto& transient : vecTransients)
+            transient.mUsed = false;
+    }
+
+    RenderGraphHandle RenderGraph::ImportImage(const char* name, VkImage image, VkImageView view, VkImageAspectFlags aspect, VkPipelineStageFlags readyStage)
+    {
+        Resource resource;
+        resource.mName = name;
+        resource.mIsImage = true;
+        resource.mImage = image;
+        resource.mView = view;
+        resource.mAspect = aspect;
+        resource.mReadyStage = readyStage;
+        vecResources.push_back(resource);
+
+        return (RenderGraphHandle)(vecResources.size() - 1);
+    }
+
+    RenderGraphHandle RenderGraph::ImportBuffer(const char* name, VkBuffer buffer)
+    {
+        Resource resource;
+        resource.mName = name;
+        resource.mBuffer = buffer;
+        vecResources.push_back(resource);
+
+        return (RenderGraphHandle)(vecResources.size() - 1);
+    }
+
+    RenderGraphHandle RenderGraph::CreateImage(const char* name, const RenderGraphImageDesc& desc)
+    {
+        //Same name in the next frame refers to the same image, only changed description recreates it
+        uint32_t transientIndex = 0;
+        while(transientIndex < vecTransients.size() && vecTransients[transientIndex].mName != name)
+            transientIndex++;
+
+        if(transientIndex == vecTransients.size())
+        {
+            TransientImage transient;
+            transient.mName = name;
+            vecTransients.push_back(transient);
+            mTransientsDirty = true;
+        }
+
+        TransientImage& transient = vecTransients[transientIndex];
+        if(transient.mDesc.mFormat != desc.mFormat || transient.mDesc.mExtent.width != desc.mExtent.width ||
+           transient.mDesc.mExtent.height != desc.mExtent.height || transient.mDesc.mUsage != desc.mUsage ||
+           transient.mDesc.mAspect != desc.mAspect)
+        {
+            transient.mDesc = desc;
+            mTransientsDirty = true;
+        }
+        transient.mUsed = true;
+
+        Resource resource;
+        resource.mName = name;
+        resource.mIsImage = true;
+        resource.mTransient = true;
+        resource.mAspect = desc.mAspect;
+        resource.mTransientIndex = transientIndex;
+        vecResources.push_back(resource);
+
+        return (RenderGraphHandle)(vecResources.size() - 1);
+    }
+
+    void RenderGraph::MarkOutput(RenderGraphHandle resource, VkImageLayout finalLayout)
+    {
+        vecResources[resource].mOutput = true;
+        vecResources[resource].mFinalLayout = finalLayout;
+    }
+
+    uint32_t RenderGraph::AddPass(const char* name, const std::function<void(VkCommandBuffer)>& execute)
+    {
+        Pass pass;
+        pass.mName = name;
+        pass.mExecute = execute;
+        vecPasses.push_back(pass);
+
+        return (uint32_t)(vecPasses.size() - 1);
+    }
+
+    void RenderGraph::Read(uint32_t pass, RenderGraphHandle resource, RenderGraphUsage usage)
+    {
+        if(!CanRead(usage))
+            LOG_F(WARNING, "Pass %s reads %s with write only usage %s", vecPasses[pass].mName.c_str(), vecResources[resource].mName.c_str(), GetUsageName(usage));
+
+        vecPasses[pass].vecAccesses.push_back({ resource, usage, false });
+    }
+
+    void RenderGraph::Write(uint32_t pass, RenderGraphHandle resource, RenderGraphUsage usage)
+    {
+        if(!IsWrite(usage))
+            LOG_F(WARNING, "Pass %s writes %s with read usage %s", vecPasses[pass].mName.c_str(), vecResources[resource].mName.c_str(), GetUsageName(usage));
+
+        vecPasses[pass].vecAccesses.push_back({ resource, usage, true });
+    }
+
+    void RenderGraph::Compile()
+    {
+        //Transient memory is only measured when it is packed
+        RenderGraphStats stats;
+        stats.mTransientBytes = mStats.mTransientBytes;
+        stats.mTransientBytesUnaliased = mStats.mTransientBytesUnaliased;
+        mStats = stats;
+        mStats.mPasses = (uint32_t)vecPasses.size();
+
+        CullPasses();
+
+        //Lifetimes span from first to last pass that survived culling
+        for(uint32_t passIndex = 0; passIndex < vecPasses.size(); passIndex++)
+        {
+            if(vecPasses[passIndex].mCulled)
+                continue;
+
+            for(auto& access : vecPasses[passIndex].vecAccesses)
+            {
+                Resource& resource = vecResources[access.mResource];
+                resource.mFirstPass = std::min(resource.mFirstPass, passIndex);
+                resource.mLastPass = std::max(resource.mLastPass, passIndex);
+            }
+        }
+
+        for(auto& resource : vecResources)
+        {
+            if(!resource.mTransient)
+                continue;
+
+            TransientImage& transient = vecTransients[resource.mTransientIndex];
+            if(resource.mFirstPass == UINT32_MAX)
+            {
+                //Only culled passes touch it this frame
+                transient.mUsed = false;
+                continue;
+            }
+
+            transient.mFirstPass = resource.mFirstPass;
+            transient.mLastPass = resource.mLastPass;
+        }
+
+        if(mTransientsDirty || TransientsNeedPacking())
+            AllocateTransients();
+
+        for(auto& resource : vecResources)
+        {
+            if(resource.mTransient)
+            {
+                resource.mImage = vecTransients[resource.mTransientIndex].mImage;
+                resource.mView = vecTransients[resource.mTransientIndex].mView;
+            }
+        }
+
+        PlaceBarriers();
+    }
+
+    void RenderGraph::Execute(VkCommandBuffer cmdBuffer)
+    {
+        for(auto& pass : vecPasses)
+        {
+            if(pass.mCulled)
+                continue;
+
+            if(!pass.vecImageBarriers.empty() || !pass.vecBufferBarriers.empty())
+            {
+                vkCmdPipelineBarrier(cmdBuffer, pass.mSrcStages, pass.mDstStages, 0, 0, nullptr,
+                                     (uint32_t)pass.vecBufferBarriers.size(), pass.vecBufferBarriers.data(),
+                                     (uint32_t)pass.vecImageBarriers.size(), pass.vecImageBarriers.data());
+            }
+
+            if(pass.mExecute)
+                pass.mExecute(cmdBuffer);
+        }
+
+        if(!mFinalBarriers.vecImageBarriers.empty())
+        {
+            vkCmdPipelineBarrier(cmdBuffer, mFinalBarriers.mSrcStages, mFinalBarriers.mDstStages, 0, 0, nullptr, 0, nullptr,
+                                 (uint32_t)mFinalBarriers.vecImageBarriers.size(), mFinalBarriers.vecImageBarriers.data());
+        }
+    }
+
+    bool RenderGraph::Dump(const std::string& path) const
+    {
+        std::ofstream file(path, std::ios::trunc);
+        if(!file.is_open())
+        {
+            LOG_F(ERROR, "Cannot write render graph to %s", path.c_str());
+            return false;
+        }
+
+        file << "digraph RenderGraph {\n";
+        file << "    rankdir=LR;\n";
+
+        for(uint32_t passIndex = 0; passIndex < vecPasses.size(); passIndex++)
+        {
+            const Pass& pass = vecPasses[passIndex];
+            file << "    pass" << passIndex << " [shape=box, label=\"" << pass.mName;
+            if(pass.mCulled)
+                file << "\\nculled\", style=dashed];\n";
+            else
+                file << "\\n" << pass.vecImageBarriers.size() << " image / " << pass.vecBufferBarriers.size() << " buffer barriers\"];\n";
+        }
+
+        for(uint32_t resourceIndex = 0; resourceIndex < vecResources.size(); resourceIndex++)
+        {
+            const Resource& resource = vecResources[resourceIndex];
+            file << "    res" << resourceIndex << " [shape=ellipse, label=\"" << resource.mName;
+            if(resource.mTransient)
+                file << "\\ntransient @" << vecTransients[resource.mTransientIndex].mOffset;
+            file << "\"" << (resource.mOutput ? ", peripheries=2" : "") << "];\n";
+        }
+
+        for(uint32_t passIndex = 0; passIndex < vecPasses.size(); passIndex++)
+        {
+            for(auto& access : vecPasses[passIndex].vecAccesses)
+            {
+                if(access.mWrite)
+                    file << "    pass" << passIndex << " -> res" << access.mResource;
+                else
+                    file << "    res" << access.mResource << " -> pass" << passIndex;
+
+                file << " [label=\"" << GetUsageName(access.mUsage) << "\"];\n";
+            }
+        }
+
+        file << "}\n";
+        return true;
+    }
+
+    VkImageView RenderGraph::GetImageView(RenderGraphHandle resource) const
+    {
+        const Resource& res = vecResources[resource];
+        if(res.mTransient)
+            return vecTransients[res.mTransientIndex].mView;
+
+        return res.mView;
+    }
+
+    void RenderGraph::CullPasses()
+    {
+        //Walk backwards from outputs, pass stays when something it writes is read later or is an output
+        std::vector<bool> vecNeeded(vecResources.size(), false);
+        for(uint32_t resourceIndex = 0; resourceIndex < vecResources.size(); resourceIndex++)
+            vecNeeded[resourceIndex] = vecResources[resourceIndex].mOutput;
+
+        for(uint32_t passIndex = (uint32_t)vecPasses.size(); passIndex-- > 0;)
+        {
+            Pass& pass = vecPasses[passIndex];
+
+            bool live = false;
+            for(auto& access : pass.vecAccesses)
+            {
+                if(access.mWrite && vecNeeded[access.mResource])
+                    live = true;
+            }
+
+            pass.mCulled = !live;
+            if(!live)
+            {
+                mStats.mCulledPasses++;
+                continue;
+            }
+
+            for(auto& access : pass.vecAccesses)
+            {
+                if(!access.mWrite)
+                    vecNeeded[access.mResource] = true;
+            }
+        }
+    }
+
+    bool RenderGraph::LifetimesOverlap(const TransientImage& a, const TransientImage& b)
+    {
+        return a.mFirstPass <= b.mLastPass && b.mFirstPass <= a.mLastPass;
+    }
+
+    bool RenderGraph::MemoryOverlaps(const TransientImage& a, const TransientImage& b)
+    {
+        return a.mOffset < b.mOffset + b.mMemReq.size && b.mOffset < a.mOffset + a.mMemReq.size;
+    }
+
+    bool RenderGraph::TransientsNeedPacking() const
+    {
+        //Current placement stays valid as long as no two images sharing memory are alive at once
+        for(uint32_t i = 0; i < vecTransients.size(); i++)
+        {
+            if(!vecTransients[i].mUsed)
+                continue;
+
+            for(uint32_t j = i + 1; j < vecTransients.size(); j++)
+            {
+                if(vecTransients[j].mUsed && MemoryOverlaps(vecTransients[i], vecTransients[j]) && LifetimesOverlap(vecTransients[i], vecTransients[j]))
+                    return true;
+            }
+        }
+
+        return false;
+    }
+
+    void RenderGraph::AllocateTransients()
+    {
+        //Images can be bound to memory only once, new placement means new images.
+        //Old ones are kept until frames in flight that recorded them are finished
+        RetireTransients();
+
+        VkMemoryRequirements memReq = {};
+        memReq.memoryTypeBits = UINT32_MAX;
+        mStats.mTransientBytes = 0;
+        mStats.mTransientBytesUnaliased = 0;
+
+        for(auto& transient : vecTransients)
+        {
+            VkImageCreateInfo imageInfo = {};
+            imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+            imageInfo.imageType = VK_IMAGE_TYPE_2D;
+            imageInfo.format = transient.mDesc.mFormat;
+            imageInfo.extent = { transient.mDesc.mExtent.width, transient.mDesc.mExtent.height, 1 };
+            imageInfo.mipLevels = 1;
+            imageInfo.arrayLayers = 1;
+            imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+            imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+            imageInfo.usage = transient.mDesc.mUsage;
+            imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+            imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+            VkResult res = vkCreateImage(mDevice, &imageInfo, nullptr, &transient.mImage);
+            VK_THROW_IF_FAILED(res);
+
+            vkGetImageMemoryRequirements(mDevice, transient.mImage, &transient.mMemReq);
+            memReq.alignment = std::max(memReq.alignment, transient.mMemReq.alignment);
+            memReq.memoryTypeBits &= transient.mMemReq.memoryTypeBits;
+            mStats.mTransientBytesUnaliased += transient.mMemReq.size;
+        }
+
+        if(vecTransients.empty())
+        {
+            mTransientsDirty = false;
+            return;
+        }
+
+        if(memReq.memoryTypeBits == 0)
+        {
+            LOG_F(ERROR, "Transient images have no memory type in common");
+            throw Exception();
+        }
+
+        //Largest first, each goes to the lowest offset not used by an image alive at the same time
+        std::vector<uint32_t> vecOrder(vecTransients.size());
+        for(uint32_t i = 0; i < vecOrder.size(); i++)
+            vecOrder[i] = i;
+        std::sort(vecOrder.begin(), vecOrder.end(), [this](uint32_t a, uint32_t b) { return vecTransients[a].mMemReq.size > vecTransients[b].mMemReq.size; });
+
+        for(uint32_t placedCount = 0; placedCount < vecOrder.size(); placedCount++)
+        {
+            TransientImage& transient = vecTransients[vecOrder[placedCount]];
+            transient.mOffset = 0;
+
+            bool moved = true;
+            while(moved)
+            {
+                moved = false;
+                for(uint32_t i = 0; i < placedCount; i++)
+                {
+                    const TransientImage& placed = vecTransients[vecOrder[i]];
+                    if(LifetimesOverlap(transient, placed) && MemoryOverlaps(transient, placed))
+                    {
+                        VkDeviceSize alignment = transient.mMemReq.alignment;
+                        transient.mOffset = (placed.mOffset + placed.mMemReq.size + alignment - 1) / alignment * alignment;
+                        moved = true;
+                    }
+                }
+            }
+
+            memReq.size = std::max(memReq.size, transient.mOffset + transient.mMemReq.size);
+        }
+
+        mTransientAlloc = pAllocator->Allocate(memReq, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, true);
+        mStats.mTransientBytes = memReq.size;
+
+        for(auto& transient : vecTransients)
+        {
+            VkResult res = vkBindImageMemory(mDevice, transient.mImage, mTransientAlloc.mMemory, mTransientAlloc.mOffset + transient.mOffset);
+            VK_THROW_IF_FAILED(res);
+
+            VkImageViewCreateInfo viewInfo = {};
+            viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+            viewInfo.image = transient.mImage;
+            viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+            viewInfo.format = transient.mDesc.mFormat;
+            viewInfo.subresourceRange.aspectMask = transient.mDesc.mAspect;
+            viewInfo.subresourceRange.baseMipLevel = 0;
+            viewInfo.subresourceRange.levelCount = 1;
+            viewInfo.subresourceRange.baseArrayLayer = 0;
+            viewInfo.subresourceRange.layerCount = 1;
+
+            res = vkCreateImageView(mDevice, &viewInfo, nullptr, &transient.mView);
+            VK_THROW_IF_FAILED(res);
+        }
+
+        LOG_F(INFO, "Render graph placed %u transient images in %llu KB (%llu KB without aliasing)", (uint32_t)vecTransients.size(),
+              (unsigned long long)(mStats.mTransientBytes / 1024), (unsigned long long)(mStats.mTransientBytesUnaliased / 1024));
+
+        mTransientsDirty = false;
+    }
+
+    void RenderGraph::RetireTransients()
+    {
+        RetiredTransients retired;
+        retired.mFrameIndex = mFrameIndex;
+        retired.mAlloc = mTransientAlloc;
+
+        for(auto& transient : vecTransients)
+        {
+            if(transient.mView != VK_NULL_HANDLE)
+                retired.vecViews.push_back(transient.mView);
+            if(transient.mImage != VK_NULL_HANDLE)
+                retired.vecImages.push_back(transient.mImage);
+
+            transient.mView = VK_NULL_HANDLE;
+            transient.mImage = VK_NULL_HANDLE;
+            transient.mState = ResourceState();
+        }
+
+        mTransientAlloc = Allocation();
+
+        if(!retired.vecImages.empty() || retired.mAlloc.mMemory != VK_NULL_HANDLE)
+            vecRetired.push_back(std::move(retired));
+    }
+
+    void RenderGraph::DestroyRetired(RetiredTransients& retired)
+    {
+        for(auto view : retired.vecViews)
+            vkDestroyImageView(mDevice, view, nullptr);
+        for(auto image : retired.vecImages)
+            vkDestroyImage(mDevice, image, nullptr);
+
+        if(retired.mAlloc.mMemory != VK_NULL_HANDLE)
+            pAllocator->Free(retired.mAlloc);
+
+        retired = RetiredTransients();
+    }
+
+    void RenderGraph::PlaceBarriers()
+    {
+        for(uint32_t passIndex = 0; passIndex < vecPasses.size(); passIndex++)
+        {
+            Pass& pass = vecPasses[passIndex];
+            if(pass.mCulled)
+                continue;
+
+            //Accesses of one resource are merged so read-modify-write in a single pass gets one barrier
+            std::map<RenderGraphHandle, UsageInfo> mapMerged;
+            for(auto& access : pass.vecAccesses)
+            {
+                const UsageInfo& info = usageInfos[(uint32_t)access.mUsage];
+                auto it = mapMerged.find(access.mResource);
+                if(it == mapMerged.end())
+                {
+                    mapMerged[access.mResource] = info;
+                    continue;
+                }
+
+                it->second.mStages |= info.mStages;
+                it->second.mAccess |= info.mAccess;
+                it->second.mWrite |= info.mWrite;
+                if(it->second.mLayout != info.mLayout)
+                    it->second.mLayout = VK_IMAGE_LAYOUT_GENERAL;
+            }
+
+            for(auto& [handle, info] : mapMerged)
+            {
+                Resource& resource = vecResources[handle];
+
+                if(resource.mFirstPass == passIndex)
+                {
+                    if(resource.mTransient)
+                    {
+                        //Contents are discarded, only previous users of the same memory have to finish
+                        const TransientImage& transient = vecTransients[resource.mTransientIndex];
+                        for(auto& other : vecTransients)
+                        {
+                            if(other.mImage != VK_NULL_HANDLE && MemoryOverlaps(transient, other))
+                            {
+                                resource.mState.mReadStages |= other.mState.mWriteStages | other.mState.mReadStages;
+                                resource.mState.mWriteAccess |= other.mState.mWriteAccess;
+                            }
+                        }
+                    }
+                    else if(resource.mIsImage)
+                    {
+                        resource.mState.mReadStages = resource.mReadyStage;
+                    }
+                    resource.mState.mLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+                }
+
+                AddBarrier(pass, resource, resource.mState, info.mStages, info.mAccess, info.mLayout, info.mWrite);
+
+                if(resource.mTransient)
+                    vecTransients[resource.mTransientIndex].mState = resource.mState;
+            }
+        }
+
+        for(auto& resource : vecResources)
+        {
+            if(!resource.mOutput || !resource.mIsImage || resource.mFinalLayout == VK_IMAGE_LAYOUT_UNDEFINED ||
+               resource.mFirstPass == UINT32_MAX || resource.mState.mLayout == resource.mFinalLayout)
+                continue;
+
+            AddBarrier(mFinalBarriers, resource, resource.mState, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, resource.mFinalLayout, false);
+        }
+
+        if(!mFinalBarriers.vecImageBarriers.empty())
+            mStats.mBarrierBatches++;
+    }
+
+    void RenderGraph::AddBarrier(Pass& pass, Resource& resource, ResourceState& state, VkPipelineStageFlags stages, VkAccessFlags access, VkImageLayout layout, bool write)
+    {
+        bool layoutChange = resource.mIsImage && state.mLayout != layout;
+
+        VkPipelineStageFlags srcStages = 0;
+        VkAccessFlags srcAccess = 0;
+        if(write || layoutChange)
+        {
+            //Writes and transitions wait for the last write and for everyone who read since then
+            srcStages = state.mWriteStages | state.mReadStages;
+            srcAccess = state.mWriteAccess;
+        }
+        else if(state.mWriteStages != 0 && ((stages & ~state.mVisibleStages) != 0 || (access & ~state.mVisibleAccess) != 0))
+        {
+            //Read after write, skipped when an earlier reader already made the write visible to these stages
+            srcStages = state.mWriteStages;
+            srcAccess = state.mWriteAccess;
+        }
+
+        bool needed = layoutChange || srcStages != 0;
+        if(needed)
+        {
+            if(pass.vecImageBarriers.empty() && pass.vecBufferBarriers.empty())
+                mStats.mBarrierBatches++;
+
+            if(resource.mIsImage)
+            {
+                VkImageMemoryBarrier barrier = {};
+                barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+                barrier.srcAccessMask = srcAccess;
+                barrier.dstAccessMask = access;
+                barrier.oldLayout = state.mLayout;
+                barrier.newLayout = layout;
+                barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+                barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+                barrier.image = resource.mImage;
+                barrier.subresourceRange.aspectMask = resource.mAspect;
+                barrier.subresourceRange.baseMipLevel = 0;
+                barrier.subresourceRange.levelCount = 1;
+                barrier.subresourceRange.baseArrayLayer = 0;
+                barrier.subresourceRange.layerCount = 1;
+                pass.vecImageBarriers.push_back(barrier);
+                mStats.mImageBarriers++;
+            }
+            else
+            {
+                VkBufferMemoryBarrier barrier = {};
+                barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+                barrier.srcAccessMask = srcAccess;
+                barrier.dstAccessMask = access;
+                barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+                barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+                barrier.buffer = resource.mBuffer;
+                barrier.offset = 0;
+                barrier.size = VK_WHOLE_SIZE;
+                pass.vecBufferBarriers.push_back(barrier);
+                mStats.mBufferBarriers++;
+            }
+
+            pass.mSrcStages |= srcStages != 0 ? srcStages : VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
+            pass.mDstStages |= stages;
+        }
+
+        if(write)
+        {
+            state.mWriteStages = stages;
+            state.mWriteAccess = access & writeAccessMask;
+            state.mReadStages = 0;
+            state.mVisibleStages = 0;
+            state.mVisibleAccess = 0;
+        }
+        else if(layoutChange)
+        {
+            //Transition counts as a write that this reader already waited for, readers in other stages still have to
+            state.mWriteStages = stages;
+            state.mWriteAccess = 0;
+            state.mReadStages = 0;
+            state.mVisibleStages = stages;
+            state.mVisibleAccess = access;
+        }
+        else
+        {
+            state.mReadStages |= stages;
+            if(needed)
+            {
+                state.mVisibleStages |= stages;
+                state.mVisibleAccess |= access;
+            }
+        }
+
+        if(resource.mIsImage)
+            state.mLayout = layout;
+    }
+
+    bool RenderGraph::IsWrite(RenderGraphUsage usage)
+    {
+        return usageInfos[(uint32_t)usage].mWrite;
+    }
+
+    bool RenderGraph::CanRead(RenderGraphUsage usage)
+    {
+        //Attachments read what they blend or test against, so they can be read as well as written
+        return (usageInfos[(uint32_t)usage].mAccess & ~writeAccessMask) != 0;
+    }
+
+    const char* RenderGraph::GetUsageName(RenderGraphUsage usage)
+    {
+        return usageInfos[(uint32_t)usage].pName;
+    }
+#endif
+}
\ No newline at end of file
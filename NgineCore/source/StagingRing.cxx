@@ -0,0 +1,188 @@
+#include "StagingRing.h"
+#include "Exception.h"
+
+namespace Ngine
+{
+#if defined(TARGET_PLATFORM_LINUX)
+
+    void StagingRing::Initialize(VkDevice device, MemoryAllocator* pAlloc, VkDeviceSize size)
+    {
+        mDevice = device;
+        pAllocator = pAlloc;
+        mSize = size;
+
+        VkBufferCreateInfo bufferInfo = {};
+        bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+        bufferInfo.size = size;
+        bufferInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+        bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+        VkResult res = vkCreateBuffer(mDevice, &bufferInfo, nullptr, &mBuffer);
+        VK_THROW_IF_FAILED(res);
+
+        VkMemoryRequirements memReq;
+        vkGetBufferMemoryRequirements(mDevice, mBuffer, &memReq);
+
+        mAlloc = pAllocator->Allocate(memReq, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+
+        res = vkBindBufferMemory(mDevice, mBuffer, mAlloc.mMemory, mAlloc.mOffset);
+        VK_THROW_IF_FAILED(res);
+
+        LOG_F(INFO, "Staging ring created (%llu KB)", (unsigned long long)(size >> 10));
+    }
+
+    void StagingRing::Destroy()
+    {
+        //Caller is expected to wait for device idle before destroying the ring
+        for(auto& submission : dqSubmissions)
+        {
+            for(auto& fallback : submission.vecFallbacks)
+            {
+                vkDestroyBuffer(mDevice, fallback.mBuffer, nullptr);
+                pAllocator->Free(fallback.mAlloc);
+            }
+        }
+
+        for(auto& fallback : vecPendingFallbacks)
+        {
+            vkDestroyBuffer(mDevice, fallback.mBuffer, nullptr);
+            pAllocator->Free(fallback.mAlloc);
+        }
+
+        dqSubmissions.clear();
+        vecPendingFallbacks.clear();
+
+        if(mBuffer != VK_NULL_HANDLE)
+            vkDestroyBuffer(mDevice, mBuffer, nullptr);
+
+        pAllocator->Free(mAlloc);
+        mBuffer = VK_NULL_HANDLE;
+    }
+
+    StagingRegion StagingRing::Allocate(VkDeviceSize size, VkDeviceSize alignment)
+    {
+        //Upload that would never fit into the ring gets its own temporary buffer
+        if(size > mSize)
+            return AllocateFallback(size);
+
+        while(true)
+        {
+            //Nothing is in use - start again from the beginning so big uploads don't have to wrap
+            if(mUsed == 0)
+                mHead = 0;
+
+            VkDeviceSize aligned = (mHead + alignment - 1) / alignment * alignment;
+            VkDeviceSize padding = aligned - mHead;
+
+            //Not enough space before the end of the ring - skip the rest of it and wrap around
+            if(aligned + size > mSize)
+            {
+                aligned = 0;
+                padding = mSize - mHead;
+            }
+
+            if(mUsed + padding + size <= mSize)
+            {
+                StagingRegion region;
+                region.mBuffer = mBuffer;
+                region.mOffset = aligned;
+                region.pData = static_cast<char*>(mAlloc.pMapped) + aligned;
+
+                mHead = aligned + size;
+                mUsed += padding + size;
+                mPendingBytes += padding + size;
+                return region;
+            }
+
+            //Ring is full - try to release memory of finished uploads, if nothing can be released wait for the oldest one
+            size_t inFlight = dqSubmissions.size();
+            Reclaim();
+
+            if(dqSubmissions.size() == inFlight && !WaitForOldestSubmission())
+            {
+                //All of the space is taken by data that hasn't been submitted yet
+                return AllocateFallback(size);
+            }
+        }
+    }
+
+    void StagingRing::Retire(VkFence fence)
+    {
+        if(mPendingBytes == 0 && vecPendingFallbacks.empty())
+            return;
+
+        Submission submission;
+        submission.mFence = fence;
+        submission.mBytes = mPendingBytes;
+        submission.vecFallbacks = std::move(vecPendingFallbacks);
+        dqSubmissions.push_back(std::move(submission));
+
+        mPendingBytes = 0;
+        vecPendingFallbacks.clear();
+    }
+
+    void StagingRing::Reclaim()
+    {
+        //Submissions are retired in order so the oldest ones are at the front
+        while(!dqSubmissions.empty() && vkGetFenceStatus(mDevice, dqSubmissions.front().mFence) == VK_SUCCESS)
+        {
+            Submission& submission = dqSubmissions.front();
+            mUsed -= submission.mBytes;
+
+            for(auto& fallback : submission.vecFallbacks)
+            {
+                vkDestroyBuffer(mDevice, fallback.mBuffer, nullptr);
+                pAllocator->Free(fallback.mAlloc);
+            }
+
+            dqSubmissions.pop_front();
+        }
+    }
+
+    bool StagingRing::WaitForOldestSubmission()
+    {
+        if(dqSubmissions.empty())
+            return false;
+
+        VkResult res = vkWaitForFences(mDevice, 1, &dqSubmissions.front().mFence, VK_TRUE, UINT64_MAX);
+        VK_THROW_IF_FAILED(res);
+
+        Reclaim();
+        return true;
+    }
+
+    StagingRegion StagingRing::AllocateFallback(VkDeviceSize size)
+    {
+        FallbackBuffer fallback;
+
+        VkBufferCreateInfo bufferInfo = {};
+        bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+        bufferInfo.size = size;
+        bufferInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+        bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+        VkResult res = vkCreateBuffer(mDevice, &bufferInfo, nullptr, &fallback.mBuffer);
+        VK_THROW_IF_FAILED(res);
+
+        VkMemoryRequirements memReq;
+        vkGetBufferMemoryRequirements(mDevice, fallback.mBuffer, &memReq);
+
+        fallback.mAlloc = pAllocator->Allocate(memReq, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+
+        res = vkBindBufferMemory(mDevice, fallback.mBuffer, fallback.mAlloc.mMemory, fallback.mAlloc.mOffset);
+        VK_THROW_IF_FAILED(res);
+
+        LOG_F(WARNING, "Upload of %llu KB does not fit into staging ring, using temporary buffer", (unsigned long long)(size >> 10));
+        mFallbackCount++;
+
+        StagingRegion region;
+        region.mBuffer = fallback.mBuffer;
+        region.mOffset = 0;
+        region.pData = fallback.mAlloc.pMapped;
+
+        vecPendingFallbacks.push_back(fallback);
+        return region;
+    }
+
+#endif
+}
\ No newline at end of file
@@ -0,0 +1,92 @@
+#include "ThreadPool.h"
+
+namespace Ngine
+{
+#if defined(TARGET_PLATFORM_LINUX)
+
+    void ThreadPool::Initialize(uint32_t workerCount)
+    {
+        mStop = false;
+
+        for(uint32_t i = 0; i < workerCount; i++)
+            vecThreads.emplace_back(&ThreadPool::WorkerLoop, this);
+
+        LOG_F(INFO, "Thread pool created with %u workers", workerCount);
+    }
+
+    void ThreadPool::Destroy()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+            mStop = true;
+        }
+
+        mWake.notify_all();
+
+        for(auto& thread : vecThreads)
+            thread.join();
+
+        vecThreads.clear();
+    }
+
+    void ThreadPool::ParallelFor(uint32_t count, const std::function<void(uint32_t)>& job)
+    {
+        //Waking workers costs more than running single job inline
+        if(vecThreads.empty() || count <= 1)
+        {
+            for(uint32_t i = 0; i < count; i++)
+                job(i);
+
+            return;
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+            pJob = &job;
+            mCount = count;
+            mNextIndex = 0;
+            mBusyWorkers = vecThreads.size();
+            mGeneration++;
+        }
+
+        mWake.notify_all();
+        RunJobs();
+
+        //Every worker has to check in before the job goes out of scope
+        std::unique_lock<std::mutex> lock(mMutex);
+        mDone.wait(lock, [this]() { return mBusyWorkers == 0; });
+        pJob = nullptr;
+    }
+
+    void ThreadPool::WorkerLoop()
+    {
+        uint64_t seenGeneration = 0;
+
+        while(true)
+        {
+            std::unique_lock<std::mutex> lock(mMutex);
+            mWake.wait(lock, [&]() { return mStop || mGeneration != seenGeneration; });
+
+            if(mStop)
+                return;
+
+            seenGeneration = mGeneration;
+            lock.unlock();
+
+            RunJobs();
+
+            lock.lock();
+            if(--mBusyWorkers == 0)
+                mDone.notify_one();
+        }
+    }
+
+    void ThreadPool::RunJobs()
+    {
+        uint32_t index;
+        while((index = mNextIndex.fetch_add(1)) < mCount)
+            (*pJob)(index);
+    }
+
+#endif
+}
\ No newline at end of file
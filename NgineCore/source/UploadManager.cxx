@@ -0,0 +1,291 @@
+#include "UploadManager.h"
+#include "Exception.h"
+
+namespace Ngine
+{
+#if defined(TARGET_PLATFORM_LINUX)
+
+    void UploadManager::Initialize(VkDevice device, VkQueue queue, uint32_t queueFamily, uint32_t dstQueueFamily, StagingRing* pStagingRing, uint32_t batchCount)
+    {
+        mDevice = device;
+        mQueue = queue;
+        mSrcQueueFamily = queueFamily;
+        mDstQueueFamily = dstQueueFamily;
+        pRing = pStagingRing;
+
+        VkCommandPoolCreateInfo cmdPoolInfo = {};
+        cmdPoolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+        cmdPoolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT | VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+        cmdPoolInfo.queueFamilyIndex = queueFamily;
+
+        VkResult res = vkCreateCommandPool(mDevice, &cmdPoolInfo, nullptr, &mCmdPool);
+        VK_THROW_IF_FAILED(res);
+
+        vecBatches.resize(batchCount);
+
+        std::vector<VkCommandBuffer> vecCmdBuffers(batchCount);
+
+        VkCommandBufferAllocateInfo allocInfo = {};
+        allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+        allocInfo.commandPool = mCmdPool;
+        allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+        allocInfo.commandBufferCount = batchCount;
+
+        res = vkAllocateCommandBuffers(mDevice, &allocInfo, vecCmdBuffers.data());
+        VK_THROW_IF_FAILED(res);
+
+        VkFenceCreateInfo fenceInfo = {};
+        fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+        fenceInfo.flags = VK_FENCE_CREATE_SIGNALED_BIT;
+
+        for(uint32_t i = 0; i < batchCount; i++)
+        {
+            vecBatches[i].mCmdBuffer = vecCmdBuffers[i];
+
+            res = vkCreateFence(mDevice, &fenceInfo, nullptr, &vecBatches[i].mFence);
+            VK_THROW_IF_FAILED(res);
+        }
+
+        LOG_F(INFO, "Upload manager created with %u batches on queue family %u%s", batchCount, queueFamily, UsesOwnershipTransfer() ? " (dedicated transfer queue)" : "");
+    }
+
+    void UploadManager::Destroy()
+    {
+        //Caller is expected to wait for device idle before destroying upload manager
+        for(auto& batch : vecBatches)
+            vkDestroyFence(mDevice, batch.mFence, nullptr);
+
+        vecBatches.clear();
+
+        if(mCmdPool != VK_NULL_HANDLE)
+            vkDestroyCommandPool(mDevice, mCmdPool, nullptr);
+
+        mCmdPool = VK_NULL_HANDLE;
+    }
+
+    uint64_t UploadManager::Upload(VkBuffer dst, VkDeviceSize dstOffset, const void* pData, VkDeviceSize size)
+    {
+        //Keep single batch below half of the ring so there is always room left for the next one
+        if(mOpenBatch.has_value() && mBatchBytes + size > pRing->GetSize() / 2)
+            Flush();
+
+        Batch& batch = BeginBatch();
+
+        StagingRegion staging = pRing->Allocate(size);
+        memcpy(staging.pData, pData, (size_t)size);
+
+        VkBufferCopy copyRegion = {};
+        copyRegion.srcOffset = staging.mOffset;
+        copyRegion.dstOffset = dstOffset;
+        copyRegion.size = size;
+
+        vkCmdCopyBuffer(batch.mCmdBuffer, staging.mBuffer, dst, 1, &copyRegion);
+
+        if(UsesOwnershipTransfer())
+            AddOwnershipBarrier(batch, dst, dstOffset, size);
+
+        batch.mCopyCount++;
+        mBatchBytes += size;
+        mStats.mCopies++;
+        mStats.mBytes += size;
+
+        return batch.mTicket;
+    }
+
+    uint64_t UploadManager::Flush()
+    {
+        if(!mOpenBatch.has_value())
+            return mSubmittedTicket;
+
+        Batch& batch = vecBatches[mOpenBatch.value()];
+
+        if(UsesOwnershipTransfer())
+        {
+            //Release half of queue family ownership transfer, destination access is defined by acquire on graphics queue
+            std::vector<VkBufferMemoryBarrier> vecRelease = batch.vecOwnershipBarriers;
+            for(auto& barrier : vecRelease)
+                barrier.dstAccessMask = 0;
+
+            vkCmdPipelineBarrier(batch.mCmdBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0, nullptr, vecRelease.size(), vecRelease.data(), 0, nullptr);
+        }
+        else
+        {
+            //Make copied data visible to vertex input of every later submission on this queue
+            VkMemoryBarrier barrier = {};
+            barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+            barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+            barrier.dstAccessMask = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_INDEX_READ_BIT;
+
+            vkCmdPipelineBarrier(batch.mCmdBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+        }
+
+        VkResult res = vkEndCommandBuffer(batch.mCmdBuffer);
+        VK_THROW_IF_FAILED(res);
+
+        VkSubmitInfo submitInfo = {};
+        submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+        submitInfo.commandBufferCount = 1;
+        submitInfo.pCommandBuffers = &batch.mCmdBuffer;
+
+        res = vkQueueSubmit(mQueue, 1, &submitInfo, batch.mFence);
+        VK_THROW_IF_FAILED(res);
+
+        //Staging memory used by this batch is released once its fence is signaled
+        pRing->Retire(batch.mFence);
+
+        batch.mInFlight = true;
+        mSubmittedTicket = batch.mTicket;
+        mStats.mBatches++;
+
+        mOpenBatch.reset();
+        mNextBatch = (mNextBatch + 1) % vecBatches.size();
+        mBatchBytes = 0;
+
+        return mSubmittedTicket;
+    }
+
+    void UploadManager::Update()
+    {
+        Flush();
+        Poll();
+    }
+
+    void UploadManager::RecordAcquireBarriers(VkCommandBuffer cmdBuffer)
+    {
+        if(!vecPendingAcquires.empty())
+        {
+            //Acquire half of ownership transfer - recorded only after release batch fence was observed
+            for(auto& barrier : vecPendingAcquires)
+                barrier.srcAccessMask = 0;
+
+            vkCmdPipelineBarrier(cmdBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, 0, 0, nullptr, vecPendingAcquires.size(), vecPendingAcquires.data(), 0, nullptr);
+            vecPendingAcquires.clear();
+        }
+
+        mCompletedTicket = mFinishedTicket;
+    }
+
+    bool UploadManager::IsComplete(uint64_t ticket)
+    {
+        if(ticket <= mCompletedTicket)
+            return true;
+
+        Poll();
+        return ticket <= mCompletedTicket;
+    }
+
+    void UploadManager::Wait(uint64_t ticket)
+    {
+        if(IsComplete(ticket))
+            return;
+
+        //Copies that are still being recorded have to be submitted first
+        if(ticket > mSubmittedTicket)
+            Flush();
+
+        for(auto& batch : vecBatches)
+        {
+            if(batch.mInFlight && batch.mTicket <= ticket)
+            {
+                VkResult res = vkWaitForFences(mDevice, 1, &batch.mFence, VK_TRUE, UINT64_MAX);
+                VK_THROW_IF_FAILED(res);
+            }
+        }
+
+        Poll();
+    }
+
+    UploadManager::Batch& UploadManager::BeginBatch()
+    {
+        if(mOpenBatch.has_value())
+            return vecBatches[mOpenBatch.value()];
+
+        Batch& batch = vecBatches[mNextBatch];
+
+        //All batches are in flight - wait for the oldest one
+        if(batch.mInFlight)
+        {
+            VkResult res = vkWaitForFences(mDevice, 1, &batch.mFence, VK_TRUE, UINT64_MAX);
+            VK_THROW_IF_FAILED(res);
+            Poll();
+        }
+
+        //Staging ring still references the fence until it reclaims memory of the finished batch
+        pRing->Reclaim();
+
+        VkResult res = vkResetFences(mDevice, 1, &batch.mFence);
+        VK_THROW_IF_FAILED(res);
+
+        res = vkResetCommandBuffer(batch.mCmdBuffer, 0);
+        VK_THROW_IF_FAILED(res);
+
+        VkCommandBufferBeginInfo beginInfo = {};
+        beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+        beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+        res = vkBeginCommandBuffer(batch.mCmdBuffer, &beginInfo);
+        VK_THROW_IF_FAILED(res);
+
+        batch.mTicket = mNextTicket++;
+        batch.mCopyCount = 0;
+        batch.vecOwnershipBarriers.clear();
+        mOpenBatch = mNextBatch;
+
+        return batch;
+    }
+
+    void UploadManager::Poll()
+    {
+        for(auto& batch : vecBatches)
+        {
+            if(batch.mInFlight && vkGetFenceStatus(mDevice, batch.mFence) == VK_SUCCESS)
+            {
+                batch.mInFlight = false;
+
+                //Batches are submitted to a single queue so they finish in order
+                if(batch.mTicket > mFinishedTicket)
+                    mFinishedTicket = batch.mTicket;
+
+                if(UsesOwnershipTransfer())
+                {
+                    vecPendingAcquires.insert(vecPendingAcquires.end(), batch.vecOwnershipBarriers.begin(), batch.vecOwnershipBarriers.end());
+                    batch.vecOwnershipBarriers.clear();
+                }
+            }
+        }
+
+        //Without ownership transfer finished batch can be used right away
+        if(!UsesOwnershipTransfer())
+            mCompletedTicket = mFinishedTicket;
+
+        pRing->Reclaim();
+    }
+
+    void UploadManager::AddOwnershipBarrier(Batch& batch, VkBuffer dst, VkDeviceSize offset, VkDeviceSize size)
+    {
+        //Copies into neighbouring ranges of the same buffer share single barrier
+        if(!batch.vecOwnershipBarriers.empty())
+        {
+            VkBufferMemoryBarrier& last = batch.vecOwnershipBarriers.back();
+            if(last.buffer == dst && last.offset + last.size == offset)
+            {
+                last.size += size;
+                return;
+            }
+        }
+
+        VkBufferMemoryBarrier barrier = {};
+        barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+        barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.dstAccessMask = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_INDEX_READ_BIT;
+        barrier.srcQueueFamilyIndex = mSrcQueueFamily;
+        barrier.dstQueueFamilyIndex = mDstQueueFamily;
+        barrier.buffer = dst;
+        barrier.offset = offset;
+        barrier.size = size;
+
+        batch.vecOwnershipBarriers.push_back(barrier);
+    }
+
+#endif
+}
\ No newline at end of file
@@ -2,6 +2,7 @@
 #include "Event.h"
 #include "FileUtils.h"
 #include "GameObject.h"
+#include <random>
 
 Game::Game()
 {
@@ -29,8 +30,57 @@ Game::Game()
 	};
 
 	mModel = pGfxCore->CreateModelFromVertexList(vertices, indices);
+
+	//Optional load benchmark - creates a lot of small meshes and reports how many device allocations they cost
+	int benchMeshCount = Ngine::FileUtils::GetIntegerFromConfig("Resource/ngine.ini", "Benchmark", "LoadMeshCount");
+	if(benchMeshCount > 0)
+	{
+		uint32_t lastModel = 0;
+		auto benchStart = std::chrono::high_resolution_clock::now();
+		for(int i = 0; i < benchMeshCount; i++)
+			lastModel = pGfxCore->CreateModelFromVertexList(vertices, indices);
+		double benchTime = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - benchStart).count();
+
+		//Uploads finish in order so the last model being ready means all of them are
+		pGfxCore->WaitForModel(lastModel);
+		double readyTime = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - benchStart).count();
+
+		Ngine::AllocatorStats stats = pGfxCore->GetMemoryStats();
+		Ngine::UploadStats uploadStats = pGfxCore->GetUploadStats();
+		LOG_F(WARNING, "Load benchmark: %d meshes in %.2f ms (ready after %.2f ms), %u device allocations, %u suballocations", benchMeshCount, benchTime, readyTime, stats.mDeviceAllocations, stats.mSubAllocations);
+		LOG_F(WARNING, "Load benchmark: %u copies submitted in %u upload batches", uploadStats.mCopies, uploadStats.mBatches);
+	}
 	mModel2 = pGfxCore->LoadIntermediateModel("cube.fbx");
 
+	//Optional streaming benchmark - measures frame time jitter while meshes are uploaded mid-game
+	mStreamFrames = Ngine::FileUtils::GetIntegerFromConfig("Resource/ngine.ini", "Benchmark", "StreamFrames");
+	mStreamMeshesPerFrame = Ngine::FileUtils::GetIntegerFromConfig("Resource/ngine.ini", "Benchmark", "StreamMeshesPerFrame");
+	if(mStreamMeshesPerFrame <= 0)
+		mStreamMeshesPerFrame = 1;
+
+	if(mStreamFrames > 0)
+	{
+		//128x128 vertex grid (~500 KB of vertex data per mesh)
+		const int gridSize = 128;
+		for(int y = 0; y < gridSize; y++)
+		{
+			for(int x = 0; x < gridSize; x++)
+				vecStreamVertices.push_back({{x / (float)gridSize, 0.0f, y / (float)gridSize}, {1.0f, 1.0f, 1.0f}, {x / (float)gridSize, y / (float)gridSize}});
+		}
+
+		for(int y = 0; y < gridSize - 1; y++)
+		{
+			for(int x = 0; x < gridSize - 1; x++)
+			{
+				uint16_t i0 = y * gridSize + x;
+				uint16_t i1 = i0 + 1;
+				uint16_t i2 = i0 + gridSize;
+				uint16_t i3 = i2 + 1;
+				vecStreamIndices.insert(vecStreamIndices.end(), {i0, i2, i1, i1, i2, i3});
+			}
+		}
+	}
+
 	pObject = new Ngine::GameObject3D(mModel, mShader);
 	pObject2 = new Ngine::GameObject3D(mModel2, mShader);
 	pGfxCore->AddGameObjectToDrawList(pObject2);
@@ -38,12 +88,61 @@ Game::Game()
 	pGfxCore->Temp_SetCamera(glm::vec3(0,0,0));
 	//pObject2->SetScale(glm::vec3(10.0f, 10.0f, 10.0f));
 
+	//Optional object benchmark - compares per object uniform data with push constants
+	mObjectBenchCount = Ngine::FileUtils::GetIntegerFromConfig("Resource/ngine.ini", "Benchmark", "ObjectCount");
+	mObjectBenchFrames = Ngine::FileUtils::GetIntegerFromConfig("Resource/ngine.ini", "Benchmark", "ObjectFrames");
+	if(mObjectBenchFrames <= 0)
+		mObjectBenchFrames = 300;
+
+	if(mObjectBenchCount > 0)
+	{
+		mPushShader = pGfxCore->LoadShader("Resource/Shader/push_vert.spv", "Resource/Shader/push_frag.spv");
+		SpawnBenchmarkObjects(mModel, mShader, mObjectBenchCount);
+	}
+
+	//Optional instance benchmark - draws cube.fbx many times with and without hardware instancing
+	mInstanceBenchCount = Ngine::FileUtils::GetIntegerFromConfig("Resource/ngine.ini", "Benchmark", "InstancedCubeCount");
+	if(mInstanceBenchCount > 0)
+	{
+		mInstancedShader = pGfxCore->LoadShader("Resource/Shader/instanced_vert.spv", "Resource/Shader/instanced_frag.spv");
+
+		if(mObjectBenchCount <= 0)
+			SpawnBenchmarkObjects(mModel2, mPushShader != 0 ? mPushShader : mShader, mInstanceBenchCount);
+	}
+
+	//Optional record benchmark - runs after the other object benchmarks, needs secondary buffer recording enabled
+	mRecordBenchCount = Ngine::FileUtils::GetIntegerFromConfig("Resource/ngine.ini", "Benchmark", "RecordObjectCount");
+	if(mRecordBenchCount > 0 && !pGfxCore->UsesParallelRecording())
+	{
+		LOG_F(WARNING, "Record benchmark: [General] ParallelRecording is disabled, benchmark skipped");
+		mRecordBenchCount = 0;
+	}
+
+	//Optional overdraw benchmark - runs last, needs pre-pass pipelines and fragment invocation queries
+	mOverdrawBenchCount = Ngine::FileUtils::GetIntegerFromConfig("Resource/ngine.ini", "Benchmark", "OverdrawObjectCount");
+	if(mOverdrawBenchCount > 0 && (!pGfxCore->HasDepthPrepass() || !pGfxCore->HasPipelineStatistics()))
+	{
+		LOG_F(WARNING, "Overdraw benchmark: [General] DepthPrepass and PipelineStatistics are both needed, benchmark skipped");
+		mOverdrawBenchCount = 0;
+	}
+
 	mCamera.SetProjectionValues(60.0f, 1920/(float)1080, 0.01f, 1000.0f);
 	//mCamera.SetPosition(glm::vec3(2.0f, 2.0f, 2.0f));
+
+	//Optional culling microbenchmark - throughput of vectorized frustum test compared to scalar one
+	int cullObjectCount = Ngine::FileUtils::GetIntegerFromConfig("Resource/ngine.ini", "Benchmark", "CullObjectCount");
+	if(cullObjectCount > 0)
+		RunCullingBenchmark(cullObjectCount);
+
+	//Optional spatial tree benchmark - cost of keeping the tree up to date when 10% of objects move every frame
+	int bvhObjectCount = Ngine::FileUtils::GetIntegerFromConfig("Resource/ngine.ini", "Benchmark", "BvhObjectCount");
+	if(bvhObjectCount > 0)
+		RunSpatialTreeBenchmark(bvhObjectCount);
 }
 
 Game::~Game()
 {
+	DespawnBenchmarkObjects();
 }
 
 void Game::Run()
@@ -52,8 +151,289 @@ void Game::Run()
 	{
 		ManageEvents();
 		pGfxCore->SetCamera(mCamera);
+		pGfxCore->UpdateOcclusion();
 		pGfxCore->DrawFrame(pWindow);
+
+		if(mStreamFrames > 0)
+			UpdateStreamingBenchmark();
+
+		if(mObjectBenchCount > 0)
+			UpdateObjectBenchmark();
+		else if(mInstanceBenchCount > 0)
+			UpdateInstanceBenchmark();
+		else if(mRecordBenchCount > 0)
+			UpdateRecordBenchmark();
+		else if(mOverdrawBenchCount > 0)
+			UpdateOverdrawBenchmark();
+	}
+}
+
+void Game::UpdateStreamingBenchmark()
+{
+	mFrameIndex++;
+
+	//First half of the benchmark measures idle frames, second half uploads new meshes every frame
+	if(mFrameIndex == mStreamFrames || mFrameIndex == mStreamFrames * 2)
+	{
+		Ngine::FrameStats stats = pGfxCore->GetFrameStats();
+		LOG_F(WARNING, "Streaming benchmark (%s): %u frames, avg %.3f ms, min %.3f ms, max %.3f ms, p99 %.3f ms, jitter %.3f ms",
+			mFrameIndex == mStreamFrames ? "idle" : "uploading", stats.mFrameCount, stats.mAverageMs, stats.mMinMs, stats.mMaxMs, stats.mPercentile99Ms, stats.mJitterMs);
+		pGfxCore->ResetFrameStats();
+
+		if(mFrameIndex == mStreamFrames * 2)
+		{
+			Ngine::UploadStats uploadStats = pGfxCore->GetUploadStats();
+			LOG_F(WARNING, "Streaming benchmark: %u copies in %u upload batches", uploadStats.mCopies, uploadStats.mBatches);
+			mStreamFrames = 0;
+		}
+	}
+	else if(mFrameIndex > mStreamFrames)
+	{
+		for(int i = 0; i < mStreamMeshesPerFrame; i++)
+			pGfxCore->CreateModelFromVertexList(vecStreamVertices, vecStreamIndices);
+	}
+}
+
+void Game::UpdateObjectBenchmark()
+{
+	mObjectBenchFrame++;
+	if(mObjectBenchFrame < mObjectBenchFrames)
+		return;
+
+	Ngine::FrameStats stats = pGfxCore->GetFrameStats();
+	LOG_F(WARNING, "Object benchmark (%s): %d objects, avg frame %.3f ms, p99 %.3f ms, command recording %.3f ms",
+		mObjectBenchPushPhase ? "push constants" : "uniform buffer", mObjectBenchCount, stats.mAverageMs, stats.mPercentile99Ms, stats.mRecordAverageMs);
+
+	Ngine::DrawStats drawStats = pGfxCore->GetDrawStats();
+	LOG_F(WARNING, "Object benchmark: %u draws, pipeline binds %u (%u elided), descriptor binds %u (%u elided), vertex buffer binds %u (%u elided), index buffer binds %u (%u elided)",
+		drawStats.mDrawCalls, drawStats.mPipelineBinds, drawStats.mPipelineBindsElided, drawStats.mDescriptorBinds, drawStats.mDescriptorBindsElided,
+		drawStats.mVertexBufferBinds, drawStats.mVertexBufferBindsElided, drawStats.mIndexBufferBinds, drawStats.mIndexBufferBindsElided);
+
+	DespawnBenchmarkObjects();
+
+	//Second run uses push constant shader, it is skipped when the shader is not available
+	if(!mObjectBenchPushPhase && mPushShader != 0)
+	{
+		mObjectBenchPushPhase = true;
+		SpawnBenchmarkObjects(mModel, mPushShader, mObjectBenchCount);
+		return;
+	}
+
+	LOG_IF_F(WARNING, mPushShader == 0, "Object benchmark: push constant shader not found, second run skipped");
+	mObjectBenchCount = 0;
+
+	if(mInstanceBenchCount > 0)
+		SpawnBenchmarkObjects(mModel2, mPushShader != 0 ? mPushShader : mShader, mInstanceBenchCount);
+}
+
+void Game::UpdateInstanceBenchmark()
+{
+	mObjectBenchFrame++;
+	if(mObjectBenchFrame < mObjectBenchFrames)
+		return;
+
+	Ngine::FrameStats stats = pGfxCore->GetFrameStats();
+	LOG_F(WARNING, "Instance benchmark (%s): %d cubes, avg frame %.3f ms, p99 %.3f ms, command recording %.3f ms",
+		mInstanceBenchInstancedPhase ? "instanced" : "per object", mInstanceBenchCount, stats.mAverageMs, stats.mPercentile99Ms, stats.mRecordAverageMs);
+
+	Ngine::DrawStats drawStats = pGfxCore->GetDrawStats();
+	LOG_F(WARNING, "Instance benchmark: %u draw calls, %u draws executed from indirect buffer", drawStats.mDrawCalls, drawStats.mIndirectCommands);
+
+	DespawnBenchmarkObjects();
+
+	if(!mInstanceBenchInstancedPhase && mInstancedShader != 0)
+	{
+		mInstanceBenchInstancedPhase = true;
+		SpawnBenchmarkObjects(mModel2, mInstancedShader, mInstanceBenchCount);
+		return;
+	}
+
+	LOG_IF_F(WARNING, mInstancedShader == 0, "Instance benchmark: instanced shader not found, second run skipped");
+	mInstanceBenchCount = 0;
+}
+
+void Game::UpdateRecordBenchmark()
+{
+	if(vecBenchObjects.empty())
+	{
+		mRecordBenchThreads = 1;
+		pGfxCore->SetRecordThreads(mRecordBenchThreads);
+		SpawnBenchmarkObjects(mModel, mPushShader != 0 ? mPushShader : mShader, mRecordBenchCount);
+		return;
+	}
+
+	mObjectBenchFrame++;
+	if(mObjectBenchFrame < mObjectBenchFrames)
+		return;
+
+	Ngine::FrameStats stats = pGfxCore->GetFrameStats();
+	Ngine::DrawStats drawStats = pGfxCore->GetDrawStats();
+	LOG_F(WARNING, "Record benchmark: %u threads, %u draws, command recording %.3f ms, avg frame %.3f ms, p99 %.3f ms",
+		mRecordBenchThreads, drawStats.mDrawCalls, stats.mRecordAverageMs, stats.mAverageMs, stats.mPercentile99Ms);
+
+	//Thread count doubles every run until every worker takes part
+	if(mRecordBenchThreads < pGfxCore->GetMaxRecordThreads())
+	{
+		mRecordBenchThreads = std::min(mRecordBenchThreads * 2, pGfxCore->GetMaxRecordThreads());
+		pGfxCore->SetRecordThreads(mRecordBenchThreads);
+		mObjectBenchFrame = 0;
+		pGfxCore->ResetFrameStats();
+		return;
+	}
+
+	pGfxCore->SetRecordThreads(pGfxCore->GetMaxRecordThreads());
+	DespawnBenchmarkObjects();
+	mRecordBenchCount = 0;
+}
+
+void Game::UpdateOverdrawBenchmark()
+{
+	//Objects overlap each other so most pixels are covered several times
+	if(vecBenchObjects.empty())
+	{
+		mOverdrawBenchRestorePrepass = pGfxCore->UsesDepthPrepass();
+		mOverdrawBenchPrepassPhase = false;
+		pGfxCore->SetDepthPrepass(false);
+		SpawnBenchmarkObjects(mModel, mShader, mOverdrawBenchCount, 0.5f);
+		return;
+	}
+
+	mObjectBenchFrame++;
+	if(mObjectBenchFrame < mObjectBenchFrames)
+		return;
+
+	Ngine::FrameStats stats = pGfxCore->GetFrameStats();
+	Ngine::DrawStats drawStats = pGfxCore->GetDrawStats();
+	LOG_F(WARNING, "Overdraw benchmark (%s): %d objects, %.2f fragments per pixel, %llu fragment invocations, avg frame %.3f ms, p99 %.3f ms, %u pre-pass draws",
+		mOverdrawBenchPrepassPhase ? "depth pre-pass" : "no pre-pass", mOverdrawBenchCount, stats.mFragmentsPerPixel, (unsigned long long)stats.mFragmentInvocations,
+		stats.mAverageMs, stats.mPercentile99Ms, drawStats.mPrepassDrawCalls);
+
+	if(!mOverdrawBenchPrepassPhase)
+	{
+		mOverdrawBenchPrepassPhase = true;
+		pGfxCore->SetDepthPrepass(true);
+		mObjectBenchFrame = 0;
+		pGfxCore->ResetFrameStats();
+		return;
+	}
+
+	pGfxCore->SetDepthPrepass(mOverdrawBenchRestorePrepass);
+	DespawnBenchmarkObjects();
+	mOverdrawBenchCount = 0;
+}
+
+void Game::RunCullingBenchmark(int objectCount)
+{
+	const int iterations = 100;
+
+	std::mt19937 rng(1234);
+	std::uniform_real_distribution<float> position(-500.0f, 500.0f);
+	std::uniform_real_distribution<float> radius(0.5f, 5.0f);
+
+	Ngine::SphereSet spheres;
+	for(int i = 0; i < objectCount; i++)
+		spheres.Add(glm::vec3(position(rng), position(rng), position(rng)), radius(rng));
+
+	Ngine::Frustum frustum = mCamera.GetFrustum();
+	std::vector<uint8_t> vecVisible(objectCount);
+	uint32_t visibleVector = 0, visibleScalar = 0;
+
+	auto start = std::chrono::high_resolution_clock::now();
+	for(int i = 0; i < iterations; i++)
+		visibleVector = frustum.CullSpheres(spheres, vecVisible.data());
+	double vectorTime = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+
+	start = std::chrono::high_resolution_clock::now();
+	for(int i = 0; i < iterations; i++)
+		visibleScalar = frustum.CullSpheresScalar(spheres, vecVisible.data());
+	double scalarTime = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+
+	LOG_F(WARNING, "Culling benchmark: %d objects, %u visible, SIMD %.0f objects/ms, scalar %.0f objects/ms",
+		objectCount, visibleVector, objectCount * (double)iterations / vectorTime, objectCount * (double)iterations / scalarTime);
+	LOG_IF_F(ERROR, visibleVector != visibleScalar, "Culling benchmark: SIMD and scalar results differ (%u vs %u)", visibleVector, visibleScalar);
+}
+
+void Game::RunSpatialTreeBenchmark(int objectCount)
+{
+	const int frames = 100;
+	const int movedPerFrame = std::max(objectCount / 10, 1);
+
+	std::mt19937 rng(1234);
+	std::uniform_real_distribution<float> position(-500.0f, 500.0f);
+	std::uniform_real_distribution<float> size(0.5f, 5.0f);
+	std::uniform_real_distribution<float> step(-0.5f, 0.5f);
+	std::uniform_int_distribution<int> pick(0, objectCount - 1);
+
+	Ngine::DynamicBvh tree;
+	std::vector<int32_t> vecProxies(objectCount);
+	std::vector<glm::vec3> vecMin(objectCount), vecMax(objectCount);
+
+	auto start = std::chrono::high_resolution_clock::now();
+	for(int i = 0; i < objectCount; i++)
+	{
+		vecMin[i] = glm::vec3(position(rng), position(rng), position(rng));
+		vecMax[i] = vecMin[i] + glm::vec3(size(rng));
+		vecProxies[i] = tree.Insert(nullptr, vecMin[i], vecMax[i]);
+	}
+	double buildTime = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+
+	uint32_t reinserted = 0;
+	start = std::chrono::high_resolution_clock::now();
+	for(int f = 0; f < frames; f++)
+	{
+		for(int m = 0; m < movedPerFrame; m++)
+		{
+			int i = pick(rng);
+			glm::vec3 offset = glm::vec3(step(rng), step(rng), step(rng));
+			vecMin[i] += offset;
+			vecMax[i] += offset;
+			reinserted += tree.Move(vecProxies[i], vecMin[i], vecMax[i]) ? 1 : 0;
+		}
+	}
+	double refitTime = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+
+	Ngine::Frustum frustum = mCamera.GetFrustum();
+	std::vector<Ngine::GameObject3D*> vecResults;
+
+	start = std::chrono::high_resolution_clock::now();
+	for(int f = 0; f < frames; f++)
+	{
+		vecResults.clear();
+		tree.QueryFrustum(frustum, vecResults);
 	}
+	double queryTime = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+
+	LOG_F(WARNING, "Spatial tree benchmark: %d objects built in %.2f ms, height %d", objectCount, buildTime, tree.GetHeight());
+	LOG_F(WARNING, "Spatial tree benchmark: %d moves per frame take %.3f ms (%.1f%% reinserted), frustum query %.3f ms (%zu objects)",
+		movedPerFrame, refitTime / frames, 100.0 * reinserted / ((double)movedPerFrame * frames), queryTime / frames, vecResults.size());
+}
+
+void Game::SpawnBenchmarkObjects(uint32_t model, uint32_t shader, int count, float spacing)
+{
+	int gridSize = (int)std::ceil(std::sqrt((float)count));
+
+	for(int i = 0; i < count; i++)
+	{
+		Ngine::GameObject3D* pBenchObject = new Ngine::GameObject3D(model, shader);
+		glm::vec3 translation((i % gridSize) * spacing, 0.0f, (i / gridSize) * spacing);
+		pBenchObject->SetTranslation(translation);
+		pGfxCore->AddGameObjectToDrawList(pBenchObject);
+		vecBenchObjects.push_back(pBenchObject);
+	}
+
+	mObjectBenchFrame = 0;
+	pGfxCore->ResetFrameStats();
+}
+
+void Game::DespawnBenchmarkObjects()
+{
+	for(auto pBenchObject : vecBenchObjects)
+	{
+		pGfxCore->RemoveGameObjectFromDrawList(pBenchObject);
+		delete pBenchObject;
+	}
+
+	vecBenchObjects.clear();
 }
 
 void Game::ManageEvents()
@@ -90,6 +470,12 @@ void Game::ManageEvents()
 			Ngine::EventCursorMove* pCastedEvent = reinterpret_cast<Ngine::EventCursorMove*>(element);
 			LOG_F(INFO, "Cursor moved to %f x %f", pCastedEvent->pos_x, pCastedEvent->pos_y);
 		}
+		if(element->mType == Ngine::EventType::EventType_ShaderReady)
+		{
+			Ngine::EventShaderReady* pCastedEvent = reinterpret_cast<Ngine::EventShaderReady*>(element);
+			LOG_IF_F(INFO, pCastedEvent->mSucceeded, "Shader %u is ready, pipelines compiled in %.2f ms", pCastedEvent->mShaderId, pCastedEvent->mCompileMs);
+			LOG_IF_F(ERROR, !pCastedEvent->mSucceeded, "Shader %u failed to compile, objects using it are not drawn", pCastedEvent->mShaderId);
+		}
 	}
 
 	Ngine::EventHandler::ClearEventBuffer();
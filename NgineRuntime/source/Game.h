@@ -10,11 +10,51 @@ public:
 	void Run() override;
 	void ManageEvents() override;
 
+private:
+	void UpdateStreamingBenchmark();
+	void UpdateObjectBenchmark();
+	void UpdateInstanceBenchmark();
+	void UpdateRecordBenchmark();
+	void UpdateOverdrawBenchmark();
+	void RunCullingBenchmark(int objectCount);
+	void RunSpatialTreeBenchmark(int objectCount);
+	void SpawnBenchmarkObjects(uint32_t model, uint32_t shader, int count, float spacing = 1.5f);
+	void DespawnBenchmarkObjects();
+
 private:
 	uint32_t mShader = 0;
 	uint32_t mModel = 0;
 	uint32_t mModel2 = 0;
 
+	//Streaming benchmark - frame time jitter without and with uploads running
+	int mStreamFrames = 0;
+	int mStreamMeshesPerFrame = 0;
+	int mFrameIndex = 0;
+	std::vector<Ngine::Vertex> vecStreamVertices;
+	std::vector<uint16_t> vecStreamIndices;
+
+	//Object benchmark - same scene drawn with uniform buffer path and push constant path
+	int mObjectBenchCount = 0;
+	int mObjectBenchFrames = 0;
+	int mObjectBenchFrame = 0;
+	uint32_t mPushShader = 0;
+	bool mObjectBenchPushPhase = false;
+	std::vector<Ngine::GameObject3D*> vecBenchObjects;
+
+	//Instance benchmark - many cubes drawn one by one and then as single instanced draw, runs after object benchmark
+	int mInstanceBenchCount = 0;
+	uint32_t mInstancedShader = 0;
+	bool mInstanceBenchInstancedPhase = false;
+
+	//Record benchmark - command recording time of the same scene with growing number of recording threads
+	int mRecordBenchCount = 0;
+	uint32_t mRecordBenchThreads = 0;
+
+	//Overdraw benchmark - fragment shader invocations of tightly packed objects without and with depth pre-pass
+	int mOverdrawBenchCount = 0;
+	bool mOverdrawBenchPrepassPhase = false;
+	bool mOverdrawBenchRestorePrepass = false;
+
 	Ngine::GameObject3D* pObject;
 	Ngine::GameObject3D* pObject2;
 	Ngine::Camera mCamera;